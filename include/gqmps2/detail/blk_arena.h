@@ -0,0 +1,415 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-16 21:10
+*
+* Description: GraceQ/MPS2 project. Single file memory-mapped arena used to store environment blocks.
+*/
+#ifndef GQMPS2_DETAIL_BLK_ARENA_H
+#define GQMPS2_DETAIL_BLK_ARENA_H
+
+
+#include <string>
+#include <vector>
+#include <map>
+#include <iterator>
+#include <mutex>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <assert.h>
+
+#ifdef Release
+  #define NDEBUG
+#endif
+
+
+namespace gqmps2 {
+
+
+const char kBlockArenaMagic[8] = {'G', 'Q', 'M', 'P', 'S', '2', 'B', 'A'};
+
+// Version of the layout of the head and the slot records, an arena of another
+// version is not reused. Version 2 adds the tags of the slots.
+const uint64_t kBlockArenaVersion = 2;
+
+const size_t kBlockArenaSlotNameLen = 24;
+
+const size_t kBlockArenaAlign = 4096;
+
+
+// Records of the arena live in the head of the file, so a reopened arena
+// knows which blocks it holds.
+struct BlockArenaHead {
+  char magic[8];
+  uint64_t version;
+  uint64_t max_slot_num;
+  uint64_t data_end;
+};
+
+struct BlockArenaSlot {
+  char name[kBlockArenaSlotNameLen];    // Empty name for free slot.
+  uint64_t offset;
+  uint64_t capacity;
+  uint64_t size;
+  uint64_t tag;                         // 0 when the data are being written.
+};
+
+
+inline uint64_t BlockArenaRoundUp(const uint64_t size) {
+  return ((size + kBlockArenaAlign - 1) / kBlockArenaAlign) * kBlockArenaAlign;
+}
+
+
+// Block store backed by one preallocated memory-mapped file. The space of a
+// released block is reused by the following blocks, thus no file is created
+// or removed during the sweeps.
+//
+// Only the slot records are guarded by the lock. The data are copied into and
+// out of the mapped file outside of it, thus the blocks of different names are
+// written and read concurrently. The caller does not store, load or release a
+// block while it is being written or read. The mappings replaced by a growth of
+// the file are kept until the arena is closed, so the data pointers handed out
+// before stay valid.
+class BlockArena {
+public:
+  BlockArena(
+      const std::string &file, const size_t max_slot_num, const bool reuse,
+      const size_t init_data_size = 0) :
+      file_(file) {
+    auto exist = (access(file_.c_str(), F_OK) == 0);
+    fd_ = open(file_.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd_ == -1) {
+      std::cout << "Unable to open block arena " << file_ << std::endl;
+      exit(1);
+    }
+    if (reuse && exist && IsValidArena_(max_slot_num)) {
+      struct stat st;
+      fstat(fd_, &st);
+      max_slot_num_ = max_slot_num;
+      Map_(st.st_size);
+      CollectFreeRegions_();
+    } else {
+      max_slot_num_ = max_slot_num;
+      auto data_beg = DataBeg_();
+      auto init_size = data_beg + BlockArenaRoundUp(init_data_size);
+      Resize_(init_size);
+      Map_(init_size);
+      std::memcpy(head_()->magic, kBlockArenaMagic, sizeof(kBlockArenaMagic));
+      head_()->version = kBlockArenaVersion;
+      head_()->max_slot_num = max_slot_num_;
+      head_()->data_end = data_beg;
+      std::memset(slots_(), 0, max_slot_num_ * sizeof(BlockArenaSlot));
+    }
+  }
+
+  BlockArena(const BlockArena &) = delete;
+  BlockArena &operator=(const BlockArena &) = delete;
+
+  ~BlockArena(void) {
+    munmap(base_, map_size_);
+    for (auto &map : retired_maps_) { munmap(map.first, map.second); }
+    close(fd_);
+  }
+
+  bool Has(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return FindSlot_(name) != nullptr;
+  }
+
+  // Reserve size bytes in the slot named name, reuse a released slot if
+  // possible. The writer is called as writer(data, size) on the mapped region
+  // of the slot without the lock. The tag is set after the data have been
+  // written, thus a block interrupted while writing is never taken as a valid
+  // one.
+  template <typename WriterT>
+  void Store(
+      const std::string &name, const size_t size, WriterT &&writer,
+      const uint64_t tag = 0) {
+    assert(name.size() < kBlockArenaSlotNameLen);
+    char *data;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      auto pslot = FindSlot_(name);
+      if (pslot != nullptr && pslot->capacity < size) {
+        pslot->name[0] = '\0';
+        pslot = nullptr;
+      }
+      if (pslot == nullptr) {
+        pslot = AllocSlot_(size);
+        std::strncpy(pslot->name, name.c_str(), kBlockArenaSlotNameLen);
+      }
+      pslot->tag = 0;
+      pslot->size = size;
+      data = base_ + pslot->offset;
+    }
+    writer(data, size);
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto pslot = FindSlot_(name);
+    assert(pslot != nullptr);
+    pslot->tag = tag;
+  }
+
+  // Copy data to the slot named name.
+  void Store(
+      const std::string &name, const char *data, const size_t size,
+      const uint64_t tag = 0) {
+    Store(
+        name, size,
+        [data](char *dest, const size_t size) {
+          std::memcpy(dest, data, size);
+        },
+        tag);
+  }
+
+  // Tag of the block, 0 if the block does not exist.
+  uint64_t Tag(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto pslot = FindSlot_(name);
+    return (pslot != nullptr) ? pslot->tag : 0;
+  }
+
+  // The loader is called as loader(data, size) on the mapped region of the
+  // slot without the lock, thus the blocks are deserialized while others are
+  // written.
+  template <typename LoaderT>
+  void Load(const std::string &name, LoaderT &&loader) {
+    const char *data;
+    size_t size;
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      auto pslot = FindSlot_(name);
+      if (pslot == nullptr) {
+        std::cout << "Block " << name << " not found in block arena "
+                  << file_ << std::endl;
+        exit(1);
+      }
+      data = base_ + pslot->offset;
+      size = pslot->size;
+    }
+    loader(data, size);
+  }
+
+  void Release(const std::string &name) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto pslot = FindSlot_(name);
+    if (pslot != nullptr) { pslot->name[0] = '\0'; }
+  }
+
+  // Write the mapped data back to the disk.
+  void Sync(void) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    msync(base_, map_size_, MS_SYNC);
+  }
+
+  size_t FileSize(void) const { return map_size_; }
+
+  // End of the regions of the blocks in the file.
+  size_t DataEnd(void) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return head_()->data_end;
+  }
+
+  size_t DataSize(void) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    size_t data_size = 0;
+    for (size_t i = 0; i < max_slot_num_; ++i) {
+      if (slots_()[i].name[0] != '\0') { data_size += slots_()[i].size; }
+    }
+    return data_size;
+  }
+
+private:
+  BlockArenaHead *head_(void) const {
+    return reinterpret_cast<BlockArenaHead *>(base_);
+  }
+
+  BlockArenaSlot *slots_(void) const {
+    return reinterpret_cast<BlockArenaSlot *>(base_ + sizeof(BlockArenaHead));
+  }
+
+  uint64_t DataBeg_(void) const {
+    return BlockArenaRoundUp(
+        sizeof(BlockArenaHead) + max_slot_num_ * sizeof(BlockArenaSlot));
+  }
+
+  // An arena of another version or with a different slot table layout is not
+  // reused.
+  bool IsValidArena_(const size_t max_slot_num) {
+    BlockArenaHead head;
+    if (pread(fd_, &head, sizeof(head), 0) != sizeof(head)) { return false; }
+    if (std::memcmp(head.magic, kBlockArenaMagic, sizeof(kBlockArenaMagic))) {
+      return false;
+    }
+    return head.version == kBlockArenaVersion &&
+           head.max_slot_num == max_slot_num;
+  }
+
+  BlockArenaSlot *FindSlot_(const std::string &name) const {
+    for (size_t i = 0; i < max_slot_num_; ++i) {
+      auto &slot = slots_()[i];
+      if (slot.name[0] != '\0' &&
+          std::strncmp(slot.name, name.c_str(), kBlockArenaSlotNameLen) == 0) {
+        return &slot;
+      }
+    }
+    return nullptr;
+  }
+
+  // Best fit in the released slots. Otherwise the slot gets the best fitting
+  // free region, or a new region appended to the data.
+  BlockArenaSlot *AllocSlot_(const size_t size) {
+    BlockArenaSlot *pbest = nullptr;
+    BlockArenaSlot *punused = nullptr;
+    BlockArenaSlot *psmallest = nullptr;
+    for (size_t i = 0; i < max_slot_num_; ++i) {
+      auto pslot = &slots_()[i];
+      if (pslot->name[0] != '\0') { continue; }
+      if (pslot->capacity == 0) {
+        if (punused == nullptr) { punused = pslot; }
+      } else if (pslot->capacity >= size) {
+        if (pbest == nullptr || pslot->capacity < pbest->capacity) {
+          pbest = pslot;
+        }
+      } else if (psmallest == nullptr ||
+                 pslot->capacity < psmallest->capacity) {
+        psmallest = pslot;
+      }
+    }
+    if (pbest != nullptr) { return pbest; }
+    // Move the smallest released region to the free regions when all slot
+    // records are used.
+    auto pslot = (punused != nullptr) ? punused : psmallest;
+    if (pslot == nullptr) {
+      std::cout << "No free slot in block arena " << file_ << std::endl;
+      exit(1);
+    }
+    if (pslot->capacity != 0) {
+      FreeRegion_(pslot->offset, pslot->capacity);
+      pslot->capacity = 0;
+    }
+    // Leave some room for the growth of the block in the next sweeps.
+    auto capacity = BlockArenaRoundUp(size + size / 8);
+    uint64_t offset;
+    if (!TakeFreeRegion_(capacity, offset)) {
+      offset = head_()->data_end;
+      auto data_end = offset + capacity;
+      if (data_end > map_size_) {
+        auto slot_idx = pslot - slots_();
+        auto new_size = std::max<uint64_t>(
+                            data_end, map_size_ + map_size_ / 2);
+        Resize_(new_size);
+        retired_maps_.push_back(std::make_pair(base_, map_size_));
+        Map_(new_size);
+        pslot = &slots_()[slot_idx];
+      }
+      head_()->data_end = data_end;
+    }
+    pslot->offset = offset;
+    pslot->capacity = capacity;
+    return pslot;
+  }
+
+  // The free regions are merged with their neighbours, the one at the end of
+  // the data shortens the data.
+  void FreeRegion_(uint64_t offset, uint64_t capacity) {
+    auto next = free_regions_.lower_bound(offset);
+    if (next != free_regions_.end() && offset + capacity == next->first) {
+      capacity += next->second;
+      next = free_regions_.erase(next);
+    }
+    if (next != free_regions_.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == offset) {
+        offset = prev->first;
+        capacity += prev->second;
+        free_regions_.erase(prev);
+      }
+    }
+    if (offset + capacity == head_()->data_end) {
+      head_()->data_end = offset;
+    } else {
+      free_regions_[offset] = capacity;
+    }
+  }
+
+  // Best fit in the free regions, the rest of the region stays free.
+  bool TakeFreeRegion_(const uint64_t capacity, uint64_t &offset) {
+    auto pbest = free_regions_.end();
+    for (auto it = free_regions_.begin(); it != free_regions_.end(); ++it) {
+      if (it->second >= capacity &&
+          (pbest == free_regions_.end() || it->second < pbest->second)) {
+        pbest = it;
+      }
+    }
+    if (pbest == free_regions_.end()) { return false; }
+    offset = pbest->first;
+    auto rest = pbest->second - capacity;
+    free_regions_.erase(pbest);
+    if (rest != 0) { free_regions_[offset + capacity] = rest; }
+    return true;
+  }
+
+  // The free regions of a reopened arena are the gaps between the regions of
+  // the slots.
+  void CollectFreeRegions_(void) {
+    std::map<uint64_t, uint64_t> regions;
+    for (size_t i = 0; i < max_slot_num_; ++i) {
+      auto &slot = slots_()[i];
+      if (slot.capacity != 0) { regions[slot.offset] = slot.capacity; }
+    }
+    auto offset = DataBeg_();
+    for (auto &region : regions) {
+      if (region.first > offset) {
+        free_regions_[offset] = region.first - offset;
+      }
+      offset = std::max(offset, region.first + region.second);
+    }
+    if (head_()->data_end > offset) { head_()->data_end = offset; }
+  }
+
+  void Resize_(const size_t size) {
+    if (ftruncate(fd_, size) != 0) {
+      std::cout << "Unable to resize block arena " << file_ << std::endl;
+      exit(1);
+    }
+    // Really allocate the space to avoid the bus error when the disk is full.
+    auto err = posix_fallocate(fd_, 0, size);
+    if (err != 0 && err != EINVAL && err != EOPNOTSUPP) {
+      std::cout << "Unable to allocate block arena " << file_ << std::endl;
+      exit(1);
+    }
+  }
+
+  void Map_(const size_t size) {
+    auto addr = mmap(
+                    nullptr, size,
+                    PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd_, 0);
+    if (addr == MAP_FAILED) {
+      std::cout << "Unable to map block arena " << file_ << std::endl;
+      exit(1);
+    }
+    base_ = static_cast<char *>(addr);
+    map_size_ = size;
+  }
+
+  std::string file_;
+  int fd_ = -1;
+  char *base_ = nullptr;
+  size_t map_size_ = 0;
+  std::vector<std::pair<char *, size_t>> retired_maps_;
+  size_t max_slot_num_ = 0;
+  std::map<uint64_t, uint64_t> free_regions_;    // Offset to capacity.
+  std::mutex mtx_;
+};
+} /* gqmps2 */
+#endif /* ifndef GQMPS2_DETAIL_BLK_ARENA_H */
@@ -0,0 +1,155 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-16 23:10
+*
+* Description: GraceQ/MPS2 project. Fast lossless codec for environment blocks spilled to disk.
+*/
+#ifndef GQMPS2_DETAIL_BLK_CODEC_H
+#define GQMPS2_DETAIL_BLK_CODEC_H
+
+
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+
+namespace gqmps2 {
+
+
+// The encoded data begin with the magic and the raw size. Data without the
+// magic are raw data.
+const char kBlockCodecMagic[4] = {'G', 'Q', 'B', 'C'};
+
+const size_t kBlockCodecHeadSize = sizeof(kBlockCodecMagic) + sizeof(uint64_t);
+
+// Shuffle stride, the size of a double.
+const size_t kBlockCodecStride = 8;
+
+// Run-length coding. A control byte c < 128 is followed by c+1 literal bytes.
+// A control byte c >= 128 is followed by one byte repeated c-128+3 times.
+const size_t kBlockCodecMaxLiteral = 128;
+const size_t kBlockCodecMinRun = 3;
+const size_t kBlockCodecMaxRun = 127 + kBlockCodecMinRun;
+
+
+// Gather the k-th bytes of all the elements together. The sign and exponent
+// bytes of the doubles become long runs. The tail bytes are kept.
+inline void BlockShuffle(const char *src, char *dest, const size_t size) {
+  auto elem_num = size / kBlockCodecStride;
+  for (size_t k = 0; k < kBlockCodecStride; ++k) {
+    auto pdest = dest + k * elem_num;
+    for (size_t i = 0; i < elem_num; ++i) {
+      pdest[i] = src[i * kBlockCodecStride + k];
+    }
+  }
+  auto shuffled_size = elem_num * kBlockCodecStride;
+  std::memcpy(dest + shuffled_size, src + shuffled_size, size - shuffled_size);
+}
+
+
+inline void BlockUnshuffle(const char *src, char *dest, const size_t size) {
+  auto elem_num = size / kBlockCodecStride;
+  for (size_t k = 0; k < kBlockCodecStride; ++k) {
+    auto psrc = src + k * elem_num;
+    for (size_t i = 0; i < elem_num; ++i) {
+      dest[i * kBlockCodecStride + k] = psrc[i];
+    }
+  }
+  auto shuffled_size = elem_num * kBlockCodecStride;
+  std::memcpy(dest + shuffled_size, src + shuffled_size, size - shuffled_size);
+}
+
+
+inline bool IsEncodedBlock(const char *data, const size_t size) {
+  return size >= kBlockCodecHeadSize &&
+         std::memcmp(data, kBlockCodecMagic, sizeof(kBlockCodecMagic)) == 0;
+}
+
+
+// Byte shuffle then run-length coding.
+inline std::string EncodeBlock(const char *data, const size_t size) {
+  std::string shuffled(size, '\0');
+  BlockShuffle(data, &shuffled[0], size);
+
+  std::string encoded;
+  encoded.reserve(
+      kBlockCodecHeadSize + size + size / kBlockCodecMaxLiteral + 1);
+  encoded.append(kBlockCodecMagic, sizeof(kBlockCodecMagic));
+  uint64_t raw_size = size;
+  encoded.append(reinterpret_cast<const char *>(&raw_size), sizeof(raw_size));
+
+  auto src = shuffled.data();
+  size_t lit_beg = 0;
+  size_t i = 0;
+  auto flush_literal = [&encoded, src, &lit_beg](const size_t end) {
+    while (lit_beg < end) {
+      auto len = std::min(end - lit_beg, kBlockCodecMaxLiteral);
+      encoded.push_back(char(len - 1));
+      encoded.append(src + lit_beg, len);
+      lit_beg += len;
+    }
+  };
+  while (i < size) {
+    size_t run = 1;
+    while (i + run < size && run < kBlockCodecMaxRun &&
+           src[i + run] == src[i]) {
+      ++run;
+    }
+    if (run >= kBlockCodecMinRun) {
+      flush_literal(i);
+      encoded.push_back(char(128 + run - kBlockCodecMinRun));
+      encoded.push_back(src[i]);
+      i += run;
+      lit_beg = i;
+    } else {
+      i += run;
+    }
+  }
+  flush_literal(size);
+  return encoded;
+}
+
+
+inline size_t EncodedBlockRawSize(const char *data) {
+  uint64_t raw_size;
+  std::memcpy(&raw_size, data + sizeof(kBlockCodecMagic), sizeof(raw_size));
+  return raw_size;
+}
+
+
+inline std::string DecodeBlock(const char *data, const size_t size) {
+  auto raw_size = EncodedBlockRawSize(data);
+  std::string shuffled(raw_size, '\0');
+  auto pdest = &shuffled[0];
+  size_t pos = 0;
+  size_t i = kBlockCodecHeadSize;
+  while (i < size) {
+    auto ctrl = static_cast<unsigned char>(data[i++]);
+    size_t len;
+    if (ctrl < 128) {
+      len = ctrl + 1;
+      if (i + len > size || pos + len > raw_size) { break; }
+      std::memcpy(pdest + pos, data + i, len);
+      i += len;
+    } else {
+      len = ctrl - 128 + kBlockCodecMinRun;
+      if (i >= size || pos + len > raw_size) { break; }
+      std::memset(pdest + pos, data[i++], len);
+    }
+    pos += len;
+  }
+  if (pos != raw_size || i != size) {
+    std::cout << "Corrupted encoded block" << std::endl;
+    exit(1);
+  }
+
+  std::string decoded(raw_size, '\0');
+  BlockUnshuffle(shuffled.data(), &decoded[0], raw_size);
+  return decoded;
+}
+} /* gqmps2 */
+#endif /* ifndef GQMPS2_DETAIL_BLK_CODEC_H */
@@ -0,0 +1,365 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-16 20:30
+*
+* Description: GraceQ/MPS2 project. Implementation details for environment block file I/O.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqmps2/detail/blk_arena.h"
+#include "gqmps2/detail/blk_codec.h"
+#include "gqten/gqten.h"
+
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Input stream buffer on a piece of memory.
+class BlockMemInBuf : public std::streambuf {
+public:
+  BlockMemInBuf(const char *data, const size_t size) {
+    auto beg = const_cast<char *>(data);
+    setg(beg, beg, beg + size);
+  }
+
+protected:
+  pos_type seekoff(
+      off_type off, std::ios_base::seekdir dir,
+      std::ios_base::openmode which = std::ios_base::in) override {
+    char *tgt;
+    switch (dir) {
+      case std::ios_base::beg:
+        tgt = eback() + off;
+        break;
+      case std::ios_base::cur:
+        tgt = gptr() + off;
+        break;
+      default:
+        tgt = egptr() + off;
+    }
+    if (tgt < eback() || tgt > egptr()) { return pos_type(off_type(-1)); }
+    setg(eback(), tgt, egptr());
+    return pos_type(tgt - eback());
+  }
+
+  pos_type seekpos(
+      pos_type pos,
+      std::ios_base::openmode which = std::ios_base::in) override {
+    return seekoff(off_type(pos), std::ios_base::beg, which);
+  }
+};
+
+
+// Output stream buffer on a piece of memory, it fails once the memory is full.
+class BlockMemOutBuf : public std::streambuf {
+public:
+  BlockMemOutBuf(char *data, const size_t size) { setp(data, data + size); }
+
+  size_t Size(void) const { return pptr() - pbase(); }
+};
+
+
+// Output stream buffer which only counts the bytes.
+class BlockSizeCountBuf : public std::streambuf {
+public:
+  size_t Size(void) const { return size_; }
+
+protected:
+  std::streamsize xsputn(const char *, std::streamsize n) override {
+    size_ += n;
+    return n;
+  }
+
+  int_type overflow(int_type ch) override {
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) { ++size_; }
+    return traits_type::not_eof(ch);
+  }
+
+private:
+  size_t size_ = 0;
+};
+
+
+// Number of bytes of the block in the tensor binary file format.
+template <typename TenType>
+size_t BlockDumpSize(const TenType &blk) {
+  BlockSizeCountBuf buf;
+  std::ofstream ofs;
+  static_cast<std::ios &>(ofs).rdbuf(&buf);
+  bfwrite(ofs, blk);
+  return buf.Size();
+}
+
+
+// Serialize the block into size bytes of memory, which is BlockDumpSize(blk).
+template <typename TenType>
+void DumpBlockToMem(const TenType &blk, char *data, const size_t size) {
+  BlockMemOutBuf buf(data, size);
+  std::ofstream ofs;
+  static_cast<std::ios &>(ofs).rdbuf(&buf);
+  bfwrite(ofs, blk);
+  if (!ofs || buf.Size() != size) {
+    std::cout << "Unable to dump the block into " << size << " bytes"
+              << std::endl;
+    exit(1);
+  }
+}
+
+
+// Serialize the block using the tensor binary file format.
+template <typename TenType>
+std::string DumpBlockToBytes(const TenType &blk) {
+  std::stringbuf buf(std::ios_base::out | std::ios_base::binary);
+  std::ofstream ofs;
+  static_cast<std::ios &>(ofs).rdbuf(&buf);
+  bfwrite(ofs, blk);
+  return buf.str();
+}
+
+
+template <typename TenType>
+TenType *LoadBlockFromBytes(const char *data, const size_t size) {
+  BlockMemInBuf buf(data, size);
+  std::ifstream ifs;
+  static_cast<std::ios &>(ifs).rdbuf(&buf);
+  auto pblk = new TenType();
+  bfread(ifs, *pblk);
+  return pblk;
+}
+
+
+// Number of bytes of the block data.
+template <typename TenType>
+inline size_t BlockBytes(const TenType &blk) {
+  size_t elem_num = 0;
+  for (auto pqnblk : blk.cblocks()) { elem_num += pqnblk->size; }
+  return elem_num * sizeof(blk.scalar);
+}
+
+
+// Statistics of the block codec.
+struct BlockCodecStats {
+  size_t raw_bytes = 0;
+  size_t encoded_bytes = 0;
+  double encode_time = 0;
+  size_t decoded_bytes = 0;
+  double decode_time = 0;
+
+  double Ratio(void) const {
+    return encoded_bytes ? double(raw_bytes) / encoded_bytes : 1.0;
+  }
+};
+
+
+// Environment block I/O on the block arena file. In asynchronous mode, the
+// blocks are written back by background tasks and the block which the next
+// update needs can be prefetched while the current update is running.
+//
+// The blocks are serialized straight into the arena file and deserialized
+// straight from it. Only the codec needs the serialized copies, their bytes
+// and the bytes of the prefetched blocks are counted as in-flight bytes.
+template <typename TenType>
+class BlockFileIO {
+public:
+  BlockFileIO(const bool async, const char codec = kBlockCodecNone) :
+      async_(async), codec_(codec) {}
+
+  BlockFileIO(const BlockFileIO &) = delete;
+  BlockFileIO &operator=(const BlockFileIO &) = delete;
+
+  ~BlockFileIO(void) { Sync(); }
+
+  // Open the arena file. Blocks stored in an existing arena file are kept if
+  // reuse is true.
+  void Open(
+      const std::string &file, const size_t max_blk_num, const bool reuse) {
+    parena_.reset(new BlockArena(file, max_blk_num, reuse));
+  }
+
+  // The block can not be deleted before the writing finished, use Delete.
+  void Write(
+      const TenType *pblk, const std::string &name, const uint64_t tag = 0) {
+    auto write = [this, pblk, name, tag]() {
+                   if (codec_ != kBlockCodecShuffleRle) {
+                     parena_->Store(
+                         name, BlockDumpSize(*pblk),
+                         [pblk](char *data, const size_t size) {
+                           DumpBlockToMem(*pblk, data, size);
+                         },
+                         tag);
+                     return;
+                   }
+                   auto bytes = DumpBlockToBytes(*pblk);
+                   inflight_bytes_ += bytes.size();
+                   auto encoded = Encode_(bytes);
+                   inflight_bytes_ += encoded.size();
+                   parena_->Store(name, encoded.data(), encoded.size(), tag);
+                   inflight_bytes_ -= bytes.size() + encoded.size();
+                 };
+    if (!async_) {
+      write();
+      return;
+    }
+    auto pending_write = std::async(std::launch::async, write).share();
+    pending_name_writes_[name] = pending_write;
+    pending_blk_writes_[pblk] = pending_write;
+  }
+
+  TenType *Read(const std::string &name, const bool remove) {
+    TenType *pblk;
+    auto poss_it = prefetches_.find(name);
+    if (poss_it != prefetches_.end()) {
+      pblk = poss_it->second.get();
+      prefetches_.erase(poss_it);
+      inflight_bytes_ -= BlockBytes(*pblk);
+    } else {
+      WaitNameWrite_(name);
+      pblk = Load_(name);
+    }
+    if (remove) { parena_->Release(name); }
+    return pblk;
+  }
+
+  void Prefetch(const std::string &name) {
+    if (!async_ || (prefetches_.find(name) != prefetches_.end())) { return; }
+    std::shared_future<void> pending_write;
+    auto poss_it = pending_name_writes_.find(name);
+    if (poss_it != pending_name_writes_.end()) {
+      pending_write = poss_it->second;
+    }
+    prefetches_[name] = std::async(
+                            std::launch::async,
+                            [this, name, pending_write]() {
+                              if (pending_write.valid()) {
+                                pending_write.wait();
+                              }
+                              auto pblk = Load_(name);
+                              inflight_bytes_ += BlockBytes(*pblk);
+                              return pblk;
+                            });
+  }
+
+  // Remove the block from the arena, the pending tasks on it are finished
+  // before.
+  void Remove(const std::string &name) {
+    WaitNameWrite_(name);
+    pending_name_writes_.erase(name);
+    auto poss_it = prefetches_.find(name);
+    if (poss_it != prefetches_.end()) {
+      DeletePrefetched_(poss_it->second.get());
+      prefetches_.erase(poss_it);
+    }
+    parena_->Release(name);
+  }
+
+  // Tag of the stored block, 0 if it does not exist.
+  uint64_t Tag(const std::string &name) { return parena_->Tag(name); }
+
+  void Delete(TenType *pblk) {
+    auto poss_it = pending_blk_writes_.find(pblk);
+    if (poss_it != pending_blk_writes_.end()) {
+      poss_it->second.wait();
+      pending_blk_writes_.erase(poss_it);
+    }
+    delete pblk;
+  }
+
+  // Wait all background tasks and drop the unused prefetched blocks.
+  void Sync(void) {
+    for (auto &name_write : pending_name_writes_) { name_write.second.wait(); }
+    pending_name_writes_.clear();
+    pending_blk_writes_.clear();
+    for (auto &prefetch : prefetches_) {
+      DeletePrefetched_(prefetch.second.get());
+    }
+    prefetches_.clear();
+  }
+
+  // Wait all pending writes and write the arena back to the disk.
+  void Persist(void) {
+    for (auto &name_write : pending_name_writes_) { name_write.second.wait(); }
+    pending_name_writes_.clear();
+    pending_blk_writes_.clear();
+    parena_->Sync();
+  }
+
+  // Bytes of the serialized copies held by the pending writes and of the
+  // prefetched blocks which have not been read.
+  size_t InFlightBytes(void) const { return inflight_bytes_; }
+
+  BlockCodecStats CodecStats(void) {
+    std::lock_guard<std::mutex> lock(stats_mtx_);
+    return codec_stats_;
+  }
+
+private:
+  void DeletePrefetched_(TenType *pblk) {
+    inflight_bytes_ -= BlockBytes(*pblk);
+    delete pblk;
+  }
+
+  TenType *Load_(const std::string &name) {
+    TenType *pblk;
+    parena_->Load(
+        name,
+        [this, &pblk](const char *data, const size_t size) {
+          if (IsEncodedBlock(data, size)) {
+            auto bytes = Decode_(data, size);
+            pblk = LoadBlockFromBytes<TenType>(bytes.data(), bytes.size());
+          } else {
+            pblk = LoadBlockFromBytes<TenType>(data, size);
+          }
+        });
+    return pblk;
+  }
+
+  std::string Encode_(const std::string &bytes) {
+    Timer encode_timer("encode");
+    encode_timer.Restart();
+    auto encoded = EncodeBlock(bytes.data(), bytes.size());
+    auto encode_time = encode_timer.Elapsed();
+    std::lock_guard<std::mutex> lock(stats_mtx_);
+    codec_stats_.raw_bytes += bytes.size();
+    codec_stats_.encoded_bytes += encoded.size();
+    codec_stats_.encode_time += encode_time;
+    return encoded;
+  }
+
+  std::string Decode_(const char *data, const size_t size) {
+    Timer decode_timer("decode");
+    decode_timer.Restart();
+    auto decoded = DecodeBlock(data, size);
+    auto decode_time = decode_timer.Elapsed();
+    std::lock_guard<std::mutex> lock(stats_mtx_);
+    codec_stats_.decoded_bytes += decoded.size();
+    codec_stats_.decode_time += decode_time;
+    return decoded;
+  }
+
+  void WaitNameWrite_(const std::string &name) {
+    auto poss_it = pending_name_writes_.find(name);
+    if (poss_it != pending_name_writes_.end()) { poss_it->second.wait(); }
+  }
+
+  bool async_;
+  char codec_;
+  std::unique_ptr<BlockArena> parena_;
+  std::map<std::string, std::shared_future<void>> pending_name_writes_;
+  std::map<const TenType *, std::shared_future<void>> pending_blk_writes_;
+  std::map<std::string, std::future<TenType *>> prefetches_;
+  std::atomic<size_t> inflight_bytes_{0};
+  std::mutex stats_mtx_;
+  BlockCodecStats codec_stats_;
+};
+} /* gqmps2 */
@@ -0,0 +1,339 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-16 22:05
+*
+* Description: GraceQ/MPS2 project. Implementation details for environment block manager.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+#include "gqmps2/detail/hash.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include <assert.h>
+
+#ifdef Release
+  #define NDEBUG
+#endif
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Helpers
+// Name of the block in the block arena.
+inline std::string GenBlockName(const char side, const long blk_len) {
+  return side + kBlockFileBaseName + std::to_string(blk_len);
+}
+
+
+// Content hash of the tensor. The indexes are hashed through the file format
+// of a tensor without blocks, the sectors and the data of the blocks are hashed
+// in place.
+template <typename TenType>
+inline uint64_t HashTensor(const TenType &ten) {
+  auto header = DumpBlockToBytes(TenType(ten.indexes));
+  auto hash = HashBytes(header.data(), header.size());
+  for (auto pqnblk : ten.cblocks()) {
+    auto ids = BlockSectorIds(ten, pqnblk);
+    hash = HashBytes(
+               reinterpret_cast<const char *>(ids.data()),
+               ids.size() * sizeof(long), hash);
+    hash = HashBytes(
+               reinterpret_cast<const char *>(pqnblk->cdata()),
+               pqnblk->size * sizeof(ten.scalar), hash);
+  }
+  return hash;
+}
+
+
+// Environment block manager for the two-site algorithm (update_sites = 2) and
+// the single-site algorithm (update_sites = 1). The left blocks and right
+// blocks are indexed by their length. A block is dropped once it is
+// stale. In FileIO mode, the blocks which are used latest are spilled to the
+// block arena when the memory budget is exceeded, and the blocks which the next
+// update needs are prefetched.
+//
+// In FileIO mode every block carries a hash chain of the MPS and MPO tensors
+// it is built from. The hash is stored as the tag of the block in the arena,
+// thus a following run can reuse the blocks which are still valid. The
+// processes which share the runtime temporary path use different arena files.
+template <typename TenType>
+class BlockManager {
+public:
+  BlockManager(
+      const std::vector<TenType *> &mpo, const SweepParams &sweep_params,
+      const long update_sites = 2,
+      const std::string &arena_file = kBlockArenaFileName) :
+      N_(mpo.size()),
+      update_sites_(update_sites),
+      file_io_(sweep_params.FileIO),
+      mem_budget_(sweep_params.MemBudget * 1024 * 1024 * 1024),
+      blk_io_(sweep_params.AsyncFileIO, sweep_params.BlockCodec),
+      lblks_(N_), rblks_(N_) {
+    if (file_io_) {
+      blk_io_.Open(kRuntimeTempPath + "/" + arena_file, 4 * N_, true);
+      // The bulk tensors of a translation invariant MPO are shared by the
+      // sites, they are hashed once.
+      std::unordered_map<const TenType *, uint64_t> hashes;
+      for (auto pmpo_ten : mpo) {
+        auto it = hashes.find(pmpo_ten);
+        if (it == hashes.end()) {
+          it = hashes.emplace(pmpo_ten, HashTensor(*pmpo_ten)).first;
+        }
+        mpo_hashes_.push_back(it->second);
+      }
+    }
+  }
+
+  BlockManager(const BlockManager &) = delete;
+  BlockManager &operator=(const BlockManager &) = delete;
+
+  ~BlockManager(void) {
+    blk_io_.Sync();
+    for (auto pentries : {&lblks_, &rblks_}) {
+      for (auto &entry : *pentries) { delete entry.pblk; }
+    }
+  }
+
+  // Get the block, load it from the block arena if it was spilled.
+  TenType *Acquire(const char side, const long len) {
+    auto &entry = Entry_(side, len);
+    if (entry.pblk == nullptr && entry.stored) {
+      entry.pblk = blk_io_.Read(GenBlockName(side, len), false);
+      entry.bytes = BlockBytes(*entry.pblk);
+    }
+    entry.evicting = false;
+    return entry.pblk;
+  }
+
+  // Set a new block with its hash, the old one is dropped.
+  void Put(
+      const char side, const long len, TenType *pblk,
+      const uint64_t hash = 0) {
+    Drop_(side, len);
+    auto &entry = Entry_(side, len);
+    entry.pblk = pblk;
+    entry.bytes = BlockBytes(*pblk);
+    entry.hash = hash;
+  }
+
+  // Hash of the block with length 0.
+  uint64_t InitHash(const char side) const {
+    if (!file_io_) { return 0; }
+    return HashBytes(&side, 1, kFnvOffsetBasis ^ sizeof(TenType().scalar));
+  }
+
+  // Hash of the block grown from the block (side, len) by the MPS tensor.
+  uint64_t GrowHash(
+      const char side, const long len, const TenType &mps_ten) {
+    if (!file_io_) { return 0; }
+    auto site = (side == 'l') ? len : N_-1-len;
+    uint64_t site_hashes[2] = {HashTensor(mps_ten), mpo_hashes_[site]};
+    auto hash = HashBytes(
+                    reinterpret_cast<const char *>(site_hashes),
+                    sizeof(site_hashes),
+                    Entry_(side, len).hash);
+    return (hash != 0) ? hash : 1;    // Tag 0 means invalid.
+  }
+
+  // Take the block stored in the block arena if it has the hash.
+  bool Reuse(const char side, const long len, const uint64_t hash) {
+    if (!file_io_ || blk_io_.Tag(GenBlockName(side, len)) != hash) {
+      return false;
+    }
+    Drop_(side, len);
+    auto &entry = Entry_(side, len);
+    entry.stored = true;
+    entry.hash = hash;
+    return true;
+  }
+
+  // Drop a stale block. The blocks with zero length are always kept.
+  void Drop(const char side, const long len) {
+    if (len != 0) { Drop_(side, len); }
+  }
+
+  // Length of the block on the side which the update (i, dir) needs.
+  long BlockLen(const char side, const long i, const char dir) const {
+    if (update_sites_ == 1) { return (side == 'l') ? i : N_-i-1; }
+    if (side == 'l') {
+      return (dir == 'r') ? i : i-1;
+    } else {
+      return (dir == 'r') ? N_-i-2 : N_-i-1;
+    }
+  }
+
+  // Arrange the blocks for the update (i, dir) which will run next.
+  // Nothing to do in the memory mode, thus the updates which touch disjoint
+  // blocks can run concurrently.
+  void Arrange(const long i, const char dir) {
+    if (!file_io_) { return; }
+    for (auto pentries : {&lblks_, &rblks_}) {
+      for (auto &entry : *pentries) {
+        if (entry.evicting) {
+          blk_io_.Delete(entry.pblk);
+          entry.pblk = nullptr;
+          entry.evicting = false;
+        }
+      }
+    }
+
+    // The serialized copies in flight and the spilled blocks which the next
+    // update loads also take the memory budget.
+    auto lblk_len = BlockLen('l', i, dir);
+    auto rblk_len = BlockLen('r', i, dir);
+    auto pos = UpdatePos_(i, dir);
+    std::vector<std::pair<long, std::pair<char, long>>> cands;
+    size_t resident_bytes = blk_io_.InFlightBytes();
+    for (auto side_len : {std::make_pair('l', lblk_len),
+                          std::make_pair('r', rblk_len)}) {
+      auto &entry = Entry_(side_len.first, side_len.second);
+      if (entry.pblk == nullptr && entry.stored) {
+        resident_bytes += entry.bytes;
+      }
+    }
+    for (auto side : {'l', 'r'}) {
+      for (long len = 0; len < N_; ++len) {
+        auto &entry = Entry_(side, len);
+        if (entry.pblk == nullptr) { continue; }
+        resident_bytes += entry.bytes;
+        auto dist = NextUseDist_(side, len, pos);
+        if (len != 0 && dist != 0) {
+          cands.push_back(std::make_pair(dist, std::make_pair(side, len)));
+        }
+      }
+    }
+    // Spill the blocks which will be used latest. They are freed in the next
+    // arrangement when the writing has been finished.
+    std::sort(cands.begin(), cands.end());
+    while (resident_bytes > mem_budget_ && !cands.empty()) {
+      auto side = cands.back().second.first;
+      auto len = cands.back().second.second;
+      cands.pop_back();
+      auto &entry = Entry_(side, len);
+      if (!entry.stored) {
+        blk_io_.Write(entry.pblk, GenBlockName(side, len), entry.hash);
+        entry.stored = true;
+      }
+      entry.evicting = true;
+      resident_bytes -= entry.bytes;
+    }
+
+    // Prefetch the spilled blocks which the next update needs.
+    for (auto side_len : {std::make_pair('l', lblk_len),
+                          std::make_pair('r', rblk_len)}) {
+      auto &entry = Entry_(side_len.first, side_len.second);
+      if (entry.pblk == nullptr && entry.stored) {
+        blk_io_.Prefetch(GenBlockName(side_len.first, side_len.second));
+      }
+    }
+  }
+
+  // Arrange the blocks after the update (i, dir).
+  void ArrangeAfter(const long i, const char dir) {
+    if (dir == 'r') {
+      if (i < N_-2) {
+        Arrange(i+1, 'r');
+      } else {
+        Arrange(N_-1, 'l');
+      }
+    } else {
+      if (i > 1) {
+        Arrange(i-1, 'l');
+      } else {
+        Arrange(0, 'r');
+      }
+    }
+  }
+
+  // Write all the blocks to the block arena and the disk, thus a following
+  // run can continue from them.
+  void Flush(void) {
+    if (!file_io_) { return; }
+    for (auto side : {'l', 'r'}) {
+      for (long len = 0; len < N_; ++len) {
+        auto &entry = Entry_(side, len);
+        if (entry.pblk != nullptr && !entry.stored) {
+          blk_io_.Write(entry.pblk, GenBlockName(side, len), entry.hash);
+          entry.stored = true;
+        }
+      }
+    }
+    blk_io_.Persist();
+  }
+
+  BlockCodecStats CodecStats(void) { return blk_io_.CodecStats(); }
+
+private:
+  struct BlockEntry {
+    TenType *pblk = nullptr;
+    size_t bytes = 0;
+    uint64_t hash = 0;
+    bool stored = false;      // Has a copy in the block arena.
+    bool evicting = false;    // Will be freed in the next arrangement.
+  };
+
+  BlockEntry &Entry_(const char side, const long len) {
+    assert(len >= 0 && len < N_);
+    return (side == 'l') ? lblks_[len] : rblks_[len];
+  }
+
+  void Drop_(const char side, const long len) {
+    auto &entry = Entry_(side, len);
+    if (entry.pblk != nullptr) {
+      blk_io_.Delete(entry.pblk);
+      entry.pblk = nullptr;
+    }
+    if (entry.stored) {
+      blk_io_.Remove(GenBlockName(side, len));
+      entry.stored = false;
+    }
+    entry.bytes = 0;
+    entry.evicting = false;
+  }
+
+  // Position of the update in a sweep.
+  long UpdatePos_(const long i, const char dir) const {
+    return (dir == 'r') ? i : 2*N_-2-i;
+  }
+
+  // Number of updates before the block is used. The block is used by the
+  // update at pos (distance 0). The single-site updates at both directions
+  // on a site use the same blocks.
+  long NextUseDist_(const char side, const long len, const long pos) const {
+    auto period = 2*N_-2;
+    long use_pos1, use_pos2;
+    if (update_sites_ == 1) {
+      auto site = (side == 'l') ? len : N_-len-1;
+      use_pos1 = UpdatePos_(site, 'r');
+      use_pos2 = UpdatePos_(site, 'l');
+    } else if (side == 'l') {
+      use_pos1 = UpdatePos_(len, 'r');
+      use_pos2 = UpdatePos_(len+1, 'l');
+    } else {
+      use_pos1 = UpdatePos_(N_-len-2, 'r');
+      use_pos2 = UpdatePos_(N_-len-1, 'l');
+    }
+    auto dist1 = ((use_pos1 - pos) % period + period) % period;
+    auto dist2 = ((use_pos2 - pos) % period + period) % period;
+    return std::min(dist1, dist2);
+  }
+
+  long N_;
+  long update_sites_;
+  bool file_io_;
+  size_t mem_budget_;
+  BlockFileIO<TenType> blk_io_;
+  std::vector<uint64_t> mpo_hashes_;
+  std::vector<BlockEntry> lblks_;
+  std::vector<BlockEntry> rblks_;
+};
+} /* gqmps2 */
@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-20 10:30
+*
+* Description: GraceQ/MPS2 project. Implementation details for block Lanczos solver.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include "mkl.h"
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// A new basis vector is dropped when its norm after the orthogonalization
+// against the bases is less than it.
+const double kBlockLanczosMinBaseNorm = 1.0E-10;
+
+
+// Helpers.
+// Normalize the vector and orthogonalize it twice against the bases. Returns
+// the norm after the orthogonalization, the vector is normalized again if it
+// is not dropped.
+template <typename TenElemType>
+double BlockLanczosOrthogonalize(
+    GQTensor<TenElemType> *vec,
+    const std::vector<GQTensor<TenElemType> *> &bases) {
+  if (vec->Normalize() == 0.0) { return 0.0; }
+  for (long k = 0; k < 2; ++k) {
+    for (auto base : bases) {
+      auto overlap = DavidsonInner(base, vec);
+      LinearCombine({-overlap}, {base}, vec);
+    }
+  }
+  return vec->Normalize();
+}
+
+
+// Orthonormal block from the vectors, the dropped ones are deleted.
+template <typename TenElemType>
+std::vector<GQTensor<TenElemType> *> BlockLanczosNewBlock(
+    std::vector<GQTensor<TenElemType> *> &vecs,
+    const std::vector<GQTensor<TenElemType> *> &bases,
+    const long max_size) {
+  std::vector<GQTensor<TenElemType> *> block;
+  auto all_bases = bases;
+  for (auto vec : vecs) {
+    if (long(block.size()) < max_size &&
+        BlockLanczosOrthogonalize(vec, all_bases) >=
+        kBlockLanczosMinBaseNorm) {
+      block.push_back(vec);
+      all_bases.push_back(vec);
+    } else {
+      delete vec;
+    }
+  }
+  vecs.clear();
+  return block;
+}
+
+
+// Block Lanczos solver for the k lowest eigenstates, k is the number of the
+// initial states. The matrix-vector multiplications of each block run as one
+// batch of the contraction plan, thus the block products become larger matrix
+// multiplications. The bases are fully reorthogonalized. Once their number
+// reaches block_lanczos_max_bases, the iteration is thick restarted from the k
+// lowest Ritz vectors, the next block is their products orthogonalized against
+// them. The iteration stops when none of the k lowest energies changes more
+// than the error, the matrix-vector multiplications reach k times
+// max_iterations, or the bases span the effective Hamiltonian. The returned
+// iteration number is the number of the matrix-vector multiplications.
+template <typename TenElemType>
+BlockLanczosRes<TenElemType> BlockLanczosSolver(
+    const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
+    std::vector<GQTensor<TenElemType> *> &init_states,
+    const LanczosParams &params,
+    const std::string &where,
+    UpdateArena *parena) {
+  // Take care that init_states will be destroyed after call the solver.
+  long k = init_states.size();
+  auto eff_ham_eff_dim = EffHamDim(rpeff_ham, where);
+  if (eff_ham_eff_dim < k) {
+    std::cout << "The effective Hamiltonian of dimension " << eff_ham_eff_dim
+              << " has less than " << k << " eigenstates." << std::endl;
+    exit(1);
+  }
+  UpdateArena local_arena;
+  auto &arena = (parena != nullptr) ? *parena : local_arena;
+  EffHamMulStatePlan<TenElemType> eff_ham_mul_state(
+      rpeff_ham, where, arena, SharedThreadPool(params.matvec_threads));
+  auto max_iters = k * params.max_iterations;
+  auto max_bases = std::min(
+                       eff_ham_eff_dim,
+                       std::max(params.block_lanczos_max_bases, 3*k));
+  BlockLanczosRes<TenElemType> lancz_res;
+
+  // Projected Hamiltonian h(i, j) = <base_i|H|base_j>, upper triangle.
+  std::vector<TenElemType> h(max_bases*max_bases, TenElemType(0.0));
+  std::vector<GQTensor<TenElemType> *> bases;
+  std::vector<GQTensor<TenElemType> *> hbases;
+  auto block = BlockLanczosNewBlock(init_states, bases, max_bases);
+  if (long(block.size()) < k) {
+    std::cout << "The initial states of the block Lanczos solver are "
+              << "linearly dependent." << std::endl;
+    exit(1);
+  }
+  long iters = 0;
+  std::vector<double> energies;
+  std::vector<TenElemType> a;
+  std::vector<double> w;
+  std::vector<GQTensor<TenElemType> *> hblock;
+  while (true) {
+    hblock = eff_ham_mul_state(block);
+    iters += block.size();
+    auto m0 = bases.size();
+    bases.insert(bases.end(), block.begin(), block.end());
+    hbases.insert(hbases.end(), hblock.begin(), hblock.end());
+    long m = bases.size();
+    for (long j = m0; j < m; ++j) {
+      for (long i = 0; i <= j; ++i) {
+        h[i*max_bases + j] = DavidsonInner(bases[i], hbases[j]);
+      }
+    }
+
+    a.assign(m*m, TenElemType(0.0));
+    for (long i = 0; i < m; ++i) {
+      for (long j = i; j < m; ++j) { a[i*m + j] = h[i*max_bases + j]; }
+    }
+    w.resize(m);
+    SubspaceHeev(m, a.data(), w.data());
+    bool converged = !energies.empty();
+    for (long i = 0; i < k && converged; ++i) {
+      converged = (std::abs(energies[i] - w[i]) < params.error);
+    }
+    energies.assign(w.begin(), w.begin() + k);
+
+    auto done = converged || iters >= max_iters || m >= eff_ham_eff_dim;
+    if (!done && m == max_bases) {
+      // Thick restart. The projected Hamiltonian on the Ritz vectors is
+      // diagonal.
+      std::vector<GQTensor<TenElemType> *> ritz_vecs, hritz_vecs;
+      for (long i = 0; i < k; ++i) {
+        std::vector<TenElemType> coefs(m);
+        for (long j = 0; j < m; ++j) { coefs[j] = a[j*m + i]; }
+        auto vec = new GQTensor<TenElemType>(bases[0]->indexes);
+        LinearCombine(coefs, bases, vec);
+        auto hvec = new GQTensor<TenElemType>(bases[0]->indexes);
+        LinearCombine(coefs, hbases, hvec);
+        ritz_vecs.push_back(vec);
+        hritz_vecs.push_back(hvec);
+      }
+      DavidsonFree(bases, hbases);
+      bases = ritz_vecs;
+      hbases = hritz_vecs;
+      hblock = hritz_vecs;
+      std::fill(h.begin(), h.end(), TenElemType(0.0));
+      a.assign(k*k, TenElemType(0.0));
+      for (long i = 0; i < k; ++i) {
+        h[i*max_bases + i] = w[i];
+        a[i*k + i] = TenElemType(1.0);
+      }
+      m = k;
+    }
+
+    // The next block is H times the current one orthogonalized against the
+    // bases, an empty one spans an invariant subspace.
+    if (!done) {
+      std::vector<GQTensor<TenElemType> *> vecs;
+      for (auto hbase : hblock) {
+        vecs.push_back(new GQTensor<TenElemType>(*hbase));
+      }
+      block = BlockLanczosNewBlock(vecs, bases, max_bases - m);
+      done = block.empty();
+    }
+    if (done) {
+      for (long i = 0; i < k; ++i) {
+        std::vector<TenElemType> coefs(m);
+        for (long j = 0; j < m; ++j) { coefs[j] = a[j*m + i]; }
+        auto vec = new GQTensor<TenElemType>(bases[0]->indexes);
+        LinearCombine(coefs, bases, vec);
+        lancz_res.vecs.push_back(vec);
+      }
+      DavidsonFree(bases, hbases);
+      lancz_res.iters = iters;
+      lancz_res.engs = energies;
+      return lancz_res;
+    }
+  }
+}
+} /* gqmps2 */
@@ -0,0 +1,247 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-17 10:20
+*
+* Description: GraceQ/MPS2 project. Implementation details for sweep checkpoint.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <future>
+#include <cstdio>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Position of an update in the sweeps.
+struct SweepPosition {
+  long sweep;
+  long site;
+  char dir;
+};
+
+
+// Position of the update after the given one.
+inline SweepPosition NextSweepPosition(
+    const SweepPosition &pos, const long N) {
+  if (pos.dir == 'r') {
+    if (pos.site < N-2) {
+      return {pos.sweep, pos.site+1, 'r'};
+    } else {
+      return {pos.sweep, N-1, 'l'};
+    }
+  } else {
+    if (pos.site > 1) {
+      return {pos.sweep, pos.site-1, 'l'};
+    } else {
+      return {pos.sweep+1, 0, 'r'};
+    }
+  }
+}
+
+
+// Write the file through a temporary file, thus the file is either the old
+// one or the new one.
+inline void WriteFileAtomic(const std::string &file, const std::string &data) {
+  auto temp_file = file + ".tmp";
+  auto fd = open(temp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    std::cout << "Unable to open " << temp_file << std::endl;
+    exit(1);
+  }
+  size_t written_size = 0;
+  while (written_size < data.size()) {
+    auto size = write(
+                    fd,
+                    data.data() + written_size,
+                    data.size() - written_size);
+    if (size < 0) {
+      std::cout << "Unable to write " << temp_file << std::endl;
+      exit(1);
+    }
+    written_size += size;
+  }
+  fsync(fd);
+  close(fd);
+  if (std::rename(temp_file.c_str(), file.c_str()) != 0) {
+    std::cout << "Unable to rename " << temp_file << std::endl;
+    exit(1);
+  }
+}
+
+
+// Checkpoint of the two-site sweeps. A checkpoint holds the position of the
+// next update, the energies of the current sweep and the MPS. Only the MPS
+// tensors changed since the last checkpoint are written, in background. The
+// blocks are not part of the checkpoint, the valid ones are found in the
+// block arena by their hashes when resuming.
+template <typename TenType>
+class SweepCheckpoint {
+public:
+  SweepCheckpoint(const long N, const SweepParams &sweep_params) :
+      N_(N),
+      interval_(sweep_params.CheckpointInterval),
+      max_updates_(sweep_params.MaxUpdates),
+      ten_ids_(N, -1),
+      dirty_(N, true) {
+    if (interval_ > 0 && !sweep_params.FileIO) {
+      std::cout << "Checkpoints need the FileIO mode, "
+                << "set CheckpointInterval to 0 or turn FileIO on" << std::endl;
+      exit(1);
+    }
+  }
+
+  SweepCheckpoint(const SweepCheckpoint &) = delete;
+  SweepCheckpoint &operator=(const SweepCheckpoint &) = delete;
+
+  ~SweepCheckpoint(void) { Wait_(); }
+
+  // Load the last checkpoint. Return false if there is no checkpoint.
+  bool Load(
+      std::vector<TenType *> &mps,
+      SweepPosition &pos, std::vector<double> &energies) {
+    if (!ReadState_(pos, energies)) { return false; }
+    for (long i = 0; i < N_; ++i) {
+      std::ifstream ten_ifs(TenFile_(i, ten_ids_[i]), std::ifstream::binary);
+      if (!ten_ifs) {
+        std::cout << "Unable to open " << TenFile_(i, ten_ids_[i])
+                  << std::endl;
+        exit(1);
+      }
+      delete mps[i];
+      mps[i] = new TenType();
+      bfread(ten_ifs, *mps[i]);
+      ten_ifs.close();
+      dirty_[i] = false;
+    }
+    return true;
+  }
+
+  void MarkDirty(const long site) { dirty_[site] = true; }
+
+  // Count an update. Return true if a checkpoint is due.
+  bool Tick(void) {
+    ++update_num_;
+    if (interval_ <= 0) { return false; }
+    return update_num_ % interval_ == 0;
+  }
+
+  // The job stops as an interrupted one once MaxUpdates updates are counted.
+  bool Interrupted(void) const {
+    return max_updates_ > 0 && update_num_ >= max_updates_;
+  }
+
+  // The MPS tensors are serialized here, the files are written in background.
+  void Write(
+      const std::vector<TenType *> &mps,
+      const SweepPosition &pos, const std::vector<double> &energies) {
+    Wait_();
+    ++ckpt_id_;
+    std::vector<std::pair<std::string, std::string>> ten_files;
+    std::vector<std::string> old_ten_files;
+    for (long i = 0; i < N_; ++i) {
+      if (!dirty_[i]) { continue; }
+      if (ten_ids_[i] >= 0) {
+        old_ten_files.push_back(TenFile_(i, ten_ids_[i]));
+      }
+      ten_ids_[i] = ckpt_id_;
+      ten_files.push_back(
+          std::make_pair(TenFile_(i, ckpt_id_), DumpBlockToBytes(*mps[i])));
+      dirty_[i] = false;
+    }
+
+    std::ostringstream state;
+    state << ckpt_id_ << "\n"
+          << pos.sweep << " " << pos.site << " " << pos.dir << "\n"
+          << N_ << "\n";
+    for (auto ten_id : ten_ids_) { state << ten_id << " "; }
+    state << "\n" << energies.size() << "\n";
+    state << std::setprecision(17);
+    for (auto energy : energies) { state << energy << "\n"; }
+
+    auto state_file = StateFile_();
+    auto write = [ten_files, old_ten_files, state_file](
+                     const std::string &state) {
+                   for (auto &ten_file : ten_files) {
+                     WriteFileAtomic(ten_file.first, ten_file.second);
+                   }
+                   WriteFileAtomic(state_file, state);
+                   for (auto &old_ten_file : old_ten_files) {
+                     std::remove(old_ten_file.c_str());
+                   }
+                 };
+    pending_write_ = std::async(std::launch::async, write, state.str());
+  }
+
+  // Remove the checkpoint, also the one left by the last run.
+  void Clear(void) {
+    Wait_();
+    if (ckpt_id_ == 0) {
+      SweepPosition pos;
+      std::vector<double> energies;
+      ReadState_(pos, energies);
+    }
+    std::remove(StateFile_().c_str());
+    for (long i = 0; i < N_; ++i) {
+      if (ten_ids_[i] >= 0) {
+        std::remove(TenFile_(i, ten_ids_[i]).c_str());
+      }
+      ten_ids_[i] = -1;
+      dirty_[i] = true;
+    }
+  }
+
+private:
+  bool ReadState_(SweepPosition &pos, std::vector<double> &energies) {
+    std::ifstream ifs(StateFile_());
+    if (!ifs) { return false; }
+    long N;
+    ifs >> ckpt_id_ >> pos.sweep >> pos.site >> pos.dir >> N;
+    if (!ifs || N != N_) {
+      std::cout << "Invalid checkpoint " << StateFile_() << std::endl;
+      exit(1);
+    }
+    for (auto &ten_id : ten_ids_) { ifs >> ten_id; }
+    size_t energy_num;
+    ifs >> energy_num;
+    energies.resize(energy_num);
+    for (auto &energy : energies) { ifs >> energy; }
+    return true;
+  }
+
+  std::string StateFile_(void) const {
+    return kRuntimeTempPath + "/" + kCheckpointFileName;
+  }
+
+  std::string TenFile_(const long i, const long ckpt_id) const {
+    return kRuntimeTempPath + "/" +
+           kCheckpointMpsTenBaseName + std::to_string(i) + "_" +
+           std::to_string(ckpt_id) + "." + kGQTenFileSuffix;
+  }
+
+  void Wait_(void) {
+    if (pending_write_.valid()) { pending_write_.get(); }
+  }
+
+  long N_;
+  long interval_;
+  long max_updates_;
+  long update_num_ = 0;
+  long ckpt_id_ = 0;
+  std::vector<long> ten_ids_;     // Checkpoint id of the stored MPS tensors.
+  std::vector<bool> dirty_;
+  std::future<void> pending_write_;
+};
+} /* gqmps2 */
@@ -0,0 +1,718 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-17 16:40
+*
+* Description: GraceQ/MPS2 project. Implementation details for reusable contraction plans of the effective Hamiltonian.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqmps2/detail/update_arena.h"
+#include "gqmps2/detail/thread_pool.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include <functional>
+
+#include <assert.h>
+
+#include "mkl.h"
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Helpers.
+// Id of the quantum number sector in the index, -1 if not found.
+inline long QNSectorId(const Index &index, const QNSector &qnsct) {
+  for (size_t i = 0; i < index.qnscts.size(); ++i) {
+    if (index.qnscts[i].qn == qnsct.qn) { return i; }
+  }
+  return -1;
+}
+
+
+// Offsets of the quantum number sectors in the index.
+inline std::vector<long> QNSectorOffsets(const Index &index) {
+  std::vector<long> offsets(index.qnscts.size(), 0);
+  for (size_t i = 1; i < offsets.size(); ++i) {
+    offsets[i] = offsets[i-1] + index.qnscts[i-1].dim;
+  }
+  return offsets;
+}
+
+
+template <typename TenElemType>
+std::vector<long> BlockSectorIds(
+    const GQTensor<TenElemType> &ten, const QNBlock<TenElemType> *pblk) {
+  std::vector<long> ids(pblk->ndim);
+  for (long k = 0; k < pblk->ndim; ++k) {
+    ids[k] = QNSectorId(ten.indexes[k], pblk->qnscts[k]);
+  }
+  return ids;
+}
+
+
+// Row-major block data with the legs permuted, dest(i_perm[0], ...) =
+// src(i_0, ...).
+template <typename TenElemType>
+void TransposeBlockData(
+    const TenElemType *src, const std::vector<long> &shape,
+    const std::vector<long> &perm, TenElemType *dest) {
+  long ndim = shape.size();
+  std::vector<long> src_strides(ndim, 1);
+  for (long k = ndim-2; k >= 0; --k) {
+    src_strides[k] = src_strides[k+1] * shape[k+1];
+  }
+  std::vector<long> dest_shape(ndim), dest_strides(ndim);
+  long size = 1;
+  for (long k = 0; k < ndim; ++k) {
+    dest_shape[k] = shape[perm[k]];
+    dest_strides[k] = src_strides[perm[k]];
+    size *= dest_shape[k];
+  }
+  std::vector<long> coors(ndim, 0);
+  long src_offset = 0;
+  for (long i = 0; i < size; ++i) {
+    dest[i] = src[src_offset];
+    for (long k = ndim-1; k >= 0; --k) {
+      src_offset += dest_strides[k];
+      if (++coors[k] < dest_shape[k]) { break; }
+      src_offset -= dest_strides[k] * dest_shape[k];
+      coors[k] = 0;
+    }
+  }
+}
+
+
+// c = a * b + beta * c for row-major matrices, beta is 0 or 1.
+inline void BlockGemm(
+    const long m, const long n, const long k,
+    const GQTEN_Double *a, const GQTEN_Double *b, GQTEN_Double *c,
+    const double beta = 1.0) {
+  cblas_dgemm(
+      CblasRowMajor, CblasNoTrans, CblasNoTrans,
+      m, n, k,
+      1.0, a, k, b, n,
+      beta, c, n);
+}
+
+
+inline void BlockGemm(
+    const long m, const long n, const long k,
+    const GQTEN_Complex *a, const GQTEN_Complex *b, GQTEN_Complex *c,
+    const double beta = 1.0) {
+  GQTEN_Complex zalpha(1.0), zbeta(beta);
+  cblas_zgemm(
+      CblasRowMajor, CblasNoTrans, CblasNoTrans,
+      m, n, k,
+      &zalpha, a, k, b, n,
+      &zbeta, c, n);
+}
+
+
+// Plan of the contraction c = Contract(a, b, axes) for fixed block structures
+// of the operands and the result. The matched block pairs are recorded once.
+// The blocks of a fixed operand are transposed to the matrix form once, the
+// others are transposed to reused buffers in every execution. The buffers
+// live in the update arena. With a thread pool, the blocks of the result are
+// distributed to the threads with all the products which accumulate to them,
+// thus no reduction is needed.
+template <typename TenElemType>
+class BlockCtrctPlan {
+public:
+  BlockCtrctPlan(
+      const GQTensor<TenElemType> &a, const GQTensor<TenElemType> &b,
+      const std::vector<std::vector<long>> &axes,
+      const GQTensor<TenElemType> &c,
+      const bool a_fixed, const bool b_fixed,
+      UpdateArena &arena) : parena_(&arena) {
+    auto a_free_legs = InitOperand_(a, axes[0], true, a_fixed, a_opd_);
+    auto b_free_legs = InitOperand_(b, axes[1], false, b_fixed, b_opd_);
+
+    std::map<std::vector<long>, long> c_slots;
+    auto c_blks = c.cblocks();
+    for (size_t i = 0; i < c_blks.size(); ++i) {
+      c_slots[BlockSectorIds(c, c_blks[i])] = i;
+    }
+
+    // Contracted sectors of a to the ones of b.
+    auto ctrct_leg_num = axes[0].size();
+    std::vector<std::vector<long>> ctrct_sct_maps(ctrct_leg_num);
+    for (size_t t = 0; t < ctrct_leg_num; ++t) {
+      for (auto &qnsct : a.indexes[axes[0][t]].qnscts) {
+        ctrct_sct_maps[t].push_back(QNSectorId(b.indexes[axes[1][t]], qnsct));
+      }
+    }
+
+    std::map<std::vector<long>, std::vector<long>> b_groups;
+    auto b_blks = b.cblocks();
+    for (size_t j = 0; j < b_blks.size(); ++j) {
+      auto ids = BlockSectorIds(b, b_blks[j]);
+      std::vector<long> ctrct_ids;
+      for (auto leg : axes[1]) { ctrct_ids.push_back(ids[leg]); }
+      b_groups[ctrct_ids].push_back(j);
+    }
+
+    auto a_blks = a.cblocks();
+    for (size_t i = 0; i < a_blks.size(); ++i) {
+      auto a_ids = BlockSectorIds(a, a_blks[i]);
+      std::vector<long> ctrct_ids;
+      for (size_t t = 0; t < ctrct_leg_num; ++t) {
+        ctrct_ids.push_back(ctrct_sct_maps[t][a_ids[axes[0][t]]]);
+      }
+      auto poss_it = b_groups.find(ctrct_ids);
+      if (poss_it == b_groups.end()) { continue; }
+      for (auto j : poss_it->second) {
+        auto b_ids = BlockSectorIds(b, b_blks[j]);
+        std::vector<long> c_ids;
+        for (auto leg : a_free_legs) { c_ids.push_back(a_ids[leg]); }
+        for (auto leg : b_free_legs) { c_ids.push_back(b_ids[leg]); }
+        auto c_it = c_slots.find(c_ids);
+        if (c_it == c_slots.end()) {
+          valid_ = false;
+          return;
+        }
+        tasks_.push_back({
+            long(i), long(j), c_it->second,
+            a_opd_.rows[i], b_opd_.cols[j], a_opd_.cols[i]});
+        a_opd_.used[i] = true;
+        b_opd_.used[j] = true;
+      }
+    }
+    if (a_fixed) { Transpose_(a_opd_, a_blks, nullptr); }
+    if (b_fixed) { Transpose_(b_opd_, b_blks, nullptr); }
+
+    // Group the products by the block of the result, the expensive groups
+    // first.
+    std::vector<std::vector<long>> c_tasks(c_blks.size());
+    std::vector<double> c_costs(c_blks.size(), 0.0);
+    for (size_t t = 0; t < tasks_.size(); ++t) {
+      auto &task = tasks_[t];
+      c_tasks[task.c_blk].push_back(t);
+      c_costs[task.c_blk] += double(task.m) * task.n * task.k;
+    }
+    for (size_t i = 0; i < c_blks.size(); ++i) {
+      if (c_tasks[i].empty()) {
+        idle_c_blks_.push_back(i);
+      } else {
+        groups_.push_back({long(i), c_costs[i], c_tasks[i]});
+      }
+    }
+    std::stable_sort(
+        groups_.begin(), groups_.end(),
+        [](const Group &a, const Group &b) { return a.cost > b.cost; });
+  }
+
+  BlockCtrctPlan(const BlockCtrctPlan &) = delete;
+  BlockCtrctPlan &operator=(const BlockCtrctPlan &) = delete;
+
+  // The blocks are given in the order of the planned tensors.
+  void Execute(
+      const std::vector<const QNBlock<TenElemType> *> &a_blks,
+      const std::vector<const QNBlock<TenElemType> *> &b_blks,
+      const std::vector<QNBlock<TenElemType> *> &c_blks,
+      ThreadPool *ppool = nullptr) {
+    for (auto i : idle_c_blks_) {
+      auto pblk = c_blks[i];
+      std::fill(pblk->data(), pblk->data() + pblk->size, TenElemType(0.0));
+    }
+    auto a_data = Data_(a_opd_, a_blks, ppool);
+    auto b_data = Data_(b_opd_, b_blks, ppool);
+    // The first product of a group overwrites the block of the result.
+    auto run_group = [this, &a_data, &b_data, &c_blks](const long g) {
+      auto &group = groups_[g];
+      auto pblk = c_blks[group.c_blk];
+      double beta = 0.0;
+      for (auto t : group.tasks) {
+        auto &task = tasks_[t];
+        BlockGemm(
+            task.m, task.n, task.k,
+            a_data[task.a_blk], b_data[task.b_blk],
+            pblk->data(), beta);
+        beta = 1.0;
+      }
+    };
+    RunGroups_(run_group, ppool);
+  }
+
+  // Execute the plan for several values of the operand which is not fixed
+  // at once. Their matrix forms are stacked one over another (a) or side by
+  // side (b), thus each planned block product is one larger matrix
+  // multiplication for all of them. The blocks of the result are given for
+  // each value.
+  void ExecuteBatch(
+      const std::vector<const QNBlock<TenElemType> *> &fixed_blks,
+      const std::vector<std::vector<const QNBlock<TenElemType> *>> &var_blks,
+      const std::vector<std::vector<QNBlock<TenElemType> *>> &c_blks,
+      ThreadPool *ppool = nullptr) {
+    assert(a_opd_.fixed != b_opd_.fixed);
+    assert(var_blks.size() == c_blks.size());
+    long nb = var_blks.size();
+    for (auto &val_c_blks : c_blks) {
+      for (auto i : idle_c_blks_) {
+        auto pblk = val_c_blks[i];
+        std::fill(pblk->data(), pblk->data() + pblk->size, TenElemType(0.0));
+      }
+    }
+    auto var_a = b_opd_.fixed;
+    auto fixed_data = Data_(var_a ? b_opd_ : a_opd_, fixed_blks, ppool);
+    StackBlocks_(var_a ? a_opd_ : b_opd_, var_a, var_blks, ppool);
+
+    // The buffers are allocated from the arena before the parallel part.
+    if (batch_c_bufs_.size() != groups_.size()) {
+      batch_c_bufs_.assign(
+          groups_.size(),
+          UpdateArenaVector<TenElemType>(
+              UpdateArenaAllocator<TenElemType>(parena_)));
+    }
+    for (size_t g = 0; g < groups_.size(); ++g) {
+      batch_c_bufs_[g].resize(nb * c_blks[0][groups_[g].c_blk]->size);
+    }
+    auto run_group = [this, nb, var_a, &fixed_data, &c_blks](const long g) {
+      auto &group = groups_[g];
+      auto &buf = batch_c_bufs_[g];
+      double beta = 0.0;
+      for (auto t : group.tasks) {
+        auto &task = tasks_[t];
+        if (var_a) {
+          BlockGemm(
+              nb * task.m, task.n, task.k,
+              batch_bufs_[task.a_blk].data(), fixed_data[task.b_blk],
+              buf.data(), beta);
+        } else {
+          BlockGemm(
+              task.m, nb * task.n, task.k,
+              fixed_data[task.a_blk], batch_bufs_[task.b_blk].data(),
+              buf.data(), beta);
+        }
+        beta = 1.0;
+      }
+      auto m = tasks_[group.tasks[0]].m, n = tasks_[group.tasks[0]].n;
+      for (long v = 0; v < nb; ++v) {
+        auto data = c_blks[v][group.c_blk]->data();
+        if (var_a) {
+          std::copy(buf.begin() + v*m*n, buf.begin() + (v+1)*m*n, data);
+          continue;
+        }
+        for (long r = 0; r < m; ++r) {
+          std::copy(
+              buf.begin() + (r*nb + v)*n, buf.begin() + (r*nb + v + 1)*n,
+              data + r*n);
+        }
+      }
+    };
+    RunGroups_(run_group, ppool);
+  }
+
+  // False if a block of the result is missing, the plan can not be used.
+  bool Valid(void) const { return valid_; }
+
+private:
+  struct Operand {
+    std::vector<long> perm;       // Legs in the matrix form.
+    bool identity;
+    bool fixed;
+    std::vector<long> rows;
+    std::vector<long> cols;
+    std::vector<bool> used;
+    std::vector<UpdateArenaVector<TenElemType>> bufs;
+  };
+
+  struct Task {
+    long a_blk;
+    long b_blk;
+    long c_blk;
+    long m;
+    long n;
+    long k;
+  };
+
+  struct Group {
+    long c_blk;
+    double cost;
+    std::vector<long> tasks;
+  };
+
+  // The free legs are the rows of a and the columns of b.
+  std::vector<long> InitOperand_(
+      const GQTensor<TenElemType> &ten, const std::vector<long> &ctrct_legs,
+      const bool is_a, const bool fixed, Operand &opd) {
+    std::vector<long> free_legs;
+    for (long k = 0; k < long(ten.indexes.size()); ++k) {
+      if (std::find(ctrct_legs.begin(), ctrct_legs.end(), k) ==
+          ctrct_legs.end()) {
+        free_legs.push_back(k);
+      }
+    }
+    if (is_a) {
+      opd.perm = free_legs;
+      opd.perm.insert(opd.perm.end(), ctrct_legs.begin(), ctrct_legs.end());
+    } else {
+      opd.perm = ctrct_legs;
+      opd.perm.insert(opd.perm.end(), free_legs.begin(), free_legs.end());
+    }
+    opd.identity = true;
+    for (size_t k = 0; k < opd.perm.size(); ++k) {
+      if (opd.perm[k] != long(k)) { opd.identity = false; }
+    }
+    opd.fixed = fixed;
+    auto row_leg_num = is_a ? free_legs.size() : ctrct_legs.size();
+    for (auto pblk : ten.cblocks()) {
+      long rows = 1, cols = 1;
+      for (size_t k = 0; k < opd.perm.size(); ++k) {
+        if (k < row_leg_num) {
+          rows *= pblk->shape[opd.perm[k]];
+        } else {
+          cols *= pblk->shape[opd.perm[k]];
+        }
+      }
+      opd.rows.push_back(rows);
+      opd.cols.push_back(cols);
+    }
+    opd.used.assign(opd.rows.size(), false);
+    opd.bufs.assign(
+        opd.rows.size(),
+        UpdateArenaVector<TenElemType>(
+            UpdateArenaAllocator<TenElemType>(parena_)));
+    return free_legs;
+  }
+
+  // The buffers are allocated from the arena before the parallel part.
+  void Transpose_(
+      Operand &opd, const std::vector<const QNBlock<TenElemType> *> &blks,
+      ThreadPool *ppool) {
+    if (opd.identity) { return; }
+    for (size_t i = 0; i < blks.size(); ++i) {
+      if (opd.used[i]) { opd.bufs[i].resize(blks[i]->size); }
+    }
+    auto transpose = [&opd, &blks](const long i) {
+      if (!opd.used[i]) { return; }
+      TransposeBlockData(
+          blks[i]->cdata(), blks[i]->shape, opd.perm, opd.bufs[i].data());
+    };
+    if (ppool == nullptr) {
+      for (size_t i = 0; i < blks.size(); ++i) { transpose(i); }
+    } else {
+      ppool->ParallelFor(blks.size(), transpose);
+    }
+  }
+
+  std::vector<const TenElemType *> Data_(
+      Operand &opd, const std::vector<const QNBlock<TenElemType> *> &blks,
+      ThreadPool *ppool) {
+    std::vector<const TenElemType *> data(blks.size(), nullptr);
+    if (opd.identity) {
+      for (size_t i = 0; i < blks.size(); ++i) { data[i] = blks[i]->cdata(); }
+      return data;
+    }
+    if (!opd.fixed) { Transpose_(opd, blks, ppool); }
+    for (size_t i = 0; i < blks.size(); ++i) { data[i] = opd.bufs[i].data(); }
+    return data;
+  }
+
+  // Matrix forms of the blocks of all the values in the batch buffers, the
+  // ones of a one over another and the ones of b row by row side by side.
+  void StackBlocks_(
+      Operand &opd, const bool is_a,
+      const std::vector<std::vector<const QNBlock<TenElemType> *>> &var_blks,
+      ThreadPool *ppool) {
+    long nb = var_blks.size();
+    auto blk_num = opd.rows.size();
+    if (batch_bufs_.size() != blk_num) {
+      batch_bufs_.assign(
+          blk_num,
+          UpdateArenaVector<TenElemType>(
+              UpdateArenaAllocator<TenElemType>(parena_)));
+    }
+    for (size_t i = 0; i < blk_num; ++i) {
+      if (!opd.used[i]) { continue; }
+      batch_bufs_[i].resize(nb * opd.rows[i] * opd.cols[i]);
+      if (!is_a && !opd.identity) {
+        opd.bufs[i].resize(opd.rows[i] * opd.cols[i]);
+      }
+    }
+    auto stack = [this, &opd, is_a, nb, &var_blks](const long i) {
+      if (!opd.used[i]) { return; }
+      auto rows = opd.rows[i], cols = opd.cols[i];
+      auto dst = batch_bufs_[i].data();
+      for (long v = 0; v < nb; ++v) {
+        auto pblk = var_blks[v][i];
+        if (is_a) {
+          if (opd.identity) {
+            std::copy(
+                pblk->cdata(), pblk->cdata() + rows*cols, dst + v*rows*cols);
+          } else {
+            TransposeBlockData(
+                pblk->cdata(), pblk->shape, opd.perm, dst + v*rows*cols);
+          }
+          continue;
+        }
+        auto src = pblk->cdata();
+        if (!opd.identity) {
+          TransposeBlockData(
+              pblk->cdata(), pblk->shape, opd.perm, opd.bufs[i].data());
+          src = opd.bufs[i].data();
+        }
+        for (long r = 0; r < rows; ++r) {
+          std::copy(
+              src + r*cols, src + (r+1)*cols, dst + (r*nb + v)*cols);
+        }
+      }
+    };
+    if (ppool == nullptr) {
+      for (size_t i = 0; i < blk_num; ++i) { stack(i); }
+    } else {
+      ppool->ParallelFor(blk_num, stack);
+    }
+  }
+
+  void RunGroups_(
+      const std::function<void(long)> &run_group, ThreadPool *ppool) {
+    if (ppool == nullptr) {
+      for (size_t g = 0; g < groups_.size(); ++g) { run_group(g); }
+    } else {
+      // One MKL thread for each thread of the pool.
+      ppool->ParallelFor(
+          groups_.size(),
+          [&run_group](const long g) {
+            auto mkl_threads = mkl_set_num_threads_local(1);
+            run_group(g);
+            mkl_set_num_threads_local(mkl_threads);
+          });
+    }
+  }
+
+  UpdateArena *parena_;
+  bool valid_ = true;
+  Operand a_opd_;
+  Operand b_opd_;
+  std::vector<Task> tasks_;
+  std::vector<Group> groups_;
+  std::vector<long> idle_c_blks_;
+  std::vector<UpdateArenaVector<TenElemType>> batch_bufs_;
+  std::vector<UpdateArenaVector<TenElemType>> batch_c_bufs_;
+};
+
+
+// Effective Hamiltonian prepared for the repeated multiplications in one
+// update. The first multiplication runs the contractions, records their plans
+// and keeps the intermediate tensors as the workspace. The following
+// multiplications on states with the same block structure only do the block
+// matrix multiplications. A state with another block structure is planned
+// again. The arena must not be reset during the life of the plan. The block
+// multiplications of the planned ones run on the thread pool if given.
+template <typename TenElemType>
+class EffHamMulStatePlan {
+public:
+  EffHamMulStatePlan(
+      const std::vector<GQTensor<TenElemType> *> &eff_ham,
+      const std::string &where,
+      UpdateArena &arena,
+      ThreadPool *ppool = nullptr) :
+      eff_ham_(eff_ham), arena_(arena), ppool_(ppool) {
+    // The same contractions as eff_ham_mul_state_cent/lend/rend.
+    if (where == "cent") {
+      steps_ = {{0, {{0}, {0}}, false},
+                {1, {{0, 2}, {0, 1}}, true},
+                {2, {{4, 1}, {0, 1}}, true},
+                {3, {{4, 1}, {1, 0}}, true}};
+    } else if (where == "lend") {
+      steps_ = {{1, {{0}, {0}}, true},
+                {2, {{0, 2}, {1, 0}}, true},
+                {3, {{0, 3}, {0, 1}}, true}};
+    } else if (where == "rend") {
+      steps_ = {{0, {{0}, {0}}, true},
+                {1, {{2, 0}, {0, 1}}, true},
+                {2, {{3, 0}, {1, 0}}, true}};
+    } else if (where == "single_cent") {
+      // eff_ham = {L, W, R} for the single-site positions.
+      steps_ = {{0, {{0}, {0}}, false},
+                {1, {{0, 2}, {0, 1}}, true},
+                {2, {{1, 3}, {0, 1}}, true}};
+    } else if (where == "single_lend") {
+      steps_ = {{1, {{0}, {0}}, true},
+                {2, {{0, 1}, {0, 1}}, true}};
+    } else if (where == "single_rend") {
+      steps_ = {{0, {{0}, {0}}, true},
+                {1, {{0, 1}, {0, 1}}, true}};
+    } else {
+      std::cout << "Unknown effective Hamiltonian position " << where
+                << std::endl;
+      exit(1);
+    }
+  }
+
+  EffHamMulStatePlan(const EffHamMulStatePlan &) = delete;
+  EffHamMulStatePlan &operator=(const EffHamMulStatePlan &) = delete;
+
+  ~EffHamMulStatePlan(void) { Free_(); }
+
+  GQTensor<TenElemType> *operator()(const GQTensor<TenElemType> *state) {
+    ++mul_num_;
+    std::vector<const QNBlock<TenElemType> *> state_blks;
+    if (valid_ && MatchState_(*state, state_blks)) {
+      return Execute_(state_blks);
+    }
+    return Plan_(*state);
+  }
+
+  // Multiply the states with the same block structure at once, each block
+  // product of the planned contractions is one matrix multiplication for all
+  // of them. Otherwise the states are multiplied one by one.
+  std::vector<GQTensor<TenElemType> *> operator()(
+      const std::vector<GQTensor<TenElemType> *> &states) {
+    std::vector<std::vector<const QNBlock<TenElemType> *>> states_blks(
+        states.size());
+    auto match = valid_ && states.size() > 1;
+    for (size_t i = 0; match && i < states.size(); ++i) {
+      match = MatchState_(*states[i], states_blks[i]);
+    }
+    if (match) {
+      mul_num_ += states.size();
+      return ExecuteBatch_(states_blks);
+    }
+    std::vector<GQTensor<TenElemType> *> ress;
+    for (auto pstate : states) { ress.push_back((*this)(pstate)); }
+    return ress;
+  }
+
+  // Number of the multiplications and the ones which are planned.
+  long MulNum(void) const { return mul_num_; }
+  long PlanNum(void) const { return plan_num_; }
+
+private:
+  struct Step {
+    long ham_ten;
+    std::vector<std::vector<long>> axes;
+    bool state_first;     // The state (or the intermediate) is the lhs.
+  };
+
+  GQTensor<TenElemType> *Plan_(const GQTensor<TenElemType> &state) {
+    Free_();
+    ++plan_num_;
+    valid_ = true;
+    const GQTensor<TenElemType> *pvar = &state;
+    for (auto &step : steps_) {
+      auto &ham_ten = *eff_ham_[step.ham_ten];
+      GQTensor<TenElemType> *pres;
+      BlockCtrctPlan<TenElemType> *pplan;
+      if (step.state_first) {
+        pres = Contract(*pvar, ham_ten, step.axes);
+        pplan = new BlockCtrctPlan<TenElemType>(
+                    *pvar, ham_ten, step.axes, *pres, false, true, arena_);
+      } else {
+        pres = Contract(ham_ten, *pvar, step.axes);
+        pplan = new BlockCtrctPlan<TenElemType>(
+                    ham_ten, *pvar, step.axes, *pres, true, false, arena_);
+      }
+      plans_.emplace_back(pplan);
+      valid_ = valid_ && pplan->Valid();
+      inters_.push_back(pres);
+      pvar = pres;
+    }
+    auto state_blks = state.cblocks();
+    for (size_t i = 0; i < state_blks.size(); ++i) {
+      state_slots_[BlockSectorIds(state, state_blks[i])] = i;
+    }
+    return new GQTensor<TenElemType>(*inters_.back());
+  }
+
+  bool MatchState_(
+      const GQTensor<TenElemType> &state,
+      std::vector<const QNBlock<TenElemType> *> &state_blks) {
+    auto blks = state.cblocks();
+    if (blks.size() != state_slots_.size()) { return false; }
+    state_blks.assign(blks.size(), nullptr);
+    for (auto pblk : blks) {
+      auto poss_it = state_slots_.find(BlockSectorIds(state, pblk));
+      if (poss_it == state_slots_.end() || state_blks[poss_it->second]) {
+        return false;
+      }
+      state_blks[poss_it->second] = pblk;
+    }
+    return true;
+  }
+
+  GQTensor<TenElemType> *Execute_(
+      const std::vector<const QNBlock<TenElemType> *> &state_blks) {
+    auto pres = new GQTensor<TenElemType>(*inters_.back());
+    for (size_t s = 0; s < steps_.size(); ++s) {
+      auto var_blks = (s == 0) ? state_blks : inters_[s-1]->cblocks();
+      auto ham_blks = eff_ham_[steps_[s].ham_ten]->cblocks();
+      auto pout = (s == steps_.size()-1) ? pres : inters_[s];
+      if (steps_[s].state_first) {
+        plans_[s]->Execute(var_blks, ham_blks, pout->blocks(), ppool_);
+      } else {
+        plans_[s]->Execute(ham_blks, var_blks, pout->blocks(), ppool_);
+      }
+    }
+    return pres;
+  }
+
+  std::vector<GQTensor<TenElemType> *> ExecuteBatch_(
+      const std::vector<std::vector<const QNBlock<TenElemType> *>>
+          &states_blks) {
+    auto nb = states_blks.size();
+    if (batch_inters_.size() != nb) {
+      FreeBatchInters_();
+      batch_inters_.resize(nb);
+      for (auto &inters : batch_inters_) {
+        for (size_t s = 0; s < steps_.size()-1; ++s) {
+          inters.push_back(new GQTensor<TenElemType>(*inters_[s]));
+        }
+      }
+    }
+    std::vector<GQTensor<TenElemType> *> ress;
+    for (size_t b = 0; b < nb; ++b) {
+      ress.push_back(new GQTensor<TenElemType>(*inters_.back()));
+    }
+    for (size_t s = 0; s < steps_.size(); ++s) {
+      std::vector<std::vector<const QNBlock<TenElemType> *>> var_blks;
+      std::vector<std::vector<QNBlock<TenElemType> *>> out_blks;
+      for (size_t b = 0; b < nb; ++b) {
+        var_blks.push_back(
+            (s == 0) ? states_blks[b] : batch_inters_[b][s-1]->cblocks());
+        auto pout = (s == steps_.size()-1) ? ress[b] : batch_inters_[b][s];
+        out_blks.push_back(pout->blocks());
+      }
+      plans_[s]->ExecuteBatch(
+          eff_ham_[steps_[s].ham_ten]->cblocks(), var_blks, out_blks, ppool_);
+    }
+    return ress;
+  }
+
+  void FreeBatchInters_(void) {
+    for (auto &inters : batch_inters_) {
+      for (auto pinter : inters) { delete pinter; }
+    }
+    batch_inters_.clear();
+  }
+
+  void Free_(void) {
+    FreeBatchInters_();
+    for (auto pinter : inters_) { delete pinter; }
+    inters_.clear();
+    plans_.clear();
+    state_slots_.clear();
+  }
+
+  std::vector<GQTensor<TenElemType> *> eff_ham_;
+  UpdateArena &arena_;
+  ThreadPool *ppool_;
+  std::vector<Step> steps_;
+  bool valid_ = false;
+  std::vector<std::unique_ptr<BlockCtrctPlan<TenElemType>>> plans_;
+  std::vector<GQTensor<TenElemType> *> inters_;     // Workspace.
+  // Workspace of each state in the batches.
+  std::vector<std::vector<GQTensor<TenElemType> *>> batch_inters_;
+  std::map<std::vector<long>, long> state_slots_;
+  long mul_num_ = 0;
+  long plan_num_ = 0;
+};
+} /* gqmps2 */
@@ -0,0 +1,435 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-17 14:30
+*
+* Description: GraceQ/MPS2 project. Implementation details for Davidson solver.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include "mkl.h"
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// The denominators of the preconditioner are kept away from zero by it.
+const double kDavidsonPrecondCutoff = 1.0E-4;
+
+// The iteration stops when the norm of the correction vector is less than it.
+const double kDavidsonMinCorrectionNorm = 1.0E-12;
+
+
+// Helpers.
+// Scatter the diagonal elements of the tensor, the ones with the same
+// coordinate on the legs k0 and k1, into the dense array. The element goes to
+// sum_k coor_k * strides[k] over the legs k other than k1. The data of the
+// blocks is walked directly with the row-major strides of the blocks.
+template <typename TenElemType>
+void ScatterDiagElems(
+    const GQTensor<TenElemType> &ten, const long k0, const long k1,
+    const std::vector<long> &strides, TenElemType *dense) {
+  auto ndim = ten.indexes.size();
+  std::vector<std::vector<long>> sct_offsets;
+  for (auto &index : ten.indexes) {
+    sct_offsets.push_back(QNSectorOffsets(index));
+  }
+  std::vector<long> blk_strides(ndim), dense_offsets(ndim), coors(ndim);
+  for (auto pblk : ten.cblocks()) {
+    auto ids = BlockSectorIds(ten, pblk);
+    if (ids[k0] != ids[k1]) { continue; }
+    for (long k = ndim-1; k >= 0; --k) {
+      blk_strides[k] = (k == long(ndim)-1) ?
+                       1 : blk_strides[k+1] * pblk->shape[k+1];
+      dense_offsets[k] = sct_offsets[k][ids[k]];
+    }
+    blk_strides[k0] += blk_strides[k1];
+    auto data = pblk->cdata();
+    std::fill(coors.begin(), coors.end(), 0);
+    while (true) {
+      long n = 0, m = 0;
+      for (size_t k = 0; k < ndim; ++k) {
+        if (long(k) == k1) { continue; }
+        n += coors[k] * blk_strides[k];
+        m += (dense_offsets[k] + coors[k]) * strides[k];
+      }
+      dense[m] = data[n];
+      long k = ndim-1;
+      for (; k >= 0; --k) {
+        if (k == k1) { continue; }
+        if (++coors[k] < pblk->shape[k]) { break; }
+        coors[k] = 0;
+      }
+      if (k < 0) { break; }
+    }
+  }
+}
+
+
+// <lhs|rhs>.
+template <typename TenElemType>
+inline TenElemType DavidsonInner(
+    const GQTensor<TenElemType> *lhs, const GQTensor<TenElemType> *rhs) {
+  std::vector<long> axes(rhs->indexes.size());
+  for (size_t i = 0; i < axes.size(); ++i) { axes[i] = i; }
+  auto temp_scalar_ten = Contract(*rhs, Dag(*lhs), {axes, axes});
+  auto inner = temp_scalar_ten->scalar;
+  delete temp_scalar_ten;
+  return inner;
+}
+
+
+inline void SubspaceHeev(const MKL_INT n, double *a, double *w) {
+  auto info = LAPACKE_dsyev(LAPACK_ROW_MAJOR, 'V', 'U', n, a, n, w);
+  if (info != 0) {
+    std::cout << "?syev error." << std::endl;
+    exit(1);
+  }
+}
+
+
+inline void SubspaceHeev(const MKL_INT n, GQTEN_Complex *a, double *w) {
+  auto info = LAPACKE_zheev(LAPACK_ROW_MAJOR, 'V', 'U', n, a, n, w);
+  if (info != 0) {
+    std::cout << "?heev error." << std::endl;
+    exit(1);
+  }
+}
+
+
+// Ground state of the projected Hamiltonian. The upper triangle of the
+// leading n x n part of h (leading dimension ldh) is used.
+template <typename TenElemType>
+void SubspaceGsSolver(
+    const std::vector<TenElemType> &h, const long ldh, const long n,
+    double &gs_eng, std::vector<TenElemType> &gs_vec) {
+  std::vector<TenElemType> a(n*n);
+  for (long i = 0; i < n; ++i) {
+    for (long j = i; j < n; ++j) { a[i*n + j] = h[i*ldh + j]; }
+  }
+  std::vector<double> w(n);
+  SubspaceHeev(n, a.data(), w.data());
+  gs_eng = w[0];
+  gs_vec.resize(n);
+  for (long i = 0; i < n; ++i) { gs_vec[i] = a[i*n]; }
+}
+
+
+// Diagonal of the effective Hamiltonian,
+//   H(a, s1, s2, b; a, s1, s2, b) =
+//     sum_{w1, w2, w3} L(a, w1, a) W1(w1, s1, s1, w2) W2(w2, s2, s2, w3)
+//                      R(b, w3, b).
+// It is built from the diagonal elements of the blocks and the MPO tensors
+// without forming the effective Hamiltonian. At the ends of the chain, the
+// missing block is taken as a trivial one. At the single-site positions, the
+// missing MPO tensor is taken as an identity with a trivial physical leg. The
+// arrays live in the update arena.
+template <typename TenElemType>
+class EffHamDiag {
+public:
+  EffHamDiag(
+      const std::vector<GQTensor<TenElemType> *> &eff_ham,
+      const std::string &where,
+      UpdateArena &arena) :
+      lw_(UpdateArenaAllocator<TenElemType>(&arena)),
+      r_(UpdateArenaAllocator<TenElemType>(&arena)) {
+    // Tensors of the diagonal, nullptr for the trivial ones.
+    GQTensor<TenElemType> *plblock, *plsite, *prsite, *prblock;
+    if (where == "cent") {
+      plblock = eff_ham[0];
+      plsite = eff_ham[1];
+      prsite = eff_ham[2];
+      prblock = eff_ham[3];
+      leg_slots_ = {0, 1, 2, 3};
+    } else if (where == "lend") {
+      plblock = nullptr;
+      plsite = eff_ham[1];
+      prsite = eff_ham[2];
+      prblock = eff_ham[3];
+      leg_slots_ = {1, 2, 3};
+    } else if (where == "rend") {
+      plblock = eff_ham[0];
+      plsite = eff_ham[1];
+      prsite = eff_ham[2];
+      prblock = nullptr;
+      leg_slots_ = {0, 1, 2};
+    } else if (where == "single_cent") {
+      plblock = eff_ham[0];
+      plsite = eff_ham[1];
+      prsite = nullptr;
+      prblock = eff_ham[2];
+      leg_slots_ = {0, 1, 3};
+    } else if (where == "single_lend") {
+      plblock = nullptr;
+      plsite = eff_ham[1];
+      prsite = nullptr;
+      prblock = eff_ham[2];
+      leg_slots_ = {1, 3};
+    } else if (where == "single_rend") {
+      plblock = eff_ham[0];
+      plsite = nullptr;
+      prsite = eff_ham[1];
+      prblock = nullptr;
+      leg_slots_ = {0, 2};
+    } else {
+      std::cout << "Unknown effective Hamiltonian position " << where
+                << std::endl;
+      exit(1);
+    }
+
+    long wl, wm;
+    UpdateArenaAllocator<TenElemType> alloc(&arena);
+    UpdateArenaVector<TenElemType> l(alloc), w1(alloc), w2(alloc);
+    // L(a, w1) W1(w1, s1, w2).
+    if (plblock == nullptr) {
+      auto &lsite = *plsite;
+      Dl_ = 1;
+      wl = 1;
+      d1_ = lsite.indexes[0].dim;
+      wm = lsite.indexes[1].dim;
+      l = {TenElemType(1.0)};
+      w1.assign(d1_*wm, TenElemType(0.0));
+      ScatterDiagElems(lsite, 0, 2, {wm, 1, 0}, w1.data());
+    } else {
+      auto &lblock = *plblock;
+      Dl_ = lblock.indexes[0].dim;
+      wl = lblock.indexes[1].dim;
+      d1_ = (plsite == nullptr) ? 1 : plsite->indexes[1].dim;
+      wm = (plsite == nullptr) ? wl : plsite->indexes[3].dim;
+      l.assign(Dl_*wl, TenElemType(0.0));
+      ScatterDiagElems(lblock, 0, 2, {wl, 1, 0}, l.data());
+      w1.assign(wl*d1_*wm, TenElemType(0.0));
+      if (plsite == nullptr) {
+        for (long w = 0; w < wl; ++w) { w1[w*wm + w] = TenElemType(1.0); }
+      } else {
+        ScatterDiagElems(*plsite, 1, 2, {d1_*wm, wm, 0, 1}, w1.data());
+      }
+    }
+    // W2(w2, s2, w3) R(b, w3).
+    if (prblock == nullptr) {
+      auto &rsite = *prsite;
+      d2_ = rsite.indexes[0].dim;
+      wr_ = 1;
+      Dr_ = 1;
+      w2.assign(wm*d2_, TenElemType(0.0));
+      ScatterDiagElems(rsite, 0, 2, {1, d2_, 0}, w2.data());
+      r_ = {TenElemType(1.0)};
+    } else {
+      auto &rblock = *prblock;
+      d2_ = (prsite == nullptr) ? 1 : prsite->indexes[1].dim;
+      wr_ = (prsite == nullptr) ? wm : prsite->indexes[3].dim;
+      Dr_ = rblock.indexes[0].dim;
+      w2.assign(wm*d2_*wr_, TenElemType(0.0));
+      if (prsite == nullptr) {
+        for (long w = 0; w < wm; ++w) { w2[w*wr_ + w] = TenElemType(1.0); }
+      } else {
+        ScatterDiagElems(*prsite, 1, 2, {d2_*wr_, wr_, 0, 1}, w2.data());
+      }
+      r_.assign(Dr_*wr_, TenElemType(0.0));
+      ScatterDiagElems(rblock, 0, 2, {wr_, 1, 0}, r_.data());
+    }
+
+    // lw_(a, s1, s2, w3) = sum_{w1, w2} L(a, w1) W1(w1, s1, w2) W2(w2, s2, w3).
+    UpdateArenaVector<TenElemType> lw1(Dl_*d1_*wm, TenElemType(0.0), alloc);
+    for (long a = 0; a < Dl_; ++a) {
+      for (long w = 0; w < wl; ++w) {
+        auto l_elem = l[a*wl + w];
+        if (l_elem == TenElemType(0.0)) { continue; }
+        for (long s = 0; s < d1_; ++s) {
+          for (long w2 = 0; w2 < wm; ++w2) {
+            lw1[(a*d1_ + s)*wm + w2] += l_elem * w1[(w*d1_ + s)*wm + w2];
+          }
+        }
+      }
+    }
+    lw_.assign(Dl_*d1_*d2_*wr_, TenElemType(0.0));
+    for (long as1 = 0; as1 < Dl_*d1_; ++as1) {
+      for (long w = 0; w < wm; ++w) {
+        auto lw1_elem = lw1[as1*wm + w];
+        if (lw1_elem == TenElemType(0.0)) { continue; }
+        for (long s = 0; s < d2_; ++s) {
+          for (long w3 = 0; w3 < wr_; ++w3) {
+            lw_[(as1*d2_ + s)*wr_ + w3] += lw1_elem * w2[(w*d2_ + s)*wr_ + w3];
+          }
+        }
+      }
+    }
+  }
+
+  double Elem(const long a, const long s1, const long s2, const long b) const {
+    auto plw = lw_.data() + ((a*d1_ + s1)*d2_ + s2)*wr_;
+    auto pr = r_.data() + b*wr_;
+    TenElemType elem = 0.0;
+    for (long w = 0; w < wr_; ++w) { elem += plw[w] * pr[w]; }
+    return Real(elem);
+  }
+
+  // Apply the preconditioner (diag - shift)^-1 on the tensor in place.
+  void Precondition(GQTensor<TenElemType> *pten, const double shift) const {
+    std::vector<std::vector<long>> sct_offsets;
+    for (auto &index : pten->indexes) {
+      sct_offsets.push_back(QNSectorOffsets(index));
+    }
+    for (auto pblk : pten->blocks()) {
+      auto ids = BlockSectorIds(*pten, pblk);
+      std::vector<long> offsets(pblk->ndim);
+      for (long k = 0; k < pblk->ndim; ++k) {
+        offsets[k] = sct_offsets[k][ids[k]];
+      }
+      std::vector<long> blk_coors(pblk->ndim, 0);
+      long coors[4] = {0, 0, 0, 0};
+      auto data = pblk->data();
+      for (long n = 0; n < pblk->size; ++n) {
+        for (long k = 0; k < pblk->ndim; ++k) {
+          coors[leg_slots_[k]] = offsets[k] + blk_coors[k];
+        }
+        auto denom = Elem(coors[0], coors[1], coors[2], coors[3]) - shift;
+        if (std::abs(denom) < kDavidsonPrecondCutoff) {
+          denom = (denom < 0) ?
+                  -kDavidsonPrecondCutoff : kDavidsonPrecondCutoff;
+        }
+        data[n] = data[n] / denom;
+        for (long k = pblk->ndim-1; k >= 0; --k) {
+          if (++blk_coors[k] < pblk->shape[k]) { break; }
+          blk_coors[k] = 0;
+        }
+      }
+    }
+  }
+
+private:
+  std::vector<long> leg_slots_;   // Slots of the state legs in (a, s1, s2, b).
+  long Dl_;
+  long d1_;
+  long d2_;
+  long Dr_;
+  long wr_;
+  UpdateArenaVector<TenElemType> lw_;   // (a, s1, s2, w3)
+  UpdateArenaVector<TenElemType> r_;    // (b, w3)
+};
+
+
+template <typename TenElemType>
+inline void DavidsonFree(
+    std::vector<GQTensor<TenElemType> *> &bases,
+    std::vector<GQTensor<TenElemType> *> &hbases) {
+  for (auto &ptr : bases) { delete ptr; }
+  for (auto &ptr : hbases) { delete ptr; }
+  bases.clear();
+  hbases.clear();
+}
+
+
+// Davidson solver. The correction vectors are the residuals preconditioned by
+// the diagonal of the effective Hamiltonian. The returned iteration number is
+// the number of the matrix-vector multiplications.
+template <typename TenElemType>
+LanczosRes<TenElemType> DavidsonSolver(
+    const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
+    GQTensor<TenElemType> *pinit_state,
+    const LanczosParams &params,
+    const std::string &where,
+    UpdateArena *parena) {
+  // Take care that init_state will be destroyed after call the solver.
+  auto eff_ham_eff_dim = EffHamDim(rpeff_ham, where);
+  UpdateArena local_arena;
+  auto &arena = (parena != nullptr) ? *parena : local_arena;
+  EffHamMulStatePlan<TenElemType> eff_ham_mul_state(
+      rpeff_ham, where, arena, SharedThreadPool(params.matvec_threads));
+  EffHamDiag<TenElemType> eff_ham_diag(rpeff_ham, where, arena);
+  auto max_bases = std::max(
+                       std::min(params.davidson_max_bases, eff_ham_eff_dim),
+                       2L);
+  LanczosRes<TenElemType> lancz_res;
+
+  // Projected Hamiltonian h(i, j) = <base_i|H|base_j>, upper triangle.
+  std::vector<TenElemType> h(max_bases*max_bases, TenElemType(0.0));
+  std::vector<GQTensor<TenElemType> *> bases;
+  std::vector<GQTensor<TenElemType> *> hbases;
+
+  pinit_state->Normalize();
+  bases.push_back(pinit_state);
+  hbases.push_back(eff_ham_mul_state(pinit_state));
+  long iters = 1;
+  h[0] = DavidsonInner(bases[0], hbases[0]);
+  double energy0 = Real(h[0]);
+  double eigval;
+  std::vector<TenElemType> eigvec;
+  while (true) {
+    long m = bases.size();
+    SubspaceGsSolver(h, max_bases, m, eigval, eigvec);
+    auto gs_vec = new GQTensor<TenElemType>(bases[0]->indexes);
+    LinearCombine(eigvec, bases, gs_vec);
+    // Residual r = H|x> - E|x>.
+    auto res = new GQTensor<TenElemType>(bases[0]->indexes);
+    LinearCombine(eigvec, hbases, res);
+    LinearCombine({TenElemType(-eigval)}, {gs_vec}, res);
+    auto res_norm = res->Normalize();
+
+    bool converged = (res_norm == 0.0) ||
+                     (m > 1 && (energy0 - eigval) < params.error) ||
+                     (iters >= eff_ham_eff_dim) ||
+                     (iters >= params.max_iterations);
+    GQTensor<TenElemType> *correction = nullptr;
+    if (!converged) {
+      // Correction vector, orthogonalized twice against the bases.
+      eff_ham_diag.Precondition(res, eigval);
+      for (long k = 0; k < 2; ++k) {
+        for (auto base : bases) {
+          auto overlap = DavidsonInner(base, res);
+          LinearCombine({-overlap}, {base}, res);
+        }
+      }
+      if (res->Normalize() < kDavidsonMinCorrectionNorm) {
+        converged = true;
+      } else {
+        correction = res;
+      }
+    }
+    if (converged) {
+      delete res;
+      DavidsonFree(bases, hbases);
+      lancz_res.iters = iters;
+      lancz_res.gs_eng = eigval;
+      lancz_res.gs_vec = gs_vec;
+      return lancz_res;
+    }
+    energy0 = eigval;
+
+    // Restart from the current ground state.
+    if (m == max_bases) {
+      auto hgs_vec = new GQTensor<TenElemType>(bases[0]->indexes);
+      LinearCombine(eigvec, hbases, hgs_vec);
+      DavidsonFree(bases, hbases);
+      gs_vec->Normalize();
+      bases.push_back(gs_vec);
+      hbases.push_back(hgs_vec);
+      h[0] = eigval;
+      for (auto base : bases) {
+        auto overlap = DavidsonInner(base, correction);
+        LinearCombine({-overlap}, {base}, correction);
+      }
+      correction->Normalize();
+    } else {
+      delete gs_vec;
+    }
+
+    // Extend the subspace.
+    m = bases.size();
+    bases.push_back(correction);
+    hbases.push_back(eff_ham_mul_state(correction));
+    ++iters;
+    for (long i = 0; i <= m; ++i) {
+      h[i*max_bases + m] = DavidsonInner(bases[i], hbases[m]);
+    }
+  }
+}
+} /* gqmps2 */
@@ -0,0 +1,44 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-21 18:40
+*
+* Description: GraceQ/MPS2 project. Byte hash of the content which is kept on disk.
+*/
+#ifndef GQMPS2_DETAIL_HASH_H
+#define GQMPS2_DETAIL_HASH_H
+
+
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+
+namespace gqmps2 {
+
+
+// FNV-1a style hash over 64-bit words, the tail bytes are hashed one by one.
+// It does not depend on the toolchain, thus the hashes stored in the files
+// stay valid.
+const uint64_t kFnvOffsetBasis = 14695981039346656037ULL;
+const uint64_t kFnvPrime = 1099511628211ULL;
+
+inline uint64_t HashBytes(
+    const char *data, const size_t size,
+    const uint64_t basis = kFnvOffsetBasis) {
+  auto hash = basis;
+  auto word_num = size / sizeof(uint64_t);
+  uint64_t word;
+  for (size_t i = 0; i < word_num; ++i) {
+    std::memcpy(&word, data + i * sizeof(uint64_t), sizeof(uint64_t));
+    hash ^= word;
+    hash *= kFnvPrime;
+  }
+  for (size_t i = word_num * sizeof(uint64_t); i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+} /* gqmps2 */
+#endif /* ifndef GQMPS2_DETAIL_HASH_H */
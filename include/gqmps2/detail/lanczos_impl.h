@@ -37,6 +37,13 @@ void TridiagGsSolver(
     const std::vector<double> &, const std::vector<double> &, const long,
     double &, double * &, const char);
 
+template <typename TenElemType>
+GQTensor<TenElemType> *LanczosReplayGsVec(
+    EffHamMulStatePlan<TenElemType> &,
+    GQTensor<TenElemType> *,
+    const std::vector<double> &, const std::vector<double> &,
+    const long, const double *);
+
 
 // Helpers.
 template <typename TenElemType>
@@ -66,42 +73,83 @@ inline double Real(const double d) { return d; }
 inline double Real(const GQTEN_Complex z) { return z.real(); }
 
 
-// Lanczos solver.
+// Ground state vector from the first n Lanczos bases.
 template <typename TenElemType>
-LanczosRes<TenElemType> LanczosSolver(
-    const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
-    GQTensor<TenElemType> *pinit_state,
+GQTensor<TenElemType> *LanczosGsVec(
+    EffHamMulStatePlan<TenElemType> &eff_ham_mul_state,
     const LanczosParams &params,
+    const std::vector<GQTensor<TenElemType> *> &bases,
+    const std::vector<double> &a, const std::vector<double> &N,
+    const long n, const double *eigvec,
+    LanczosRes<TenElemType> &lancz_res) {
+  if (params.store_bases) {
+    auto gs_vec = new GQTensor<TenElemType>(bases[0]->indexes);
+    LinearCombine(n, eigvec, bases, gs_vec);
+    return gs_vec;
+  }
+  Timer replay_timer("replay");
+  replay_timer.Restart();
+  auto gs_vec = LanczosReplayGsVec(
+                    eff_ham_mul_state, bases[0], a, N, n, eigvec);
+  lancz_res.replay_iters = n - 1;
+  lancz_res.replay_time = replay_timer.Elapsed();
+  return gs_vec;
+}
+
+
+// Dimension of the effective Hamiltonian at the position.
+template <typename TenElemType>
+long EffHamDim(
+    const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
     const std::string &where) {
-  // Take care that init_state will be destroyed after call the solver.
   long eff_ham_eff_dim = 1;
-  GQTensor<TenElemType> *(* eff_ham_mul_state)(
-      const std::vector<GQTensor<TenElemType> *> &,
-      GQTensor<TenElemType> *) = nullptr;
-  std::vector<std::vector<long>> energy_measu_ctrct_axes;
-  LanczosRes<TenElemType> lancz_res;
-
-  // Calculate position dependent parameters.
   if (where == "cent") {
     eff_ham_eff_dim *= rpeff_ham[0]->indexes[0].dim;
     eff_ham_eff_dim *= rpeff_ham[1]->indexes[1].dim;
     eff_ham_eff_dim *= rpeff_ham[2]->indexes[1].dim;
     eff_ham_eff_dim *= rpeff_ham[3]->indexes[0].dim;
-    eff_ham_mul_state = &eff_ham_mul_state_cent;
-    energy_measu_ctrct_axes = {{0, 1, 2, 3}, {0, 1, 2, 3}};
   } else if (where == "lend") {
     eff_ham_eff_dim *= rpeff_ham[1]->indexes[0].dim;
     eff_ham_eff_dim *= rpeff_ham[2]->indexes[1].dim;
     eff_ham_eff_dim *= rpeff_ham[3]->indexes[0].dim;
-    eff_ham_mul_state = &eff_ham_mul_state_lend;
-    energy_measu_ctrct_axes = {{0, 1, 2}, {0, 1, 2}};
-  } else if (where ==  "rend") {
+  } else if (where == "rend") {
+    eff_ham_eff_dim *= rpeff_ham[0]->indexes[0].dim;
+    eff_ham_eff_dim *= rpeff_ham[1]->indexes[1].dim;
+    eff_ham_eff_dim *= rpeff_ham[2]->indexes[0].dim;
+  } else if (where == "single_cent") {
     eff_ham_eff_dim *= rpeff_ham[0]->indexes[0].dim;
     eff_ham_eff_dim *= rpeff_ham[1]->indexes[1].dim;
     eff_ham_eff_dim *= rpeff_ham[2]->indexes[0].dim;
-    eff_ham_mul_state = &eff_ham_mul_state_rend;
-    energy_measu_ctrct_axes = {{0, 1, 2}, {0, 1, 2}};
+  } else if (where == "single_lend") {
+    eff_ham_eff_dim *= rpeff_ham[1]->indexes[0].dim;
+    eff_ham_eff_dim *= rpeff_ham[2]->indexes[0].dim;
+  } else if (where == "single_rend") {
+    eff_ham_eff_dim *= rpeff_ham[0]->indexes[0].dim;
+    eff_ham_eff_dim *= rpeff_ham[1]->indexes[0].dim;
   }
+  return eff_ham_eff_dim;
+}
+
+
+// Lanczos solver.
+template <typename TenElemType>
+LanczosRes<TenElemType> LanczosSolver(
+    const std::vector<GQTensor<TenElemType> *> &rpeff_ham,
+    GQTensor<TenElemType> *pinit_state,
+    const LanczosParams &params,
+    const std::string &where,
+    UpdateArena *parena) {
+  // Take care that init_state will be destroyed after call the solver.
+  auto eff_ham_eff_dim = EffHamDim(rpeff_ham, where);
+  UpdateArena local_arena;
+  auto &arena = (parena != nullptr) ? *parena : local_arena;
+  EffHamMulStatePlan<TenElemType> eff_ham_mul_state(
+      rpeff_ham, where, arena, SharedThreadPool(params.matvec_threads));
+  std::vector<long> state_legs(pinit_state->indexes.size());
+  for (size_t i = 0; i < state_legs.size(); ++i) { state_legs[i] = i; }
+  std::vector<std::vector<long>> energy_measu_ctrct_axes = {
+      state_legs, state_legs};
+  LanczosRes<TenElemType> lancz_res;
 
   std::vector<GQTensor<TenElemType> *> bases(params.max_iterations);
   std::vector<double> a(params.max_iterations, 0.0);
@@ -117,7 +165,7 @@ LanczosRes<TenElemType> LanczosSolver(
   mat_vec_timer.Restart();
 #endif
 
-  auto last_mat_mul_vec_res = (*eff_ham_mul_state)(rpeff_ham, bases[0]);
+  auto last_mat_mul_vec_res = eff_ham_mul_state(bases[0]);
 
 #ifdef GQMPS2_TIMING_MODE
   mat_vec_timer.PrintElapsed();
@@ -158,8 +206,9 @@ LanczosRes<TenElemType> LanczosSolver(
         return lancz_res;
       } else {
         TridiagGsSolver(a, b, m, eigval, eigvec, 'V');
-        auto gs_vec = new GQTensor<TenElemType>(bases[0]->indexes);
-        LinearCombine(m, eigvec, bases, gs_vec);
+        auto gs_vec = LanczosGsVec(
+                          eff_ham_mul_state, params,
+                          bases, a, N, m, eigvec, lancz_res);
         lancz_res.iters = m;
         lancz_res.gs_eng = energy0;
         lancz_res.gs_vec = gs_vec;
@@ -170,12 +219,17 @@ LanczosRes<TenElemType> LanczosSolver(
     N[m] = std::pow(norm_gamma, 2.0);
     b[m-1] = norm_gamma;
     bases[m] = gamma;
+    // Only the initial state and the last two bases are needed to continue.
+    if (!params.store_bases && m-2 > 0) {
+      delete bases[m-2];
+      bases[m-2] = nullptr;
+    }
 
 #ifdef GQMPS2_TIMING_MODE
     mat_vec_timer.Restart();
 #endif
 
-    last_mat_mul_vec_res = (*eff_ham_mul_state)(rpeff_ham, bases[m]);
+    last_mat_mul_vec_res = eff_ham_mul_state(bases[m]);
 
 #ifdef GQMPS2_TIMING_MODE
     mat_vec_timer.PrintElapsed();
@@ -192,8 +246,9 @@ LanczosRes<TenElemType> LanczosSolver(
          (m == params.max_iterations - 1)) {
       TridiagGsSolver(a, b, m+1, eigval, eigvec, 'V');
       energy0 = energy0_new;
-      auto gs_vec = new GQTensor<TenElemType>(bases[0]->indexes);
-      LinearCombine(m+1, eigvec, bases, gs_vec);
+      auto gs_vec = LanczosGsVec(
+                        eff_ham_mul_state, params,
+                        bases, a, N, m+1, eigvec, lancz_res);
       lancz_res.iters = m;
       lancz_res.gs_eng = energy0;
       lancz_res.gs_vec = gs_vec;
@@ -206,6 +261,43 @@ LanczosRes<TenElemType> LanczosSolver(
 }
 
 
+// Regenerate the Lanczos bases from the initial state with the recorded
+// coefficients, and accumulate them to the ground state on the fly.
+template <typename TenElemType>
+GQTensor<TenElemType> *LanczosReplayGsVec(
+    EffHamMulStatePlan<TenElemType> &eff_ham_mul_state,
+    GQTensor<TenElemType> *pinit_state,
+    const std::vector<double> &a, const std::vector<double> &N,
+    const long n, const double *eigvec) {
+  auto gs_vec = new GQTensor<TenElemType>(pinit_state->indexes);
+  LinearCombine(1, eigvec, {pinit_state}, gs_vec);
+  GQTensor<TenElemType> *prev_base = nullptr;
+  auto base = pinit_state;
+  for (long m = 1; m < n; ++m) {
+    auto gamma = eff_ham_mul_state(base);
+    if (m == 1) {
+      LinearCombine(
+          {-a[m-1]},
+          {base},
+          gamma);
+    } else {
+      LinearCombine(
+          {-a[m-1], -std::sqrt(N[m-1])},
+          {base, prev_base},
+          gamma);
+    }
+    gamma->Normalize();
+    LinearCombine(1, eigvec + m, {gamma}, gs_vec);
+    if (prev_base != pinit_state) { delete prev_base; }
+    prev_base = base;
+    base = gamma;
+  }
+  if (prev_base != pinit_state) { delete prev_base; }
+  if (base != pinit_state) { delete base; }
+  return gs_vec;
+}
+
+
 template <typename TenElemType>
 GQTensor<TenElemType> *eff_ham_mul_state_cent(
     const std::vector<GQTensor<TenElemType> *> &eff_ham,
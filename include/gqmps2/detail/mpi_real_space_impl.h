@@ -0,0 +1,452 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-19 15:20
+*
+* Description: GraceQ/MPS2 project. Implementation details for MPI real-space parallel two-site algorithm.
+*/
+
+/**
+Rank k of the communicator owns the segment k of the MPS, the bond values on
+its boundaries and the environment blocks which its updates use. No rank holds
+more than its segment and the tensors on its boundaries.
+
+The segment form is prepared by three passes along the rank chain, each rank
+works on its own sites and hands the tensor on its boundary to the next rank:
+the right-canonical form with the center on the first site, the left-canonical
+form which gives the left blocks and the bond values of the boundaries, and
+the right blocks. The segments are then swept as in the shared memory
+version. The boundary b between the ranks k and k+1 is stitched on the rank
+k, the rank k+1 sends the tensor M[b] and the right block which the two-site
+update needs and gets back the new M[b], the left block to turn around with
+and the new bond values. In the end the MPS is brought back to the
+right-canonical form by a pass along the chain and stays distributed. The
+tensors are sent in the tensor binary file format.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+
+#include <assert.h>
+
+#include "mpi.h"
+
+#ifdef Release
+  #define NDEBUG
+#endif
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Size of the pieces the serialized tensors are sent in, thus the MPI int
+// counts do not overflow.
+const size_t kMpiTenChunkBytes = 1UL << 30;
+
+
+template <typename TenType>
+void SendGQTensor(const TenType &t, const int dest, MPI_Comm comm) {
+  auto bytes = DumpBlockToBytes(t);
+  unsigned long long size = bytes.size();
+  MPI_Send(&size, 1, MPI_UNSIGNED_LONG_LONG, dest, 0, comm);
+  for (size_t offset = 0; offset < size; offset += kMpiTenChunkBytes) {
+    int chunk = std::min(kMpiTenChunkBytes, size_t(size) - offset);
+    MPI_Send(bytes.data() + offset, chunk, MPI_CHAR, dest, 0, comm);
+  }
+}
+
+
+template <typename TenType>
+TenType *RecvGQTensor(const int src, MPI_Comm comm) {
+  unsigned long long size;
+  MPI_Recv(&size, 1, MPI_UNSIGNED_LONG_LONG, src, 0, comm, MPI_STATUS_IGNORE);
+  std::string bytes(size, '\0');
+  for (size_t offset = 0; offset < size; offset += kMpiTenChunkBytes) {
+    int chunk = std::min(kMpiTenChunkBytes, size_t(size) - offset);
+    MPI_Recv(
+        &bytes[offset], chunk, MPI_CHAR, src, 0, comm, MPI_STATUS_IGNORE);
+  }
+  return LoadBlockFromBytes<TenType>(bytes.data(), bytes.size());
+}
+
+
+// Blocks with nonzero length which the segment k needs in the first half
+// sweep.
+inline std::vector<std::pair<char, long>> RealSpaceSegmentBlocks(
+    const long k, const std::vector<long> &bounds) {
+  long N = bounds.back();
+  auto s = bounds[k], e = bounds[k+1];
+  std::vector<std::pair<char, long>> blks;
+  if (k % 2 == 0) {
+    blks.push_back(std::make_pair('l', s));
+    for (long len = N-e; len <= N-s-2; ++len) {
+      blks.push_back(std::make_pair('r', len));
+    }
+  } else {
+    for (long len = s; len <= e-2; ++len) {
+      blks.push_back(std::make_pair('l', len));
+    }
+    blks.push_back(std::make_pair('r', N-e));
+  }
+  blks.erase(
+      std::remove_if(
+          blks.begin(), blks.end(),
+          [](const std::pair<char, long> &blk) { return blk.second == 0; }),
+      blks.end());
+  return blks;
+}
+
+
+// The segment [s, e) of the MPS in the files of DumpMps, thus the ranks
+// write and read their own segments.
+template <typename TenType>
+void DumpMpsSegment(
+    const std::vector<TenType *> &mps, const long s, const long e) {
+  CreatSharedPath(kMpsPath);
+  for (long i = s; i < e; ++i) {
+    auto file = kMpsPath + "/" +
+                kMpsTenBaseName + std::to_string(i) + "." + kGQTenFileSuffix;
+    std::ofstream ofs(file, std::ofstream::binary);
+    bfwrite(ofs, *mps[i]);
+    ofs.close();
+  }
+}
+
+
+template <typename TenType>
+void LoadMpsSegment(std::vector<TenType *> &mps, const long s, const long e) {
+  for (long i = s; i < e; ++i) {
+    auto file = kMpsPath + "/" +
+                kMpsTenBaseName + std::to_string(i) + "." + kGQTenFileSuffix;
+    std::ifstream ifs(file, std::ifstream::binary);
+    if (!ifs) {
+      std::cout << "Unable to open " << file << std::endl;
+      exit(1);
+    }
+    delete mps[i];
+    mps[i] = new TenType();
+    bfread(ifs, *mps[i]);
+    ifs.close();
+  }
+}
+
+
+// Bring the MPS to the right-canonical form with the center on the first site
+// by untruncated SVDs from the right end. The rank gets the carried matrix on
+// its right boundary from the rank+1 and hands the one on its left boundary to
+// the rank-1. The carried matrices are normalized.
+template <typename TenType>
+void MpiRightCanonicalizeMps(
+    std::vector<TenType *> &mps, const long s, const long e,
+    const int rank, MPI_Comm comm) {
+  long N = mps.size();
+  if (e < N) {
+    auto pus = RecvGQTensor<TenType>(rank+1, comm);
+    auto pten = ContractRightBond(*mps[e-1], *pus);
+    delete mps[e-1];
+    mps[e-1] = pten;
+    delete pus;
+  }
+  for (long i = e-1; i >= std::max(s, 1L); --i) {
+    auto zero_div = Div(*mps[i]) - Div(*mps[i]);
+    auto svd_res = Svd(
+                       *mps[i], 1, (i == N-1) ? 1 : 2,
+                       zero_div, Div(*mps[i]));
+    delete mps[i];
+    mps[i] = svd_res.v;
+    auto pus = Contract(*svd_res.u, *svd_res.s, {{1}, {0}});
+    delete svd_res.u;
+    delete svd_res.s;
+    pus->Normalize();
+    if (i > s) {
+      auto pprev = ContractRightBond(*mps[i-1], *pus);
+      delete mps[i-1];
+      mps[i-1] = pprev;
+    } else {
+      SendGQTensor(*pus, rank-1, comm);
+    }
+    delete pus;
+  }
+  if (s == 0) { mps[0]->Normalize(); }
+}
+
+
+// Bring the segment of the right-canonical MPS to the segment form as
+// PrepareRealSpaceSegments does, and build the blocks which the segment needs
+// in the first half sweep. The left-canonical tensors and the left blocks are
+// built from the left end, the bond values and the bond matrix of the right
+// boundary go to the rank+1 with the left block. Then the right blocks are
+// built from the right end. The blocks which the segment does not need are
+// dropped as soon as the next one is grown from them.
+template <typename TenType>
+void MpiPrepareRealSpaceSegment(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    BlockManager<TenType> &blk_mgr, const std::vector<long> &bounds,
+    std::vector<DGQTensor *> &bond_vals, const int rank, MPI_Comm comm) {
+  long N = mps.size();
+  auto s = bounds[rank], e = bounds[rank+1];
+  auto blks = RealSpaceSegmentBlocks(rank, bounds);
+  auto drop_unused = [&blk_mgr, &blks](const char side, const long len) {
+                       if (std::find(
+                               blks.begin(), blks.end(),
+                               std::make_pair(side, len)) == blks.end()) {
+                         blk_mgr.Drop(side, len);
+                       }
+                     };
+
+  // Left-canonical copy by untruncated SVDs.
+  std::vector<TenType *> amps(N, nullptr);
+  std::vector<TenType *> bond_mats(N, nullptr);
+  TenType *pcent;
+  if (s > 0) {
+    bond_vals[s] = RecvGQTensor<DGQTensor>(rank-1, comm);
+    bond_mats[s] = RecvGQTensor<TenType>(rank-1, comm);
+    blk_mgr.Put('l', s, RecvGQTensor<TenType>(rank-1, comm));
+    auto psv = Contract(*bond_vals[s], *bond_mats[s], {{1}, {0}});
+    pcent = Contract(*psv, *mps[s], {{1}, {0}});
+    delete psv;
+  } else {
+    pcent = new TenType(*mps[0]);
+  }
+  for (long i = s; i < e; ++i) {
+    if (i == N-1) {
+      amps[i] = pcent;
+      break;
+    }
+    auto zero_div = Div(*mps[i]) - Div(*mps[i]);
+    auto svd_res = Svd(*pcent, (i == 0) ? 1 : 2, 1, Div(*mps[i]), zero_div);
+    delete pcent;
+    amps[i] = svd_res.u;
+    blk_mgr.Put(
+        'l', i+1,
+        GrowLBlock(*blk_mgr.Acquire('l', i), *amps[i], *mpo[i], i));
+    drop_unused('l', i);
+    if (i < e-1) {
+      auto psv = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+      pcent = Contract(*psv, *mps[i+1], {{1}, {0}});
+      delete psv;
+      delete svd_res.s;
+      delete svd_res.v;
+    } else {
+      bond_vals[e] = svd_res.s;
+      bond_mats[e] = svd_res.v;
+      SendGQTensor(*bond_vals[e], rank+1, comm);
+      SendGQTensor(*bond_mats[e], rank+1, comm);
+      SendGQTensor(*blk_mgr.Acquire('l', e), rank+1, comm);
+      drop_unused('l', e);
+    }
+  }
+
+  // Segment form, bmps is the right-canonical form with the bases of the bond
+  // values on the boundaries.
+  std::vector<TenType *> smps(N, nullptr), bmps(N, nullptr);
+  for (long j = s; j < e; ++j) {
+    TenType *pb;
+    if (j == s && s > 0) {
+      pb = Contract(*bond_mats[s], *mps[s], {{1}, {0}});
+    } else {
+      pb = new TenType(*mps[j]);
+    }
+    if (j == e-1 && e < N) {
+      auto pbw = ContractRightBond(*pb, Dag(*bond_mats[e]), 1);
+      delete pb;
+      pb = pbw;
+    }
+    bmps[j] = pb;
+    if (rank % 2 == 0) {
+      smps[j] = (j == s && s > 0) ?
+                Contract(*bond_vals[s], *pb, {{1}, {0}}) :
+                new TenType(*pb);
+    } else {
+      smps[j] = (j == e-1 && e < N) ?
+                ContractRightBond(*amps[j], *bond_vals[e]) :
+                new TenType(*amps[j]);
+    }
+  }
+  if (e < N) {
+    blk_mgr.Put('r', N-e, RecvGQTensor<TenType>(rank+1, comm));
+  }
+  for (long len = N-e+1; len <= std::min(N-s, N-2); ++len) {
+    blk_mgr.Put(
+        'r', len,
+        GrowRBlock(
+            *blk_mgr.Acquire('r', len-1), *bmps[N-len], *mpo[N-len], len-1));
+    drop_unused('r', len-1);
+  }
+  if (s > 0) {
+    SendGQTensor(*blk_mgr.Acquire('r', N-s), rank-1, comm);
+    drop_unused('r', N-s);
+  }
+
+  for (long j = s; j < e; ++j) {
+    delete mps[j];
+    mps[j] = smps[j];
+    delete amps[j];
+    delete bmps[j];
+  }
+  for (auto pbond_mat : bond_mats) { delete pbond_mat; }
+}
+
+
+// Stitch the boundary b with the neighbouring rank, this rank owns the left
+// or the right segment.
+template <typename TenType>
+double MpiRealSpaceBoundaryUpdate(
+    const long b, const bool left,
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params,
+    BlockManager<TenType> &blk_mgr, UpdateArena &update_arena,
+    std::vector<DGQTensor *> &bond_vals, double &trunc_err,
+    const int rank, MPI_Comm comm) {
+  long N = mps.size();
+  double e0 = 0.0;
+  trunc_err = 0.0;
+  if (left) {
+    mps[b] = RecvGQTensor<TenType>(rank+1, comm);
+    blk_mgr.Put('r', N-b-1, RecvGQTensor<TenType>(rank+1, comm));
+    e0 = RealSpaceBoundaryUpdate(
+             b, mps, mpo, sweep_params, blk_mgr, update_arena,
+             bond_vals, trunc_err);
+    SendGQTensor(*mps[b], rank+1, comm);
+    SendGQTensor(*blk_mgr.Acquire('l', b), rank+1, comm);
+    SendGQTensor(*bond_vals[b], rank+1, comm);
+    delete mps[b];
+    mps[b] = nullptr;
+    blk_mgr.Drop('l', b);
+    blk_mgr.Drop('r', N-b-1);
+  } else {
+    SendGQTensor(*mps[b], rank-1, comm);
+    SendGQTensor(*blk_mgr.Acquire('r', N-b-1), rank-1, comm);
+    blk_mgr.Drop('r', N-b-1);
+    delete mps[b];
+    mps[b] = RecvGQTensor<TenType>(rank-1, comm);
+    blk_mgr.Put('l', b, RecvGQTensor<TenType>(rank-1, comm));
+    delete bond_vals[b];
+    bond_vals[b] = RecvGQTensor<DGQTensor>(rank-1, comm);
+  }
+  return e0;
+}
+
+
+// The initial MPS is taken from the rank 0, or read from the MPS directory by
+// each rank for its own segment in the continue workflow. In FileIO mode each
+// rank keeps its blocks in its own block arena and writes its segment of the
+// result to the MPS directory.
+template <typename TenType>
+double MpiRealSpaceParallelTwoSiteAlgorithm(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params, MPI_Comm comm) {
+  assert(mps.size() == mpo.size());
+  int rank, segments;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &segments);
+  long N = mps.size();
+  if (segments > N/2) {
+    std::cout << "Too many MPI processes " << segments << " for " << N
+              << " sites, each segment needs two sites." << std::endl;
+    exit(1);
+  }
+  auto bounds = RealSpaceSegmentBounds(N, segments);
+  auto s = bounds[rank], e = bounds[rank+1];
+  if (rank == 0) {
+    std::cout << "MPI real-space parallel sweeps with " << segments
+              << " segments" << std::endl;
+  }
+  if (sweep_params.FileIO) { CreatSharedPath(kRuntimeTempPath); }
+
+  // Keep only the own segment of the MPS.
+  if (sweep_params.Workflow == kTwoSiteAlgoWorkflowContinue) {
+    for (long j = 0; j < N; ++j) {
+      delete mps[j];
+      mps[j] = nullptr;
+    }
+    LoadMpsSegment(mps, s, e);
+  } else if (rank == 0) {
+    for (int k = 1; k < segments; ++k) {
+      for (long j = bounds[k]; j < bounds[k+1]; ++j) {
+        SendGQTensor(*mps[j], k, comm);
+        delete mps[j];
+        mps[j] = nullptr;
+      }
+    }
+  } else {
+    for (long j = 0; j < N; ++j) {
+      delete mps[j];
+      mps[j] = (j >= s && j < e) ? RecvGQTensor<TenType>(0, comm) : nullptr;
+    }
+  }
+
+  BlockManager<TenType> blk_mgr(
+      mpo, sweep_params, 2, kBlockArenaFileName + "." + std::to_string(rank));
+  UpdateArena update_arena;
+  SweepConvergence convergence(sweep_params);
+  std::vector<DGQTensor *> bond_vals(N, nullptr);
+  blk_mgr.Put('l', 0, new TenType());
+  blk_mgr.Put('r', 0, new TenType());
+  MpiRightCanonicalizeMps(mps, s, e, rank, comm);
+  MpiPrepareRealSpaceSegment(mps, mpo, blk_mgr, bounds, bond_vals, rank, comm);
+
+  if (rank == 0) { std::cout << "\n"; }
+  double e0 = 0.0;
+  Timer sweep_timer("sweep");
+  for (long sweep = 0; sweep < sweep_params.Sweeps; ++sweep) {
+    auto params = SweepParamsOfSweep(sweep_params, sweep);
+    if (rank == 0) {
+      std::cout << "sweep " << sweep << std::endl;
+      if (!sweep_params.Schedule.empty()) { PrintSweepStage(params); }
+    }
+    sweep_timer.Restart();
+    double max_trunc_err = 0.0;
+    for (long phase = 0; phase < 2; ++phase) {
+      double trunc_err;
+      auto dir = ((rank + phase) % 2 == 0) ? 'r' : 'l';
+      e0 = RealSpaceSegmentSweep(
+               s, e, dir, mps, mpo, params, blk_mgr, update_arena,
+               trunc_err);
+      max_trunc_err = std::max(max_trunc_err, trunc_err);
+      if (dir == 'r' && e < N) {
+        e0 = MpiRealSpaceBoundaryUpdate(
+                 e, true, mps, mpo, params, blk_mgr, update_arena,
+                 bond_vals, trunc_err, rank, comm);
+        max_trunc_err = std::max(max_trunc_err, trunc_err);
+      } else if (dir == 'l' && s > 0) {
+        MpiRealSpaceBoundaryUpdate(
+            s, false, mps, mpo, params, blk_mgr, update_arena,
+            bond_vals, trunc_err, rank, comm);
+      }
+    }
+    // The lowest energy of the last updates.
+    MPI_Allreduce(MPI_IN_PLACE, &e0, 1, MPI_DOUBLE, MPI_MIN, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &max_trunc_err, 1, MPI_DOUBLE, MPI_MAX, comm);
+    if (rank == 0) { sweep_timer.PrintElapsed(); }
+    if (convergence.Check(sweep, e0, max_trunc_err)) {
+      if (rank == 0) {
+        std::cout << "converged after sweep " << sweep << "\n" << std::endl;
+      }
+      break;
+    }
+    if (rank == 0) { std::cout << "\n"; }
+  }
+
+  // Absorb the inverse bond values of the right boundary, then back to the
+  // right-canonical form. The MPS stays distributed.
+  if (e < N) {
+    auto pinv = InverseBondValues(*bond_vals[e]);
+    auto pten = ContractRightBond(*mps[e-1], *pinv);
+    delete mps[e-1];
+    mps[e-1] = pten;
+    delete pinv;
+  }
+  MpiRightCanonicalizeMps(mps, s, e, rank, comm);
+  if (sweep_params.FileIO) { DumpMpsSegment(mps, s, e); }
+  for (auto &pbond_val : bond_vals) { delete pbond_val; }
+  return e0;
+}
+} /* gqmps2 */
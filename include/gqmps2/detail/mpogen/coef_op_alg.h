@@ -11,6 +11,9 @@
 #include "gqmps2/detail/mpogen/sparse_mat.h"
 
 #include <vector>
+#include <map>
+#include <unordered_map>
+#include <functional>
 #include <algorithm>
 #include <iostream>
 
@@ -113,15 +116,9 @@ const OpLabel kIdOpLabel = 0;         // Coefficient label for identity id.
 
 
 // Representation of operator.
-class SparOpReprMat;    // Forward declaration.
-
 class OpRepr {
 friend std::pair<CoefRepr, OpRepr> SeparateCoefAndBase(const OpRepr &);
 friend OpRepr CoefReprOpReprIncompleteMulti(const CoefRepr &, const OpRepr &);
-friend std::vector<OpRepr> CalcSparOpReprMatRowLinCmb(
-    const SparOpReprMat &, const CoefReprVec &);
-friend std::vector<OpRepr> CalcSparOpReprMatColLinCmb(
-    const SparOpReprMat &, const CoefReprVec &);
 
 public:
   OpRepr(void) : coef_repr_list_(), op_label_list_() {}
@@ -287,10 +284,7 @@ public:
       SparOpReprMatBase(spar_mat) {}
 
   SparOpReprMat &operator=(const SparOpReprMat &spar_mat) {
-    rows = spar_mat.rows;
-    cols = spar_mat.cols;
-    data = spar_mat.data;
-    indexes = spar_mat.indexes;
+    SparOpReprMatBase::operator=(spar_mat);
     return *this;
   }
 
@@ -318,10 +312,8 @@ public:
 
   CoefRepr CalcRowCoef(const size_t row_idx) {
     std::vector<CoefRepr> nonull_op_repr_coefs;
-    for (size_t y = 0; y < cols; ++y) {
-      if (indexes[CalcOffset(row_idx, y)] != -1) {
-        nonull_op_repr_coefs.push_back(GetOpReprCoef((*this)(row_idx, y)));
-      }
+    for (auto &elem : GetRowElems(row_idx)) {
+      nonull_op_repr_coefs.push_back(GetOpReprCoef(elem.second));
     }
     if (nonull_op_repr_coefs.size() == 0) {
       return kNullCoefRepr;
@@ -338,10 +330,8 @@ public:
 
   CoefRepr CalcColCoef(const size_t col_idx) {
     std::vector<CoefRepr> nonull_op_repr_coefs;
-    for (size_t x = 0; x < rows; ++x) {
-      if (indexes[CalcOffset(x, col_idx)] != -1) {
-        nonull_op_repr_coefs.push_back(GetOpReprCoef((*this)(x, col_idx)));
-      }
+    for (auto x : GetColRowIdxs(col_idx)) {
+      nonull_op_repr_coefs.push_back(GetOpReprCoef((*this)(x, col_idx)));
     }
     if (nonull_op_repr_coefs.size() == 0) {
       return kNullCoefRepr;
@@ -357,84 +347,52 @@ public:
   }
 
   void RemoveRowCoef(const size_t row_idx) {
-    for (size_t y = 0; y < cols; ++y) {
-      if (indexes[CalcOffset(row_idx, y)] != -1) {
-        auto elem = (*this)(row_idx, y);
-        this->SetElem(row_idx, y, SeparateCoefAndBase(elem).second);
-      }
+    for (auto &elem : GetRowElems(row_idx)) {
+      this->SetElem(
+          row_idx, elem.first, SeparateCoefAndBase(elem.second).second);
     }
   }
 
   void RemoveColCoef(const size_t col_idx) {
-    for (size_t x = 0; x < rows; ++x) {
-      if (indexes[CalcOffset(x, col_idx)] != -1) {
-        auto elem = (*this)(x, col_idx);
-        this->SetElem(x, col_idx, SeparateCoefAndBase(elem).second);
-      }
+    for (auto x : GetColRowIdxs(col_idx)) {
+      auto elem = (*this)(x, col_idx);
+      this->SetElem(x, col_idx, SeparateCoefAndBase(elem).second);
     }
   }
 
   CoefReprVec CalcRowLinCmb(const size_t row_idx) const {
-    auto row = GetRow(row_idx);
     CoefReprVec cmb_coefs;
     for (size_t x = 0; x < row_idx; ++x) {
-      cmb_coefs.push_back(CalcRowOverlap_(row, x));
+      cmb_coefs.push_back(CalcRowOverlap(row_idx, x));
     }
     return cmb_coefs;
   }
 
   CoefReprVec CalcColLinCmb(const size_t col_idx) const {
-    auto col = GetCol(col_idx);
     CoefReprVec cmb_coefs;
     for (size_t y = 0; y < col_idx; ++y) {
-      cmb_coefs.push_back(CalcColOverlap_(col, y));
+      cmb_coefs.push_back(CalcColOverlap(col_idx, y));
     }
     return cmb_coefs;
   }
 
-private:
-  using SortMapping = std::vector<std::pair<size_t, size_t>>;   // # of no null : row_idx
-
-  SortMapping GenSortRowsMapping_(void) const {
-    SortMapping mapping;
-    for (size_t x = 0; x < rows; ++x) {
-      size_t nonull_elem_num = 0;
-      for (size_t y = 0; y < cols; ++y) {
-        if (indexes[CalcOffset(x, y)] != -1) { nonull_elem_num++; }
-      }
-      mapping.push_back(std::make_pair(nonull_elem_num, x));
-    }
-    return mapping;
-  }
-
-  SortMapping GenSortColsMapping_(void) const {
-    SortMapping mapping;
-    for (size_t y = 0; y < cols; ++y) {
-      size_t nonull_elem_num = 0;
-      for (size_t x = 0; x < rows; ++x) {
-        if (indexes[CalcOffset(x, y)] != -1) { nonull_elem_num++; }
-      }
-      mapping.push_back(std::make_pair(nonull_elem_num, y));
-    }
-    return mapping;
-  }
-
-  CoefRepr CalcRowOverlap_(
-      const std::vector<OpRepr> &row, const size_t tgt_row_idx) const {
+  // Coefficient c with which the row row_idx equals c times the row
+  // tgt_row_idx on the non-null elements of the latter, null if there is not
+  // such a coefficient.
+  CoefRepr CalcRowOverlap(
+      const size_t row_idx, const size_t tgt_row_idx) const {
     CoefReprVec poss_overlaps;
-    for (size_t y = 0; y < cols; ++y) {
-      if (indexes[CalcOffset(tgt_row_idx, y)] != -1) {
-        auto tgt_op = row[y];
-        auto base_op = (*this)(tgt_row_idx, y);
-        if (tgt_op == base_op) {
-          poss_overlaps.push_back(kIdCoefRepr);
+    for (auto &elem : GetRowElems(tgt_row_idx)) {
+      auto &tgt_op = (*this)(row_idx, elem.first);
+      auto &base_op = elem.second;
+      if (tgt_op == base_op) {
+        poss_overlaps.push_back(kIdCoefRepr);
+      } else {
+        auto tgt_coef_and_base_op = SeparateCoefAndBase(tgt_op);
+        if (tgt_coef_and_base_op.second == base_op) {
+          poss_overlaps.push_back(tgt_coef_and_base_op.first);
         } else {
-          auto tgt_coef_and_base_op = SeparateCoefAndBase(tgt_op);
-          if (tgt_coef_and_base_op.second == base_op) {
-            poss_overlaps.push_back(tgt_coef_and_base_op.first);
-          } else {
-            return kNullCoefRepr;
-          }
+          return kNullCoefRepr;
         }
       }
     }
@@ -447,22 +405,20 @@ private:
     return poss_overlaps[0];
   }
 
-  CoefRepr CalcColOverlap_(
-      const std::vector<OpRepr> &col, const size_t tgt_col_idx) const {
+  CoefRepr CalcColOverlap(
+      const size_t col_idx, const size_t tgt_col_idx) const {
     CoefReprVec poss_overlaps;
-    for (size_t x = 0; x < rows; ++x) {
-      if (indexes[CalcOffset(x, tgt_col_idx)] != -1) {
-        auto tgt_op = col[x];
-        auto base_op = (*this)(x, tgt_col_idx);
-        if (tgt_op == base_op) {
-          poss_overlaps.push_back(kIdCoefRepr);
+    for (auto x : GetColRowIdxs(tgt_col_idx)) {
+      auto &tgt_op = (*this)(x, col_idx);
+      auto &base_op = (*this)(x, tgt_col_idx);
+      if (tgt_op == base_op) {
+        poss_overlaps.push_back(kIdCoefRepr);
+      } else {
+        auto tgt_coef_and_base_op = SeparateCoefAndBase(tgt_op);
+        if (tgt_coef_and_base_op.second == base_op) {
+          poss_overlaps.push_back(tgt_coef_and_base_op.first);
         } else {
-          auto tgt_coef_and_base_op = SeparateCoefAndBase(tgt_op);
-          if (tgt_coef_and_base_op.second == base_op) {
-            poss_overlaps.push_back(tgt_coef_and_base_op.first);
-          } else {
-            return kNullCoefRepr;
-          }
+          return kNullCoefRepr;
         }
       }
     }
@@ -474,6 +430,25 @@ private:
     }
     return poss_overlaps[0];
   }
+
+private:
+  using SortMapping = std::vector<std::pair<size_t, size_t>>;   // # of no null : row_idx
+
+  SortMapping GenSortRowsMapping_(void) const {
+    SortMapping mapping;
+    for (size_t x = 0; x < rows; ++x) {
+      mapping.push_back(std::make_pair(GetRowElems(x).size(), x));
+    }
+    return mapping;
+  }
+
+  SortMapping GenSortColsMapping_(void) const {
+    SortMapping mapping;
+    for (size_t y = 0; y < cols; ++y) {
+      mapping.push_back(std::make_pair(GetColRowIdxs(y).size(), y));
+    }
+    return mapping;
+  }
 };
 
 using SparOpReprMatVec = std::vector<SparOpReprMat>;
@@ -494,52 +469,23 @@ OpRepr CoefReprOpReprIncompleteMulti(const CoefRepr &coef, const OpRepr &op) {
 }
 
 
-void SparCoefReprMatSparOpReprMatIncompleteMultiKernel(
-    const SparCoefReprMat &coef_mat, const SparOpReprMat &op_mat,
-    const size_t coef_mat_row_idx, const size_t op_mat_col_idx,
-    SparOpReprMat &res) {
-  OpRepr res_elem;
-  for (size_t i = 0; i < coef_mat.cols; ++i) {
-    if (coef_mat.indexes[coef_mat.CalcOffset(coef_mat_row_idx, i)] != -1 &&
-        op_mat.indexes[op_mat.CalcOffset(i, op_mat_col_idx)] != -1) {
-      res_elem = res_elem + CoefReprOpReprIncompleteMulti(
-                                coef_mat(coef_mat_row_idx, i),
-                                op_mat(i, op_mat_col_idx));
-    }
-  }
-  if (res_elem != kNullOpRepr) {
-    res.SetElem(coef_mat_row_idx, op_mat_col_idx, res_elem);
-  }
-}
-
-
-void SparOpReprMatSparCoefReprMatIncompleteMultiKernel(
-    const SparOpReprMat &op_mat, const SparCoefReprMat &coef_mat,
-    const size_t op_mat_row_idx, const size_t coef_mat_col_idx,
-    SparOpReprMat &res) {
-  OpRepr res_elem;
-  for (size_t i = 0; i < op_mat.cols; ++i) {
-    if (op_mat.indexes[op_mat.CalcOffset(op_mat_row_idx, i)] != -1 &&
-        coef_mat.indexes[coef_mat.CalcOffset(i, coef_mat_col_idx)] != -1) {
-      res_elem = res_elem + CoefReprOpReprIncompleteMulti(
-                                coef_mat(i, coef_mat_col_idx),
-                                op_mat(op_mat_row_idx, i));
-    }
-  }
-  if (res_elem != kNullOpRepr) {
-    res.SetElem(op_mat_row_idx, coef_mat_col_idx, res_elem);
-  }
-}
-
-
+// The products run over the non-null elements only. The terms of each result
+// element are summed up in the ascending order of the inner index.
 SparOpReprMat SparCoefReprMatSparOpReprMatIncompleteMulti(
     const SparCoefReprMat &coef_mat, const SparOpReprMat &op_mat) {
   assert(coef_mat.cols == op_mat.rows);
   SparOpReprMat res(coef_mat.rows, op_mat.cols);
   for (size_t x = 0; x < coef_mat.rows; ++x) {
-    for (size_t y = 0; y < op_mat.cols; ++y) {
-      SparCoefReprMatSparOpReprMatIncompleteMultiKernel(
-          coef_mat, op_mat, x, y, res);
+    std::map<size_t, OpRepr> res_row;
+    for (auto &coef_elem : coef_mat.GetRowElems(x)) {
+      for (auto &op_elem : op_mat.GetRowElems(coef_elem.first)) {
+        auto &res_elem = res_row[op_elem.first];
+        res_elem = res_elem + CoefReprOpReprIncompleteMulti(
+                                  coef_elem.second, op_elem.second);
+      }
+    }
+    for (auto &res_elem : res_row) {
+      res.SetElem(x, res_elem.first, res_elem.second);
     }
   }
   return res;
@@ -551,144 +497,290 @@ SparOpReprMat SparOpReprMatSparCoefReprMatIncompleteMulti(
   assert(op_mat.cols == coef_mat.rows);
   SparOpReprMat res(op_mat.rows, coef_mat.cols);
   for (size_t x = 0; x < op_mat.rows; ++x) {
-    for (size_t y = 0; y < coef_mat.cols; ++y) {
-      SparOpReprMatSparCoefReprMatIncompleteMultiKernel(
-          op_mat, coef_mat, x, y, res);
+    std::map<size_t, OpRepr> res_row;
+    for (auto &op_elem : op_mat.GetRowElems(x)) {
+      for (auto &coef_elem : coef_mat.GetRowElems(op_elem.first)) {
+        auto &res_elem = res_row[coef_elem.first];
+        res_elem = res_elem + CoefReprOpReprIncompleteMulti(
+                                  coef_elem.second, op_elem.second);
+      }
+    }
+    for (auto &res_elem : res_row) {
+      res.SetElem(x, res_elem.first, res_elem.second);
     }
   }
   return res;
 }
 
 
-// Row and column delinearization.
-/* TODO: So bad implementation, need refactor. */
-OpReprVec CalcSparOpReprMatRowLinCmb(
-    const SparOpReprMat &m, const CoefReprVec &cmb) {
-  auto work_row_num = cmb.size();
-  assert(work_row_num > 0);
-  auto res = OpReprVec(m.cols, kNullOpRepr);
-  for (size_t i = 0; i < work_row_num; ++i) {
-    auto cmb_coef = cmb[i];
-    auto row = m.GetRow(i);
-    if (cmb_coef == kIdCoefRepr) {
-      for (size_t j = 0; j < m.cols; ++j) {
-        res[j] = res[j] + row[j];
-      }
-    } else if (cmb_coef == kNullCoefRepr) {
-      // Do nothing.
-    } else {
-      for (size_t j = 0; j < m.cols; ++j) {
-        auto elem = row[j];
-        for (auto &coef_repr : elem.coef_repr_list_) {
-          if (coef_repr == kIdCoefRepr) {
-            coef_repr = cmb_coef;
-          } else {
-            std::cout << "Unsupported operation!" << std::endl;
-            exit(1);
-          }
-        }
-        res[j] = res[j] + elem;
+// Hash helpers.
+inline void HashCombine(size_t &seed, const size_t val) {
+  seed ^= std::hash<size_t>()(val) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+
+// The operator labels are summed up since the order of the terms of an
+// operator representation is irrelevant. The coefficients are left out, thus a
+// multiple of an operator representation has the same hash.
+inline size_t HashOpReprBase(const OpRepr &op_repr) {
+  size_t op_labels_hash = 0;
+  for (auto op_label : op_repr.GetOpLabelList()) {
+    op_labels_hash += std::hash<long>()(op_label);
+  }
+  return op_labels_hash;
+}
+
+
+// Hash of an operator representation with its coefficients. The terms and the
+// coefficient labels of each term are summed up, as their orders are
+// irrelevant.
+struct OpReprHash {
+  size_t operator()(const OpRepr &op_repr) const {
+    auto coef_reprs = op_repr.GetCoefReprList();
+    auto op_labels = op_repr.GetOpLabelList();
+    size_t hash = 0;
+    for (size_t k = 0; k < op_labels.size(); ++k) {
+      size_t term_hash = std::hash<long>()(op_labels[k]);
+      size_t coef_labels_hash = 0;
+      for (auto coef_label : coef_reprs[k].GetCoefLabelList()) {
+        coef_labels_hash += std::hash<long>()(coef_label);
       }
+      HashCombine(term_hash, coef_labels_hash);
+      hash += term_hash;
     }
+    return hash;
   }
-  return res;
+};
+
+
+// Row and column delinearization.
+/*
+The rows are checked in one pass in the ascending order, the row i against the
+kept rows before it. Only the kept rows whose non-null elements all sit in the
+columns of the row i can overlap with it, they are found by counting their
+elements in these columns. If the linear combination of the overlapping rows
+differs from the row i, the kept rows with the same signature, which is the
+hash of the column indexes and the bases of the non-null elements, are checked
+for the one the row i is a multiple of. The columns of the follower are
+transformed by one matrix multiplication in the end. The columns are
+delinearized in the same way.
+*/
+using SparOpReprMatLinCmb = std::map<size_t, CoefRepr>;
+
+
+inline size_t HashSparOpReprMatRowSig(const SparOpReprMat &m, const size_t x) {
+  size_t seed = 0;
+  for (auto &elem : m.GetRowElems(x)) {
+    HashCombine(seed, elem.first);
+    HashCombine(seed, HashOpReprBase(elem.second));
+  }
+  return seed;
 }
 
 
-OpReprVec CalcSparOpReprMatColLinCmb(
-    const SparOpReprMat &m, const CoefReprVec &cmb) {
-  auto work_col_num = cmb.size();
-  assert(work_col_num > 0);
-  auto res = OpReprVec(m.rows, kNullOpRepr);
-  for (size_t i = 0; i < work_col_num; ++i) {
-    auto cmb_coef = cmb[i];
-    auto col = m.GetCol(i);
-    if (cmb_coef == kIdCoefRepr) {
-      for (size_t j = 0; j < m.rows; ++j) {
-        res[j] = res[j] + col[j];
+inline size_t HashSparOpReprMatColSig(const SparOpReprMat &m, const size_t y) {
+  size_t seed = 0;
+  for (auto x : m.GetColRowIdxs(y)) {
+    HashCombine(seed, x);
+    HashCombine(seed, HashOpReprBase(m(x, y)));
+  }
+  return seed;
+}
+
+
+inline bool FindSparOpReprMatRowLinCmb(
+    const SparOpReprMat &m, const size_t row_idx,
+    const std::vector<std::vector<size_t>> &col_kept_row_idxs,
+    const std::unordered_multimap<size_t, size_t> &sig_kept_row_idxs,
+    const size_t sig, SparOpReprMatLinCmb &cmb) {
+  auto &row = m.GetRowElems(row_idx);
+  std::map<size_t, size_t> hit_nums;
+  for (auto &elem : row) {
+    for (auto x : col_kept_row_idxs[elem.first]) { ++hit_nums[x]; }
+  }
+  std::map<size_t, OpRepr> lin_cmb;
+  for (auto &hit_num : hit_nums) {
+    auto x = hit_num.first;
+    if (hit_num.second != m.GetRowElems(x).size()) { continue; }
+    auto overlap = m.CalcRowOverlap(row_idx, x);
+    if (overlap == kNullCoefRepr) { continue; }
+    cmb[x] = overlap;
+    for (auto &elem : m.GetRowElems(x)) {
+      auto &lin_cmb_elem = lin_cmb[elem.first];
+      lin_cmb_elem = lin_cmb_elem +
+                     CoefReprOpReprIncompleteMulti(overlap, elem.second);
+    }
+  }
+  if (lin_cmb.size() == row.size()) {
+    bool is_lin_cmb = true;
+    for (auto &elem : lin_cmb) {
+      if (elem.second != row.at(elem.first)) {
+        is_lin_cmb = false;
+        break;
       }
-    } else if (cmb_coef == kNullCoefRepr) {
-      // Do nothing.
-    } else {
-      for (size_t j = 0; j < m.rows; ++j) {
-        auto elem = col[j];
-        for (auto &coef_repr : elem.coef_repr_list_) {
-          if (coef_repr == kIdCoefRepr) {
-            coef_repr = cmb_coef;
-          } else {
-            std::cout << "Unsupported operation!" << std::endl;
-            exit(1);
-          }
-        }
-        res[j] = res[j] + elem;
+    }
+    if (is_lin_cmb) { return true; }
+  }
+
+  cmb.clear();
+  auto sig_range = sig_kept_row_idxs.equal_range(sig);
+  for (auto it = sig_range.first; it != sig_range.second; ++it) {
+    auto x = it->second;
+    if (m.GetRowElems(x).size() != row.size()) { continue; }
+    auto overlap = m.CalcRowOverlap(row_idx, x);
+    if (overlap != kNullCoefRepr) {
+      cmb[x] = overlap;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+inline bool FindSparOpReprMatColLinCmb(
+    const SparOpReprMat &m, const size_t col_idx,
+    const std::vector<std::vector<size_t>> &row_kept_col_idxs,
+    const std::unordered_multimap<size_t, size_t> &sig_kept_col_idxs,
+    const size_t sig, SparOpReprMatLinCmb &cmb) {
+  auto &col_row_idxs = m.GetColRowIdxs(col_idx);
+  std::map<size_t, size_t> hit_nums;
+  for (auto x : col_row_idxs) {
+    for (auto y : row_kept_col_idxs[x]) { ++hit_nums[y]; }
+  }
+  std::map<size_t, OpRepr> lin_cmb;
+  for (auto &hit_num : hit_nums) {
+    auto y = hit_num.first;
+    if (hit_num.second != m.GetColRowIdxs(y).size()) { continue; }
+    auto overlap = m.CalcColOverlap(col_idx, y);
+    if (overlap == kNullCoefRepr) { continue; }
+    cmb[y] = overlap;
+    for (auto x : m.GetColRowIdxs(y)) {
+      auto &lin_cmb_elem = lin_cmb[x];
+      lin_cmb_elem = lin_cmb_elem +
+                     CoefReprOpReprIncompleteMulti(overlap, m(x, y));
+    }
+  }
+  if (lin_cmb.size() == col_row_idxs.size()) {
+    bool is_lin_cmb = true;
+    for (auto &elem : lin_cmb) {
+      if (elem.second != m(elem.first, col_idx)) {
+        is_lin_cmb = false;
+        break;
       }
     }
+    if (is_lin_cmb) { return true; }
   }
-  return res;
+
+  cmb.clear();
+  auto sig_range = sig_kept_col_idxs.equal_range(sig);
+  for (auto it = sig_range.first; it != sig_range.second; ++it) {
+    auto y = it->second;
+    if (m.GetColRowIdxs(y).size() != col_row_idxs.size()) { continue; }
+    auto overlap = m.CalcColOverlap(col_idx, y);
+    if (overlap != kNullCoefRepr) {
+      cmb[y] = overlap;
+      return true;
+    }
+  }
+  return false;
 }
 
 
 void SparOpReprMatRowDelinearize(
     SparOpReprMat &target, SparOpReprMat &follower) {
   auto row_num = target.rows;
-  size_t i;
-  for (i = 1; i < row_num; ++i) {
-    auto cmb = target.CalcRowLinCmb(i);
-    if (CalcSparOpReprMatRowLinCmb(target, cmb) == target.GetRow(i)) {
-      // Remove the row.
-      target.RemoveRow(i);
-      // Construct transform matrix.
-      SparCoefReprMat trans_mat(row_num, row_num-1);
-      for (size_t j = 0; j < i; ++j) {
-        trans_mat.SetElem(j, j, kIdCoefRepr);
-      }
-      for (size_t j = 0; j < i; ++j) {
-        trans_mat.SetElem(i, j, cmb[j]);
-      }
-      for (size_t j = i+1; j < row_num; ++j) {
-        trans_mat.SetElem(j, j-1, kIdCoefRepr);
+  std::vector<size_t> kept_row_idxs;
+  std::vector<std::vector<size_t>> col_kept_row_idxs(target.cols);
+  std::unordered_multimap<size_t, size_t> sig_kept_row_idxs;
+  std::vector<std::pair<size_t, SparOpReprMatLinCmb>> rmvd_row_cmbs;
+  for (size_t i = 0; i < row_num; ++i) {
+    auto sig = HashSparOpReprMatRowSig(target, i);
+    SparOpReprMatLinCmb cmb;
+    if (i != 0 &&
+        FindSparOpReprMatRowLinCmb(
+            target, i, col_kept_row_idxs, sig_kept_row_idxs, sig, cmb)) {
+      rmvd_row_cmbs.push_back(std::make_pair(i, cmb));
+    } else {
+      kept_row_idxs.push_back(i);
+      for (auto &elem : target.GetRowElems(i)) {
+        col_kept_row_idxs[elem.first].push_back(i);
       }
-      // Calculate new follower.
-      follower = SparOpReprMatSparCoefReprMatIncompleteMulti(
-                     follower, trans_mat);
-      break;
+      sig_kept_row_idxs.emplace(sig, i);
     }
   }
-  if (i < row_num) {
-    SparOpReprMatRowDelinearize(target, follower);
+  if (rmvd_row_cmbs.empty()) { return; }
+
+  // Remove the rows and construct the transform matrix.
+  auto kept_row_num = kept_row_idxs.size();
+  std::vector<size_t> new_row_idxs(row_num);
+  SparOpReprMat new_target(kept_row_num, target.cols);
+  SparCoefReprMat trans_mat(row_num, kept_row_num);
+  for (size_t j = 0; j < kept_row_num; ++j) {
+    auto x = kept_row_idxs[j];
+    new_row_idxs[x] = j;
+    for (auto &elem : target.GetRowElems(x)) {
+      new_target.SetElem(j, elem.first, elem.second);
+    }
+    trans_mat.SetElem(x, j, kIdCoefRepr);
+  }
+  for (auto &rmvd_row_cmb : rmvd_row_cmbs) {
+    for (auto &cmb_coef : rmvd_row_cmb.second) {
+      trans_mat.SetElem(
+          rmvd_row_cmb.first, new_row_idxs[cmb_coef.first], cmb_coef.second);
+    }
   }
+  target = new_target;
+  // Calculate new follower.
+  follower = SparOpReprMatSparCoefReprMatIncompleteMulti(follower, trans_mat);
 }
 
 
 void SparOpReprMatColDelinearize(
     SparOpReprMat &target, SparOpReprMat &follower) {
   auto col_num = target.cols;
-  size_t i;
-  for (i = 1; i < col_num; ++i) {
-    auto cmb = target.CalcColLinCmb(i);
-    if (CalcSparOpReprMatColLinCmb(target, cmb) == target.GetCol(i)) {
-      // Remove the col.
-      target.RemoveCol(i);
-      // Construct transform matrix.
-      SparCoefReprMat trans_mat(col_num-1, col_num);
-      for (size_t j = 0; j < i; ++j) {
-        trans_mat.SetElem(j, j, kIdCoefRepr);
-      }
-      for (size_t j = 0; j < i; ++j) {
-        trans_mat.SetElem(j, i, cmb[j]);
-      }
-      for (size_t j = i+1; j < col_num; ++j) {
-        trans_mat.SetElem(j-1, j, kIdCoefRepr);
+  std::vector<size_t> kept_col_idxs;
+  std::vector<std::vector<size_t>> row_kept_col_idxs(target.rows);
+  std::unordered_multimap<size_t, size_t> sig_kept_col_idxs;
+  std::vector<std::pair<size_t, SparOpReprMatLinCmb>> rmvd_col_cmbs;
+  for (size_t i = 0; i < col_num; ++i) {
+    auto sig = HashSparOpReprMatColSig(target, i);
+    SparOpReprMatLinCmb cmb;
+    if (i != 0 &&
+        FindSparOpReprMatColLinCmb(
+            target, i, row_kept_col_idxs, sig_kept_col_idxs, sig, cmb)) {
+      rmvd_col_cmbs.push_back(std::make_pair(i, cmb));
+    } else {
+      kept_col_idxs.push_back(i);
+      for (auto x : target.GetColRowIdxs(i)) {
+        row_kept_col_idxs[x].push_back(i);
       }
-      // Calculate new follower.
-      follower = SparCoefReprMatSparOpReprMatIncompleteMulti(
-                     trans_mat, follower);
-      break;
+      sig_kept_col_idxs.emplace(sig, i);
     }
   }
-  if (i < col_num) {
-    SparOpReprMatColDelinearize(target, follower);
+  if (rmvd_col_cmbs.empty()) { return; }
+
+  // Remove the cols and construct the transform matrix.
+  auto kept_col_num = kept_col_idxs.size();
+  std::vector<size_t> new_col_idxs(col_num);
+  SparOpReprMat new_target(target.rows, kept_col_num);
+  SparCoefReprMat trans_mat(kept_col_num, col_num);
+  for (size_t j = 0; j < kept_col_num; ++j) {
+    auto y = kept_col_idxs[j];
+    new_col_idxs[y] = j;
+    for (auto x : target.GetColRowIdxs(y)) {
+      new_target.SetElem(x, j, target(x, y));
+    }
+    trans_mat.SetElem(j, y, kIdCoefRepr);
+  }
+  for (auto &rmvd_col_cmb : rmvd_col_cmbs) {
+    for (auto &cmb_coef : rmvd_col_cmb.second) {
+      trans_mat.SetElem(
+          new_col_idxs[cmb_coef.first], rmvd_col_cmb.first, cmb_coef.second);
+    }
   }
+  target = new_target;
+  // Calculate new follower.
+  follower = SparCoefReprMatSparOpReprMatIncompleteMulti(trans_mat, follower);
 }
 
 
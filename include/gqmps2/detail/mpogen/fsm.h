@@ -12,6 +12,11 @@
 #include "gqmps2/detail/mpogen/coef_op_alg.h"
 
 #include <vector>
+#include <complex>
+#include <unordered_map>
+#include <functional>
+#include <algorithm>
+#include <utility>
 
 #include <assert.h>
 
@@ -51,14 +56,30 @@ struct FSMPath {
 using FSMPathVec = std::vector<FSMPath>;
 
 
+// Compact form of a FSM path which the FSM stores. Only the span of the
+// nontrivial operators is kept, the identities outside of it are implied. The
+// operators in the span are run-length encoded, run_ops[k] sits on the sites
+// from run_site_idxs[k] to the site before the next run. The head operator,
+// which carries the coefficient, always forms its own run. The middle states
+// of the path are given by the order of the paths.
+struct FSMSpanPath {
+  size_t head_site_idx;
+  size_t tail_site_idx;
+  std::vector<size_t> run_site_idxs;
+  OpReprVec run_ops;
+};
+
+using FSMSpanPathVec = std::vector<FSMSpanPath>;
+
+
 class FSM {
 public:
   FSM(const size_t phys_site_num) :
       phys_site_num_(phys_site_num),
       fsm_site_num_(phys_site_num+1),
       mid_stat_nums_(phys_site_num+1, 0),
-      has_readys_(phys_site_num+1, false),
-      has_finals_(phys_site_num+1, false) {
+      ready_site_num_(0),
+      final_site_begin_(phys_site_num+1) {
     assert(fsm_site_num_ == phys_site_num_ + 1); 
   }
   
@@ -70,7 +91,13 @@ public:
 
   void AddPath(const size_t, const size_t, const OpReprVec &);
 
-  FSMPathVec GetFSMPaths(void) const { return fsm_paths_; }
+  void AddPath(
+      const size_t, const size_t,
+      const std::vector<size_t> &, const OpReprVec &);
+
+  FSMPathVec GetFSMPaths(void) const;
+
+  size_t GetSpanPathNum(void) const { return span_paths_.size(); }
 
   SparOpReprMatVec GenMatRepr(void) const;
 
@@ -78,21 +105,38 @@ public:
 
 
 private:
+  bool HasReady_(const size_t fsm_site_idx) const {
+    return fsm_site_idx < ready_site_num_;
+  }
+
+  bool HasFinal_(const size_t fsm_site_idx) const {
+    return fsm_site_idx >= final_site_begin_;
+  }
+
   std::vector<size_t> CalcFSMSiteDims_(void) const;
 
   std::vector<long> CalcFinalStatDimIdxs_(const std::vector<size_t> &) const;
 
+  size_t CalcStatDimIdx_(
+      const size_t, const long, const std::vector<long> &) const;
+
   void CastFSMPathToMatRepr_(
-      const FSMPath &,
+      const FSMSpanPath &,
       const std::vector<long> &,
+      std::vector<size_t> &,
       SparOpReprMatVec &) const;
 
   size_t phys_site_num_;
   size_t fsm_site_num_;
   std::vector<size_t> mid_stat_nums_;
-  std::vector<bool> has_readys_;
-  std::vector<bool> has_finals_;
-  FSMPathVec fsm_paths_;
+  // The FSM sites [0, ready_site_num_) have ready states, the FSM sites from
+  // final_site_begin_ on have final states.
+  size_t ready_site_num_;
+  size_t final_site_begin_;
+  FSMSpanPathVec span_paths_;
+  // Paths indexed by the hash of their spans with the head coefficients
+  // stripped, for merging the duplicates.
+  std::unordered_multimap<size_t, size_t> span_path_idxs_;
 };
 
 
@@ -101,45 +145,136 @@ const long kFSMReadyStatIdx = 0;
 const long kFSMFinalStatIdx = -1;
 
 
+// Helpers.
+inline void AppendFSMRun(
+    FSMSpanPath &span_path, const size_t site_idx, const OpRepr &op_repr) {
+  if (span_path.run_ops.size() > 1 && span_path.run_ops.back() == op_repr) {
+    return;
+  }
+  span_path.run_site_idxs.push_back(site_idx);
+  span_path.run_ops.push_back(op_repr);
+}
+
+
+inline size_t HashFSMSpanPath(const FSMSpanPath &span_path) {
+  size_t seed = 0;
+  HashCombine(seed, span_path.head_site_idx);
+  HashCombine(seed, span_path.tail_site_idx);
+  for (size_t k = 0; k < span_path.run_ops.size(); ++k) {
+    HashCombine(seed, span_path.run_site_idxs[k]);
+    HashCombine(seed, HashOpReprBase(span_path.run_ops[k]));
+  }
+  return seed;
+}
+
+
+// Whether two paths are the same term up to the coefficient.
+inline bool IsSameFSMSpanPathBase(
+    const FSMSpanPath &lhs, const FSMSpanPath &rhs) {
+  if ((lhs.head_site_idx != rhs.head_site_idx) ||
+      (lhs.tail_site_idx != rhs.tail_site_idx) ||
+      (lhs.run_site_idxs != rhs.run_site_idxs)) {
+    return false;
+  }
+  for (size_t k = 1; k < lhs.run_ops.size(); ++k) {
+    if (lhs.run_ops[k] != rhs.run_ops[k]) { return false; }
+  }
+  return SeparateCoefAndBase(lhs.run_ops[0]).second ==
+         SeparateCoefAndBase(rhs.run_ops[0]).second;
+}
+
+
 void FSM::AddPath(
       const size_t head_ntrvl_site_idx, const size_t tail_ntrvl_site_idx,
       const OpReprVec &ntrvl_ops) {
   assert(
       head_ntrvl_site_idx + ntrvl_ops.size() +
       (phys_site_num_ - tail_ntrvl_site_idx - 1) == phys_site_num_);
-  FSMPath fsm_path(phys_site_num_, fsm_site_num_);
-  // Set operator representations.
-  for (size_t i = 0; i < phys_site_num_; ++i) {
-    if (i < head_ntrvl_site_idx) {
-      fsm_path.op_reprs[i] = kIdOpRepr;
-    } else if (i > tail_ntrvl_site_idx) {
-      fsm_path.op_reprs[i] = kIdOpRepr;
-    } else {
-      fsm_path.op_reprs[i] = ntrvl_ops[i-head_ntrvl_site_idx];
+  std::vector<size_t> site_idxs(ntrvl_ops.size());
+  for (size_t i = 0; i < ntrvl_ops.size(); ++i) {
+    site_idxs[i] = head_ntrvl_site_idx + i;
+  }
+  AddPath(head_ntrvl_site_idx, tail_ntrvl_site_idx, site_idxs, ntrvl_ops);
+}
+
+
+// Add a path by the runs of the operators in the span, the operator
+// run_ops[k] sits on the sites from run_site_idxs[k] to the site before
+// run_site_idxs[k+1]. A path which differs from an added one only by the
+// coefficient is merged into it.
+void FSM::AddPath(
+      const size_t head_ntrvl_site_idx, const size_t tail_ntrvl_site_idx,
+      const std::vector<size_t> &run_site_idxs, const OpReprVec &run_ops) {
+  assert(tail_ntrvl_site_idx < phys_site_num_);
+  assert(!run_ops.empty() && run_site_idxs.size() == run_ops.size());
+  assert(run_site_idxs.front() == head_ntrvl_site_idx);
+  assert(run_site_idxs.back() <= tail_ntrvl_site_idx);
+  FSMSpanPath span_path;
+  span_path.head_site_idx = head_ntrvl_site_idx;
+  span_path.tail_site_idx = tail_ntrvl_site_idx;
+  AppendFSMRun(span_path, head_ntrvl_site_idx, run_ops[0]);
+  auto head_run_end = (run_ops.size() > 1) ?
+                      run_site_idxs[1] : (tail_ntrvl_site_idx + 1);
+  if (head_run_end > head_ntrvl_site_idx + 1) {
+    AppendFSMRun(span_path, head_ntrvl_site_idx + 1, run_ops[0]);
+  }
+  for (size_t k = 1; k < run_ops.size(); ++k) {
+    assert(run_site_idxs[k] > run_site_idxs[k-1]);
+    AppendFSMRun(span_path, run_site_idxs[k], run_ops[k]);
+  }
+
+  // Merge the duplicate.
+  auto hash = HashFSMSpanPath(span_path);
+  auto range = span_path_idxs_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    auto &added_span_path = span_paths_[it->second];
+    if (IsSameFSMSpanPathBase(added_span_path, span_path)) {
+      added_span_path.run_ops[0] =
+          added_span_path.run_ops[0] + span_path.run_ops[0];
+      return;
     }
   }
-  // Set FSM nodes.
-  fsm_path.fsm_nodes[0].fsm_site_idx = 0;
-  fsm_path.fsm_nodes[0].fsm_stat_idx = kFSMReadyStatIdx;
-  has_readys_[0] = true;
-  for (size_t i = 0; i < phys_site_num_; ++i) {
-    size_t tgt_fsm_site_idx = i + 1;
-    if (i < head_ntrvl_site_idx) {
-      fsm_path.fsm_nodes[tgt_fsm_site_idx].fsm_site_idx = tgt_fsm_site_idx;
-      fsm_path.fsm_nodes[tgt_fsm_site_idx].fsm_stat_idx = kFSMReadyStatIdx;
-      has_readys_[tgt_fsm_site_idx] = true;
-    } else if (i >= tail_ntrvl_site_idx) {
-      fsm_path.fsm_nodes[tgt_fsm_site_idx].fsm_site_idx = tgt_fsm_site_idx;
-      fsm_path.fsm_nodes[tgt_fsm_site_idx].fsm_stat_idx = kFSMFinalStatIdx;
-      has_finals_[tgt_fsm_site_idx] = true;
-    } else {
-      fsm_path.fsm_nodes[tgt_fsm_site_idx].fsm_site_idx = tgt_fsm_site_idx;
-      mid_stat_nums_[tgt_fsm_site_idx]++;
-      fsm_path.fsm_nodes[tgt_fsm_site_idx].fsm_stat_idx = 
-          mid_stat_nums_[tgt_fsm_site_idx];
+
+  ready_site_num_ = std::max(ready_site_num_, head_ntrvl_site_idx + 1);
+  final_site_begin_ = std::min(final_site_begin_, tail_ntrvl_site_idx + 1);
+  for (size_t i = head_ntrvl_site_idx + 1; i <= tail_ntrvl_site_idx; ++i) {
+    mid_stat_nums_[i]++;
+  }
+  span_path_idxs_.emplace(hash, span_paths_.size());
+  span_paths_.push_back(std::move(span_path));
+}
+
+
+// Full paths with the implied identities and FSM nodes, for inspection.
+FSMPathVec FSM::GetFSMPaths(void) const {
+  FSMPathVec fsm_paths;
+  std::vector<size_t> mid_stat_idxs(fsm_site_num_, 0);
+  for (auto &span_path : span_paths_) {
+    FSMPath fsm_path(phys_site_num_, fsm_site_num_);
+    for (size_t i = 0; i < fsm_site_num_; ++i) {
+      fsm_path.fsm_nodes[i].fsm_site_idx = i;
+      if (i <= span_path.head_site_idx) {
+        fsm_path.fsm_nodes[i].fsm_stat_idx = kFSMReadyStatIdx;
+      } else if (i > span_path.tail_site_idx) {
+        fsm_path.fsm_nodes[i].fsm_stat_idx = kFSMFinalStatIdx;
+      } else {
+        fsm_path.fsm_nodes[i].fsm_stat_idx = ++mid_stat_idxs[i];
+      }
+    }
+    for (size_t i = 0; i < phys_site_num_; ++i) {
+      fsm_path.op_reprs[i] = kIdOpRepr;
+    }
+    for (size_t k = 0; k < span_path.run_ops.size(); ++k) {
+      auto run_end = (k + 1 < span_path.run_ops.size()) ?
+                     span_path.run_site_idxs[k+1] :
+                     (span_path.tail_site_idx + 1);
+      for (size_t i = span_path.run_site_idxs[k]; i < run_end; ++i) {
+        fsm_path.op_reprs[i] = span_path.run_ops[k];
+      }
     }
+    fsm_paths.push_back(fsm_path);
   }
-  fsm_paths_.push_back(fsm_path);
+  return fsm_paths;
 }
 
 
@@ -152,8 +287,24 @@ SparOpReprMatVec FSM::GenMatRepr(void) const {
     auto mat_cols = fsm_site_dims[i+1];
     fsm_mat_repr.push_back(SparOpReprMat(mat_rows, mat_cols));
   }
-  for (auto &fsm_path : fsm_paths_) {
-    CastFSMPathToMatRepr_(fsm_path, final_stat_dim_idxs, fsm_mat_repr);
+  // The implied identities link the ready states and the final states once
+  // for all the paths.
+  for (size_t i = 0; i < phys_site_num_; ++i) {
+    if (HasReady_(i+1)) {
+      fsm_mat_repr[i].SetElem(
+          CalcStatDimIdx_(i, kFSMReadyStatIdx, final_stat_dim_idxs),
+          CalcStatDimIdx_(i+1, kFSMReadyStatIdx, final_stat_dim_idxs),
+          kIdOpRepr);
+    }
+    if (HasFinal_(i)) {
+      fsm_mat_repr[i].SetElem(
+          final_stat_dim_idxs[i], final_stat_dim_idxs[i+1], kIdOpRepr);
+    }
+  }
+  std::vector<size_t> mid_stat_idxs(fsm_site_num_, 0);
+  for (auto &span_path : span_paths_) {
+    CastFSMPathToMatRepr_(
+        span_path, final_stat_dim_idxs, mid_stat_idxs, fsm_mat_repr);
   }
   return fsm_mat_repr;
 }
@@ -163,8 +314,8 @@ std::vector<size_t> FSM::CalcFSMSiteDims_(void) const {
   std::vector<size_t> fsm_site_dims(fsm_site_num_, 0);
   for (size_t i = 0; i < fsm_site_num_; ++i) {
     auto fsm_site_dim = mid_stat_nums_[i];
-    if (has_readys_[i]) { fsm_site_dim++; }
-    if (has_finals_[i]) { fsm_site_dim++; }
+    if (HasReady_(i)) { fsm_site_dim++; }
+    if (HasFinal_(i)) { fsm_site_dim++; }
     fsm_site_dims[i] = fsm_site_dim;
   }
   return fsm_site_dims;
@@ -175,8 +326,8 @@ std::vector<long> FSM::CalcFinalStatDimIdxs_(
     const std::vector<size_t> &fsm_site_dims) const {
   std::vector<long> final_stat_dim_idxs(fsm_site_num_, -1);
   for (size_t i = 0; i < fsm_site_num_; ++i) {
-    if (has_finals_[i]) {
-      if (has_readys_[i]) {
+    if (HasFinal_(i)) {
+      if (HasReady_(i)) {
         final_stat_dim_idxs[i] = fsm_site_dims[i] - 1;
       } else {
         final_stat_dim_idxs[i] = 0;
@@ -187,31 +338,43 @@ std::vector<long> FSM::CalcFinalStatDimIdxs_(
 }
 
 
+size_t FSM::CalcStatDimIdx_(
+    const size_t fsm_site_idx, const long fsm_stat_idx,
+    const std::vector<long> &final_stat_dim_idxs) const {
+  if (fsm_stat_idx == kFSMFinalStatIdx) {
+    return final_stat_dim_idxs[fsm_site_idx];
+  } else if ((!HasReady_(fsm_site_idx)) && (!HasFinal_(fsm_site_idx))) {
+    return fsm_stat_idx - 1;
+  } else {
+    return fsm_stat_idx;
+  }
+}
+
+
+// Cast the span of the path, the middle states of the path are counted by
+// mid_stat_idxs.
 void FSM::CastFSMPathToMatRepr_(
-    const FSMPath &fsm_path,
+    const FSMSpanPath &span_path,
     const std::vector<long> &final_stat_dim_idxs,
+    std::vector<size_t> &mid_stat_idxs,
     SparOpReprMatVec &fsm_mat_repr) const {
-  for (size_t i = 0; i < phys_site_num_; ++i) {
-    auto tgt_row_fsm_node = fsm_path.fsm_nodes[i];
-    auto tgt_col_fsm_node = fsm_path.fsm_nodes[i+1];
-    auto tgt_op = fsm_path.op_reprs[i];
-
-    size_t tgt_row_idx, tgt_col_idx;
-    if (tgt_row_fsm_node.fsm_stat_idx == kFSMFinalStatIdx) {
-      tgt_row_idx = final_stat_dim_idxs[i];
-    } else if ((!has_readys_[i]) && (!has_finals_[i])) {
-      tgt_row_idx = tgt_row_fsm_node.fsm_stat_idx - 1;
-    } else {
-      tgt_row_idx = tgt_row_fsm_node.fsm_stat_idx;
-    }
-    if (tgt_col_fsm_node.fsm_stat_idx == kFSMFinalStatIdx) {
-      tgt_col_idx = final_stat_dim_idxs[i+1];
-    } else if ((!has_readys_[i+1]) && (!has_finals_[i+1])) {
-      tgt_col_idx = tgt_col_fsm_node.fsm_stat_idx - 1;
-    } else {
-      tgt_col_idx = tgt_col_fsm_node.fsm_stat_idx;
+  auto head = span_path.head_site_idx;
+  auto tail = span_path.tail_site_idx;
+  size_t run = 0;
+  long tgt_row_stat_idx = kFSMReadyStatIdx;
+  for (size_t i = head; i <= tail; ++i) {
+    if (run + 1 < span_path.run_ops.size() &&
+        span_path.run_site_idxs[run+1] == i) {
+      run++;
     }
-
+    const auto &tgt_op = span_path.run_ops[run];
+    long tgt_col_stat_idx = (i == tail) ?
+                            kFSMFinalStatIdx : ++mid_stat_idxs[i+1];
+
+    auto tgt_row_idx = CalcStatDimIdx_(
+                           i, tgt_row_stat_idx, final_stat_dim_idxs);
+    auto tgt_col_idx = CalcStatDimIdx_(
+                           i+1, tgt_col_stat_idx, final_stat_dim_idxs);
     if (fsm_mat_repr[i](tgt_row_idx, tgt_col_idx) == kNullOpRepr) {
       fsm_mat_repr[i].SetElem(tgt_row_idx, tgt_col_idx, tgt_op);
     } else if (fsm_mat_repr[i](tgt_row_idx, tgt_col_idx) != tgt_op) {
@@ -220,6 +383,7 @@ void FSM::CastFSMPathToMatRepr_(
     } else {
       // Do nothing
     }
+    tgt_row_stat_idx = tgt_col_stat_idx;
   }
 }
 
@@ -236,35 +400,58 @@ SparOpReprMatVec FSM::GenCompressedMatRepr(void) const {
 }
 
 
+// Hash of the objects which the label convertor converts, for the arithmetic
+// types and the complex numbers.
 template <typename ConvObjT>
+struct LabelObjHash {
+  size_t operator()(const ConvObjT &conv_obj) const {
+    return std::hash<ConvObjT>()(conv_obj);
+  }
+};
+
+template <typename T>
+struct LabelObjHash<std::complex<T>> {
+  size_t operator()(const std::complex<T> &conv_obj) const {
+    size_t seed = std::hash<T>()(conv_obj.real());
+    HashCombine(seed, std::hash<T>()(conv_obj.imag()));
+    return seed;
+  }
+};
+
+
+// The labels are looked up by the hash of the object and the equality check,
+// thus a conversion costs O(1) amortized.
+template <typename ConvObjT, typename HashT = LabelObjHash<ConvObjT>>
 class LabelConvertor {
 public:
   LabelConvertor(void) = default;
 
-  LabelConvertor(const ConvObjT &id) : conv_obj_hub_({id}) {}
+  LabelConvertor(const ConvObjT &id) { Convert(id); }
 
-  LabelConvertor<ConvObjT> &operator=(const LabelConvertor<ConvObjT> &rhs) {
+  LabelConvertor<ConvObjT, HashT> &operator=(
+      const LabelConvertor<ConvObjT, HashT> &rhs) {
     conv_obj_hub_ = rhs.conv_obj_hub_;
+    labels_ = rhs.labels_;
     return *this;
   }
 
   using ConvObjVec = std::vector<ConvObjT>;
 
   size_t Convert(const ConvObjT &conv_obj) {
-    auto poss_it = std::find(
-                       conv_obj_hub_.cbegin(), conv_obj_hub_.cend(), conv_obj);
-    if (poss_it == conv_obj_hub_.cend()) {
-      conv_obj_hub_.push_back(conv_obj);
-      size_t label = conv_obj_hub_.size() - 1;
-      return label;
-    } else {
-      size_t label = poss_it - conv_obj_hub_.cbegin();
-      return label;
+    auto hash = HashT()(conv_obj);
+    auto range = labels_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (conv_obj_hub_[it->second] == conv_obj) { return it->second; }
     }
+    conv_obj_hub_.push_back(conv_obj);
+    size_t label = conv_obj_hub_.size() - 1;
+    labels_.emplace(hash, label);
+    return label;
   }
 
   ConvObjVec GetLabelObjMapping(void) { return conv_obj_hub_; }
 private:
   ConvObjVec conv_obj_hub_;
+  std::unordered_multimap<size_t, size_t> labels_;
 };
 #endif /* ifndef GQMPS2_DETAIL_MPOGEN_FSM */
@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-21 10:10
+*
+* Description: GraceQ/MPS2 project. Implementation details for MPO cache.
+*/
+
+/**
+The cache directory holds one subdirectory for each generated MPO, named by the
+hexadecimal content hash of the MPO generator (with the compression cutoff if
+any). The MPO tensors are written atomically one by one, thus an MPO which is
+partly written by an interrupted job is found incomplete and generated again.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <functional>
+#include <cerrno>
+
+#include <sys/stat.h>
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Helpers.
+// The jobs sharing the cache may create the same path at the same time.
+inline void CreatSharedPath(const std::string &path) {
+  const int dir_err = mkdir(
+                          path.c_str(),
+                          S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+  if (dir_err == -1 && errno != EEXIST) {
+    std::cout << "error creating directory " << path << "!" << std::endl;
+    exit(1);
+  }
+}
+
+
+inline std::string GenMpoTenFileName(const std::string &path, const long i) {
+  return path + "/" +
+         kMpoTenBaseName + std::to_string(i) + "." + kGQTenFileSuffix;
+}
+
+
+template <typename TenType>
+void DumpMpo(const std::vector<TenType *> &mpo, const std::string &path) {
+  CreatSharedPath(path);
+  for (size_t i = 0; i < mpo.size(); ++i) {
+    WriteFileAtomic(GenMpoTenFileName(path, i), DumpBlockToBytes(*mpo[i]));
+  }
+}
+
+
+template <typename TenType>
+bool LoadMpo(std::vector<TenType *> &mpo, const std::string &path) {
+  auto N = mpo.size();
+  for (size_t i = 0; i < N; ++i) {
+    if (!IsPathExist(GenMpoTenFileName(path, i))) { return false; }
+  }
+  for (size_t i = 0; i < N; ++i) {
+    std::ifstream ifs(GenMpoTenFileName(path, i), std::ifstream::binary);
+    mpo[i] = new TenType();
+    bfread(ifs, *mpo[i]);
+    ifs.close();
+  }
+  return true;
+}
+
+
+// Load the MPO of N sites with the hash from the cache, otherwise generate it
+// by gen and save it.
+template <typename TenType>
+std::vector<TenType *> GenMpoThroughCache(
+    const long N, const uint64_t hash, const std::string &cache_path,
+    const std::function<std::vector<TenType *>(void)> &gen) {
+  std::ostringstream mpo_path;
+  mpo_path << cache_path << "/"
+           << std::hex << std::setw(16) << std::setfill('0') << hash;
+  std::vector<TenType *> mpo(N, nullptr);
+  if (LoadMpo(mpo, mpo_path.str())) {
+    std::cout << "MPO loaded from " << mpo_path.str() << std::endl;
+    return mpo;
+  }
+  mpo = gen();
+  CreatSharedPath(cache_path);
+  DumpMpo(mpo, mpo_path.str());
+  return mpo;
+}
+
+
+template <typename TenElemType>
+uint64_t MPOGenerator<TenElemType>::Hash(void) {
+  std::vector<uint64_t> words = {
+      uint64_t(N_),
+      HashTensor(id_op_),
+      HashTensor(GQTensorT({Index({QNSector(zero_div_, 1)}, OUT)}))};
+  for (auto &coef : coef_label_convertor_.GetLabelObjMapping()) {
+    words.push_back(
+        HashBytes(reinterpret_cast<const char *>(&coef), sizeof(coef)));
+  }
+  for (auto &op : op_label_convertor_.GetLabelObjMapping()) {
+    words.push_back(HashTensor(op));
+  }
+  words.push_back(terms_hash_);
+  return HashBytes(
+             reinterpret_cast<const char *>(words.data()),
+             words.size() * sizeof(uint64_t));
+}
+
+
+template <typename TenElemType>
+typename MPOGenerator<TenElemType>::PGQTensorVec
+MPOGenerator<TenElemType>::GenCached(const std::string &cache_path) {
+  return GenMpoThroughCache<GQTensorT>(
+             N_, Hash(), cache_path,
+             [this](void) { return Gen(); });
+}
+
+
+template <typename TenElemType>
+typename MPOGenerator<TenElemType>::PGQTensorVec
+MPOGenerator<TenElemType>::GenCached(
+    const double compress_cutoff, const std::string &cache_path) {
+  auto hash = HashBytes(
+                  reinterpret_cast<const char *>(&compress_cutoff),
+                  sizeof(compress_cutoff), Hash());
+  return GenMpoThroughCache<GQTensorT>(
+             N_, hash, cache_path,
+             [this, compress_cutoff](void) { return Gen(compress_cutoff); });
+}
+} /* gqmps2 */
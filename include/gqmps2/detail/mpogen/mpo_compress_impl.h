@@ -0,0 +1,123 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-20 17:20
+*
+* Description: GraceQ/MPS2 project. Implementation details for numerical MPO compression.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <unordered_set>
+#include <cmath>
+
+#include <assert.h>
+
+#ifdef Release
+  #define NDEBUG
+#endif
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Helpers.
+template <typename TenElemType>
+inline void ScaleMpoTen(GQTensor<TenElemType> * &pten, const double factor) {
+  auto pscaled = new GQTensor<TenElemType>(pten->indexes);
+  LinearCombine({TenElemType(factor)}, {pten}, pscaled);
+  delete pten;
+  pten = pscaled;
+}
+
+
+// Between the (pb_in, rvb, pb_out) and (pb_in, pb_out, rvb) forms of the head
+// tensor, and the (pb_in, lvb, pb_out) and (lvb, pb_in, pb_out) forms of the
+// tail tensor. Thus the left and the right virtual legs are the first and the
+// last legs of all the tensors.
+template <typename TenElemType>
+void TransposeMpoEnds(std::vector<GQTensor<TenElemType> *> &mpo) {
+  mpo.front()->Transpose({0, 2, 1});
+  mpo.back()->Transpose({1, 0, 2});
+}
+
+
+// Compress the MPO by SVD sweeps. The tensors are made left-orthonormal by a
+// sweep of untruncated SVDs, then the bonds are truncated by a sweep from the
+// right end, which keeps the singular values with the relative truncation
+// error cutoff of the Frobenius norm of the MPO. The quantum number blocks are
+// kept by the SVDs. The norms of the carried tensors are collected and spread
+// evenly over the sites in the end, thus large MPOs do not overflow. The
+// tensors are replaced site by site, thus an MPO whose sites share a tensor,
+// like the translation invariant one, is rejected.
+template <typename TenElemType>
+void CompressMpo(
+    std::vector<GQTensor<TenElemType> *> &mpo, const double cutoff) {
+  long N = mpo.size();
+  if (N < 2) { return; }
+  std::unordered_set<GQTensor<TenElemType> *> pmpo_tens(mpo.begin(), mpo.end());
+  if (long(pmpo_tens.size()) != N) {
+    std::cout << "CompressMpo can not compress the MPO with shared tensors, "
+              << "copy the tensors first." << std::endl;
+    exit(1);
+  }
+  TransposeMpoEnds(mpo);
+  std::vector<long> bef_dims;
+  for (long i = 0; i < N-1; ++i) {
+    bef_dims.push_back(mpo[i]->indexes.back().dim);
+  }
+
+  double log_norm = 0.0;
+  for (long i = 0; i < N-1; ++i) {
+    auto zero_div = Div(*mpo[i]) - Div(*mpo[i]);
+    auto svd_res = Svd(
+        *mpo[i],
+        mpo[i]->indexes.size() - 1, 1,
+        Div(*mpo[i]), zero_div);
+    delete mpo[i];
+    mpo[i] = svd_res.u;
+    auto psv = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+    delete svd_res.s;
+    delete svd_res.v;
+    log_norm += std::log(psv->Normalize());
+    auto pnext = Contract(*psv, *mpo[i+1], {{1}, {0}});
+    delete psv;
+    delete mpo[i+1];
+    mpo[i+1] = pnext;
+  }
+  for (long i = N-1; i > 0; --i) {
+    auto zero_div = Div(*mpo[i]) - Div(*mpo[i]);
+    auto svd_res = Svd(
+        *mpo[i],
+        1, mpo[i]->indexes.size() - 1,
+        zero_div, Div(*mpo[i]),
+        cutoff, 1, mpo[i]->indexes[0].dim);
+    delete mpo[i];
+    mpo[i] = svd_res.v;
+    auto pus = Contract(*svd_res.u, *svd_res.s, {{1}, {0}});
+    delete svd_res.u;
+    delete svd_res.s;
+    log_norm += std::log(pus->Normalize());
+    long prev_leg = mpo[i-1]->indexes.size() - 1;
+    auto pprev = Contract(*mpo[i-1], *pus, {{prev_leg}, {0}});
+    delete pus;
+    delete mpo[i-1];
+    mpo[i-1] = pprev;
+  }
+  auto factor = std::exp(log_norm / N);
+  for (auto &pmpo_ten : mpo) { ScaleMpoTen(pmpo_ten, factor); }
+
+  std::cout << "MPO compression with cutoff " << cutoff << std::endl;
+  for (long i = 0; i < N-1; ++i) {
+    std::cout << "bond " << std::setw(4) << i
+              << " D = " << std::setw(4) << bef_dims[i]
+              << " -> " << std::setw(4) << mpo[i]->indexes.back().dim
+              << std::endl;
+  }
+  TransposeMpoEnds(mpo);
+}
+} /* gqmps2 */
@@ -8,13 +8,20 @@
 #include "gqmps2/gqmps2.h"
 #include "gqten/gqten.h"
 #include "gqmps2/detail/mpogen/coef_op_alg.h"
+#include "gqmps2/detail/thread_pool.h"
 
 #include <iostream>
 #include <iomanip>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <thread>
 #include <algorithm>
 
 #include <assert.h>
 
+#include "mkl.h"
+
 #ifdef Release
   #define NDEBUG
 #endif
@@ -26,31 +33,52 @@ using namespace gqten;
 
 // Forward declarations.
 template <typename TenElemType>
-void AddOpToHeadMpoTen(
-    GQTensor<TenElemType> *, const GQTensor<TenElemType> &, const long);
+void AddOpsToMpoTen(
+    GQTensor<TenElemType> *,
+    const std::vector<const MpoOpElems<TenElemType> *> &,
+    const std::vector<std::vector<long>> &,
+    const std::vector<long> &,
+    const long, const long);
 
-template <typename TenElemType>
-void AddOpToTailMpoTen(
-    GQTensor<TenElemType> *, const GQTensor<TenElemType> &, const long);
 
+// The operators are told apart by GQTensor::operator==, which compares the
+// elements within a tolerance. Thus only the structure is hashed, the
+// dimensions and directions of the indexes and the sectors of the blocks.
 template <typename TenElemType>
-void AddOpToCentMpoTen(
-    GQTensor<TenElemType> *, const GQTensor<TenElemType> &,
-    const long, const long);
+size_t GQTensorLabelHash<TenElemType>::operator()(
+    const GQTensor<TenElemType> &op) const {
+  size_t hash = 0;
+  for (auto &index : op.indexes) {
+    HashCombine(hash, size_t(index.dir));
+    for (auto &qnsct : index.qnscts) { HashCombine(hash, qnsct.dim); }
+  }
+  // The order of the blocks does not matter.
+  size_t blks_hash = 0;
+  for (auto pblk : op.cblocks()) {
+    size_t blk_hash = 0;
+    for (auto id : BlockSectorIds(op, pblk)) { HashCombine(blk_hash, id); }
+    blks_hash += blk_hash;
+  }
+  HashCombine(hash, blks_hash);
+  return hash;
+}
 
 
 // MPO generator
 template <typename TenElemType>
 MPOGenerator<TenElemType>::MPOGenerator(
-    const long N, const Index &pb, const QN &zero_div) :
+    const long N, const Index &pb, const QN &zero_div, const long threads) :
     N_(N),
     pb_out_(pb),
     zero_div_(zero_div),
-    fsm_(N) {
+    fsm_(N),
+    threads_(threads),
+    terms_hash_(kFnvOffsetBasis) {
   pb_in_ = InverseIndex(pb_out_);
   id_op_ = GenIdOpTen_(pb_out_);
   coef_label_convertor_ = LabelConvertor<TenElemType>(TenElemType(1));
-  op_label_convertor_ = LabelConvertor<GQTensorT>(id_op_);
+  op_label_convertor_ = LabelConvertor<
+                            GQTensorT, GQTensorLabelHash<TenElemType>>(id_op_);
 }
 
 
@@ -83,28 +111,45 @@ void MPOGenerator<TenElemType>::AddTerm(
   } else if (inst_ops.size() == phys_ops.size()) {
     ntrvl_op_idx_tail = N_ - 1;
   }
-  OpReprVec ntrvl_op_reprs;
-  size_t last_phys_op_idx;
-  for (long i = ntrvl_op_idx_head; i <= ntrvl_op_idx_tail; ++i) {
-    auto poss_it = std::find(idxs.cbegin(), idxs.cend(), i);
-    if (poss_it != idxs.cend()) {
-      auto phys_ops_idx = poss_it - idxs.cbegin();
-      OpLabel op_label = op_label_convertor_.Convert(phys_ops[phys_ops_idx]);
-      if (phys_ops_idx == 0) {
-        ntrvl_op_reprs.push_back(OpRepr(coef_label, op_label));
-      } else {
-        ntrvl_op_reprs.push_back(OpRepr(op_label));
-      }
-      last_phys_op_idx = phys_ops_idx;
+  // Runs of the operators, each physical operator is followed by the run of
+  // its inserted operator up to the next physical operator. The sites are
+  // sorted ascendingly.
+  std::vector<size_t> run_site_idxs;
+  OpReprVec run_op_reprs;
+  std::vector<uint64_t> term_words;
+  for (size_t k = 0; k < phys_ops.size(); ++k) {
+    assert(k == 0 || idxs[k] > idxs[k-1]);
+    OpLabel op_label = op_label_convertor_.Convert(phys_ops[k]);
+    term_words.push_back(op_label);
+    run_site_idxs.push_back(idxs[k]);
+    if (k == 0) {
+      run_op_reprs.push_back(OpRepr(coef_label, op_label));
     } else {
-      OpLabel op_label = op_label_convertor_.Convert(
-                             inst_ops[last_phys_op_idx]);
-      ntrvl_op_reprs.push_back(OpRepr(op_label));
+      run_op_reprs.push_back(OpRepr(op_label));
+    }
+    long run_end = (k + 1 < phys_ops.size()) ?
+                   idxs[k+1] : (ntrvl_op_idx_tail + 1);
+    if (run_end > idxs[k] + 1) {
+      OpLabel inst_op_label = op_label_convertor_.Convert(inst_ops[k]);
+      term_words.push_back(inst_op_label);
+      run_site_idxs.push_back(idxs[k] + 1);
+      run_op_reprs.push_back(OpRepr(inst_op_label));
     }
   }
-  assert(ntrvl_op_reprs.size() == (ntrvl_op_idx_tail - ntrvl_op_idx_head + 1));
 
-  fsm_.AddPath(ntrvl_op_idx_head, ntrvl_op_idx_tail, ntrvl_op_reprs);
+  // The words of the term are chained into the hash of the terms. The labels
+  // of the coefficients and the operators follow their first registration,
+  // thus the chain is the same for the same terms added in the same order.
+  term_words.push_back(coef_label);
+  term_words.push_back(ntrvl_op_idx_head);
+  term_words.push_back(ntrvl_op_idx_tail);
+  term_words.insert(
+      term_words.end(), run_site_idxs.begin(), run_site_idxs.end());
+  terms_hash_ = HashBytes(
+                    reinterpret_cast<const char *>(term_words.data()),
+                    term_words.size() * sizeof(uint64_t), terms_hash_);
+  fsm_.AddPath(
+      ntrvl_op_idx_head, ntrvl_op_idx_tail, run_site_idxs, run_op_reprs);
 }
 
 template <typename TenElemType>
@@ -136,6 +181,10 @@ void MPOGenerator<TenElemType>::AddTerm(
 }
 
 
+// The columns of the MPO tensor representations are sorted by the quantum
+// numbers site by site, which fixes the virtual bonds. Then the distinct
+// elements of all the sites are realized once and the MPO tensors are filled,
+// both in parallel.
 template <typename TenElemType>
 typename MPOGenerator<TenElemType>::PGQTensorVec
 MPOGenerator<TenElemType>::Gen(void) {
@@ -148,32 +197,97 @@ MPOGenerator<TenElemType>::Gen(void) {
     std::cout << std::setw(3) << mpo_ten_repr.cols << std::endl;
   }
 
-  PGQTensorVec mpo(N_);
+  // The right virtual bonds of the sites.
+  std::vector<Index> rvbs;
   Index trans_vb({QNSector(zero_div_, 1)}, OUT);
   std::vector<size_t> transposed_idxs;
   for (long i = 0; i < N_; ++i) {
-    if (i == 0) {
-      transposed_idxs = SortSparOpReprMatColsByQN_(
-                            fsm_comp_mat_repr[i], trans_vb, label_op_mapping);
-      mpo[i] = HeadMpoTenRepr2MpoTen_(
-                   fsm_comp_mat_repr[i], trans_vb,
-                   label_coef_mapping, label_op_mapping);
-    } else if (i == N_-1) {
-      fsm_comp_mat_repr[i].TransposeRows(transposed_idxs);
-      auto lvb = InverseIndex(trans_vb);
-      mpo[i] = TailMpoTenRepr2MpoTen_(
-                   fsm_comp_mat_repr[i], lvb,
-                   label_coef_mapping, label_op_mapping);
-    } else {
-      fsm_comp_mat_repr[i].TransposeRows(transposed_idxs);
-      auto lvb = InverseIndex(trans_vb);
+    if (i != 0) { fsm_comp_mat_repr[i].TransposeRows(transposed_idxs); }
+    if (i == 0 || i != N_-1) {
       transposed_idxs = SortSparOpReprMatColsByQN_(
                             fsm_comp_mat_repr[i], trans_vb, label_op_mapping);
-      mpo[i] = CentMpoTenRepr2MpoTen_(
-                   fsm_comp_mat_repr[i], lvb, trans_vb,
-                   label_coef_mapping, label_op_mapping);
+      rvbs.push_back(trans_vb);
     }
   }
+
+  // Label the elements of each site in the row-major order.
+  LabelConvertor<OpRepr, OpReprHash> elem_label_convertor;
+  std::vector<std::vector<size_t>> elem_labels(N_);
+  for (long i = 0; i < N_; ++i) {
+    auto &op_repr_mat = fsm_comp_mat_repr[i];
+    for (size_t x = 0; x < op_repr_mat.rows; ++x) {
+      for (auto &row_elem : op_repr_mat.GetRowElems(x)) {
+        elem_labels[i].push_back(
+            elem_label_convertor.Convert(row_elem.second));
+      }
+    }
+  }
+  auto elems = elem_label_convertor.GetLabelObjMapping();
+
+  long threads = (threads_ > 0) ?
+                 threads_ : long(std::thread::hardware_concurrency());
+  auto ppool = SharedThreadPool(threads);
+  auto parallel_for = [ppool](
+      const long n, const std::function<void(long)> &func) {
+    if (ppool == nullptr) {
+      for (long i = 0; i < n; ++i) { func(i); }
+    } else {
+      // One MKL thread for each thread of the pool.
+      ppool->ParallelFor(
+          n,
+          [&func](const long i) {
+            auto mkl_threads = mkl_set_num_threads_local(1);
+            func(i);
+            mkl_set_num_threads_local(mkl_threads);
+          });
+    }
+  };
+
+  std::vector<MpoOpElems<TenElemType>> op_elems(elems.size());
+  parallel_for(
+      elems.size(),
+      [&](const long k) {
+        auto op = elems[k].Realize(label_coef_mapping, label_op_mapping);
+        for (long bpb_coor = 0; bpb_coor < op.indexes[0].dim; ++bpb_coor) {
+          for (long tpb_coor = 0; tpb_coor < op.indexes[1].dim; ++tpb_coor) {
+            auto elem = op.Elem({bpb_coor, tpb_coor});
+            if (elem != 0.0) {
+              op_elems[k].bpb_coors.push_back(bpb_coor);
+              op_elems[k].tpb_coors.push_back(tpb_coor);
+              op_elems[k].elems.push_back(elem);
+            }
+          }
+        }
+      });
+
+  PGQTensorVec mpo(N_);
+  parallel_for(
+      N_,
+      [&](const long i) {
+        if (i == 0) {
+          mpo[i] = HeadMpoTenRepr2MpoTen_(
+                       fsm_comp_mat_repr[i], rvbs[i],
+                       elem_labels[i], op_elems);
+        } else if (i == N_-1) {
+          mpo[i] = TailMpoTenRepr2MpoTen_(
+                       fsm_comp_mat_repr[i], InverseIndex(rvbs[i-1]),
+                       elem_labels[i], op_elems);
+        } else {
+          mpo[i] = CentMpoTenRepr2MpoTen_(
+                       fsm_comp_mat_repr[i],
+                       InverseIndex(rvbs[i-1]), rvbs[i],
+                       elem_labels[i], op_elems);
+        }
+      });
+  return mpo;
+}
+
+
+template <typename TenElemType>
+typename MPOGenerator<TenElemType>::PGQTensorVec
+MPOGenerator<TenElemType>::Gen(const double compress_cutoff) {
+  auto mpo = Gen();
+  CompressMpo(mpo, compress_cutoff);
   return mpo;
 }
 
@@ -199,35 +313,33 @@ std::vector<size_t> MPOGenerator<TenElemType>::SortSparOpReprMatColsByQN_(
   for (size_t y = 0; y < op_repr_mat.cols; ++y) {
     bool has_ntrvl_op = false;
     QN col_rvb_qn;
-    for (size_t x = 0; x < op_repr_mat.rows; ++x) {
+    for (auto x : op_repr_mat.GetColRowIdxs(y)) {
       auto elem = op_repr_mat(x, y);
-      if (elem != kNullOpRepr) {
-        auto rvb_qn = CalcTgtRvbQN_(
-                          x, y, elem, label_op_mapping, trans_vb);  
-        if (!has_ntrvl_op) {
-          col_rvb_qn = rvb_qn;
-          has_ntrvl_op = true; 
-          bool has_qn = false;
-          size_t offset = 0;
-          for (auto &qnsct : rvb_qnscts) {
-            if (qnsct.qn == rvb_qn) {
-              qnsct.dim += 1;
-              auto beg_it = transposed_idxs.begin();
-              transposed_idxs.insert(beg_it+offset, y);
-              has_qn = true;
-              break;
-            } else {
-              offset += qnsct.dim;
-            }
-          }
-          if (!has_qn) {
-            rvb_qnscts.push_back(QNSector(rvb_qn, 1));
+      auto rvb_qn = CalcTgtRvbQN_(
+                        x, y, elem, label_op_mapping, trans_vb);  
+      if (!has_ntrvl_op) {
+        col_rvb_qn = rvb_qn;
+        has_ntrvl_op = true; 
+        bool has_qn = false;
+        size_t offset = 0;
+        for (auto &qnsct : rvb_qnscts) {
+          if (qnsct.qn == rvb_qn) {
+            qnsct.dim += 1;
             auto beg_it = transposed_idxs.begin();
             transposed_idxs.insert(beg_it+offset, y);
+            has_qn = true;
+            break;
+          } else {
+            offset += qnsct.dim;
           }
-        } else {
-          assert(rvb_qn == col_rvb_qn); 
         }
+        if (!has_qn) {
+          rvb_qnscts.push_back(QNSector(rvb_qn, 1));
+          auto beg_it = transposed_idxs.begin();
+          transposed_idxs.insert(beg_it+offset, y);
+        }
+      } else {
+        assert(rvb_qn == col_rvb_qn); 
       }
     }
   }
@@ -242,15 +354,17 @@ typename MPOGenerator<TenElemType>::GQTensorT *
 MPOGenerator<TenElemType>::HeadMpoTenRepr2MpoTen_(
     const SparOpReprMat &op_repr_mat,
     const Index &rvb,
-    const TenElemVec &label_coef_mapping, const GQTensorVec &label_op_mapping) {
+    const std::vector<size_t> &elem_labels,
+    const std::vector<MpoOpElems<TenElemType>> &op_elems) {
   auto pmpo_ten = new GQTensorT({pb_in_, rvb, pb_out_});
-  for (size_t y = 0; y < op_repr_mat.cols; ++y) {
-    auto elem = op_repr_mat(0, y);
-    if (elem != kNullOpRepr) {
-      auto op = elem.Realize(label_coef_mapping, label_op_mapping);
-      AddOpToHeadMpoTen(pmpo_ten, op, y);
-    }
+  std::vector<const MpoOpElems<TenElemType> *> pops;
+  std::vector<std::vector<long>> vb_coors;
+  size_t k = 0;
+  for (auto &row_elem : op_repr_mat.GetRowElems(0)) {
+    pops.push_back(&op_elems[elem_labels[k++]]);
+    vb_coors.push_back({long(row_elem.first)});
   }
+  AddOpsToMpoTen(pmpo_ten, pops, vb_coors, {1}, 0, 2);
   return pmpo_ten;
 }
 
@@ -260,15 +374,17 @@ typename MPOGenerator<TenElemType>::GQTensorT *
 MPOGenerator<TenElemType>::TailMpoTenRepr2MpoTen_(
     const SparOpReprMat &op_repr_mat,
     const Index &lvb,
-    const TenElemVec &label_coef_mapping, const GQTensorVec &label_op_mapping) {
+    const std::vector<size_t> &elem_labels,
+    const std::vector<MpoOpElems<TenElemType>> &op_elems) {
   auto pmpo_ten = new GQTensor<TenElemType>({pb_in_, lvb, pb_out_});
-  for (size_t x = 0; x < op_repr_mat.rows; ++x) {
-    auto elem = op_repr_mat(x, 0);
-    if (elem != kNullOpRepr) {
-      auto op = elem.Realize(label_coef_mapping, label_op_mapping);
-      AddOpToTailMpoTen(pmpo_ten, op, x);
-    }
+  std::vector<const MpoOpElems<TenElemType> *> pops;
+  std::vector<std::vector<long>> vb_coors;
+  size_t k = 0;
+  for (auto x : op_repr_mat.GetColRowIdxs(0)) {
+    pops.push_back(&op_elems[elem_labels[k++]]);
+    vb_coors.push_back({long(x)});
   }
+  AddOpsToMpoTen(pmpo_ten, pops, vb_coors, {1}, 0, 2);
   return pmpo_ten;
 }
 
@@ -279,59 +395,44 @@ MPOGenerator<TenElemType>::CentMpoTenRepr2MpoTen_(
     const SparOpReprMat &op_repr_mat,
     const Index &lvb,
     const Index &rvb,
-    const TenElemVec &label_coef_mapping, const GQTensorVec &label_op_mapping) {
+    const std::vector<size_t> &elem_labels,
+    const std::vector<MpoOpElems<TenElemType>> &op_elems) {
   auto pmpo_ten = new GQTensor<TenElemType>({lvb, pb_in_, pb_out_, rvb});
+  std::vector<const MpoOpElems<TenElemType> *> pops;
+  std::vector<std::vector<long>> vb_coors;
+  size_t k = 0;
   for (size_t x = 0; x < op_repr_mat.rows; ++x) {
-    for (size_t y = 0; y < op_repr_mat.cols; ++y) {
-      auto elem = op_repr_mat(x, y);
-      if (elem != kNullOpRepr) {
-        auto op = elem.Realize(label_coef_mapping, label_op_mapping);
-        AddOpToCentMpoTen(pmpo_ten, op, x, y);
-      }
+    for (auto &row_elem : op_repr_mat.GetRowElems(x)) {
+      pops.push_back(&op_elems[elem_labels[k++]]);
+      vb_coors.push_back({long(x), long(row_elem.first)});
     }
   }
+  AddOpsToMpoTen(pmpo_ten, pops, vb_coors, {0, 3}, 1, 2);
   return pmpo_ten;
 }
 
 
+// Write the operators into the MPO tensor. The operator k sits at the
+// coordinates vb_coors[k] of the virtual legs vb_legs, its physical legs are
+// the legs bpb_leg and tpb_leg. Only the nonzero elements of the realized
+// operators are written, through the element access of the tensor.
 template <typename TenElemType>
-void AddOpToHeadMpoTen(
-    GQTensor<TenElemType> *pmpo_ten, const GQTensor<TenElemType> &rop, const long rvb_coor) {
-  for (long bpb_coor = 0; bpb_coor < rop.indexes[0].dim; ++bpb_coor) {
-    for (long tpb_coor = 0; tpb_coor < rop.indexes[1].dim; ++tpb_coor) {
-      auto elem = rop.Elem({bpb_coor, tpb_coor});
-      if (elem != 0.0) {
-        (*pmpo_ten)({bpb_coor, rvb_coor, tpb_coor}) = elem;
-      }
+void AddOpsToMpoTen(
+    GQTensor<TenElemType> *pmpo_ten,
+    const std::vector<const MpoOpElems<TenElemType> *> &pops,
+    const std::vector<std::vector<long>> &vb_coors,
+    const std::vector<long> &vb_legs,
+    const long bpb_leg, const long tpb_leg) {
+  std::vector<long> coors(pmpo_ten->indexes.size());
+  for (size_t k = 0; k < pops.size(); ++k) {
+    for (size_t v = 0; v < vb_legs.size(); ++v) {
+      coors[vb_legs[v]] = vb_coors[k][v];
     }
-  }
-}
-
-
-template <typename TenElemType>
-void AddOpToTailMpoTen(
-    GQTensor<TenElemType> *pmpo_ten, const GQTensor<TenElemType> &rop, const long lvb_coor) {
-  for (long bpb_coor = 0; bpb_coor < rop.indexes[0].dim; ++bpb_coor) {
-    for (long tpb_coor = 0; tpb_coor < rop.indexes[1].dim; ++tpb_coor) {
-      auto elem = rop.Elem({bpb_coor, tpb_coor});
-      if (elem != 0.0) {
-        (*pmpo_ten)({bpb_coor, lvb_coor, tpb_coor}) = elem;
-      }
-    }
-  }
-}
-
-
-template <typename TenElemType>
-void AddOpToCentMpoTen(
-    GQTensor<TenElemType> *pmpo_ten, const GQTensor<TenElemType> &rop,
-    const long lvb_coor, const long rvb_coor) {
-  for (long bpb_coor = 0; bpb_coor < rop.indexes[0].dim; ++bpb_coor) {
-    for (long tpb_coor = 0; tpb_coor < rop.indexes[1].dim; ++tpb_coor) {
-      auto elem = rop.Elem({bpb_coor, tpb_coor});
-      if (elem != 0.0) {
-        (*pmpo_ten)({lvb_coor, bpb_coor, tpb_coor, rvb_coor}) = elem;
-      }
+    auto &op_elems = *pops[k];
+    for (size_t e = 0; e < op_elems.elems.size(); ++e) {
+      coors[bpb_leg] = op_elems.bpb_coors[e];
+      coors[tpb_leg] = op_elems.tpb_coors[e];
+      (*pmpo_ten)(coors) = op_elems.elems[e];
     }
   }
 }
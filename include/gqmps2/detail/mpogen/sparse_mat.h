@@ -11,68 +11,96 @@
 
 #include <iostream>
 #include <vector>
+#include <map>
+#include <set>
+#include <utility>
 
+#include <assert.h>
 
+
+// The non-null elements are kept in the rows, which map the column indexes to
+// the elements, and the row indexes of the elements of each column are kept
+// too. Thus the memory is O(nnz + rows + cols), and removing or permuting rows
+// and columns costs O(nnz log(nnz) + rows + cols).
 template <typename ElemType>
 class SparMat {
 public:
-  SparMat(void) : rows(0), cols(0), data(), indexes() {}
+  using RowElems = std::map<size_t, ElemType>;
+  using ColRowIdxs = std::set<size_t>;
+
+  SparMat(void) : rows(0), cols(0), row_elems_(), col_row_idxs_() {}
 
   SparMat(const size_t row_num, const size_t col_num) :
       rows(row_num), cols(col_num),
-      data(), indexes(row_num*col_num, -1) {}
+      row_elems_(row_num), col_row_idxs_(col_num) {}
 
   SparMat(const SparMat<ElemType> &spar_mat) :
       rows(spar_mat.rows), cols(spar_mat.cols),
-      data(spar_mat.data), indexes(spar_mat.indexes) {}
+      row_elems_(spar_mat.row_elems_), col_row_idxs_(spar_mat.col_row_idxs_) {}
 
   SparMat<ElemType> &operator=(const SparMat<ElemType> &spar_mat) {
     rows = spar_mat.rows;
     cols = spar_mat.cols;
-    data = spar_mat.data;
-    indexes = spar_mat.indexes; 
+    row_elems_ = spar_mat.row_elems_;
+    col_row_idxs_ = spar_mat.col_row_idxs_;
     return *this;
   }
 
   // Element getter and setter.
   const ElemType &operator()(const size_t x, const size_t y) const {
-    auto offset = CalcOffset(x, y);
-    if (indexes[offset] == -1) {
+    assert(x < rows && y < cols);
+    auto &row_elems = row_elems_[x];
+    auto it = row_elems.find(y);
+    if (it == row_elems.end()) {
       return nullelem; 
     } else {
-      return data[indexes[offset]];
+      return it->second;
     }
   }
 
   void SetElem(const size_t x, const size_t y, const ElemType &elem) {
     if (elem == nullelem) { return; }
-    auto offset = CalcOffset(x, y);
-    if (indexes[offset] == -1) {
-      data.push_back(elem);
-      long idx = data.size() - 1;
-      indexes[offset] = idx;
-    } else {
-      data[indexes[offset]] = elem;
-    }
+    assert(x < rows && y < cols);
+    row_elems_[x][y] = elem;
+    col_row_idxs_[y].insert(x);
+  }
+
+  bool HasElem(const size_t x, const size_t y) const {
+    return row_elems_[x].count(y) != 0;
+  }
+
+  // Number of the non-null elements.
+  size_t nnz(void) const {
+    size_t elem_num = 0;
+    for (auto &row_elems : row_elems_) { elem_num += row_elems.size(); }
+    return elem_num;
+  }
+
+  // Non-null elements of the row, and row indexes of the non-null elements of
+  // the column, both in ascending order.
+  const RowElems &GetRowElems(const size_t row_idx) const {
+    assert(row_idx < rows); 
+    return row_elems_[row_idx];
+  }
+
+  const ColRowIdxs &GetColRowIdxs(const size_t col_idx) const {
+    assert(col_idx < cols); 
+    return col_row_idxs_[col_idx];
   }
 
   // Get row and column.
   std::vector<ElemType> GetRow(const size_t row_idx) const {
     assert(row_idx < rows); 
-    std::vector<ElemType> row;
-    row.reserve(cols);
-    for (size_t y = 0; y < cols; ++y) {
-      row.push_back((*this)(row_idx, y));
-    }
+    std::vector<ElemType> row(cols, nullelem);
+    for (auto &elem : row_elems_[row_idx]) { row[elem.first] = elem.second; }
     return row;
   }
   
   std::vector<ElemType> GetCol(const size_t col_idx) const {
     assert(col_idx < cols); 
-    std::vector<ElemType> col;
-    col.reserve(rows);
-    for (size_t x = 0; x < rows; ++x) {
-      col.push_back((*this)(x, col_idx));
+    std::vector<ElemType> col(rows, nullelem);
+    for (auto x : col_row_idxs_[col_idx]) {
+      col[x] = row_elems_[x].at(col_idx);
     }
     return col;
   }
@@ -88,6 +116,7 @@ public:
       return false;
     }
     for (size_t x = 0; x < rows; ++x) {
+      if (row_elems_[x] == rhs.row_elems_[x]) { continue; }
       for (size_t y = 0; y < cols; ++y) {
         if ((*this)(x, y) != rhs(x, y)) {
           std::cout << "No same elem at (" << x << "," << y << ")" << std::endl;
@@ -105,20 +134,9 @@ public:
       *this = SparMat<ElemType>();
       return;
     }
-    auto new_rows = rows - 1;
-    auto new_size = new_rows * cols;
-    std::vector<long> new_indexes(new_size);
-    for (size_t x = 0; x < rows; ++x) {
-      for (size_t y = 0; y < cols; ++y) {
-        if (x < row_idx) {
-          new_indexes[CalcOffset(x, y)] = indexes[CalcOffset(x, y)];
-        } else if (x > row_idx) {
-          new_indexes[CalcOffset(x-1, y)] = indexes[CalcOffset(x, y)];
-        }
-      }
-    }
-    rows = new_rows;
-    indexes = new_indexes;
+    row_elems_.erase(row_elems_.begin() + row_idx);
+    rows--;
+    RebuildColRowIdxs_();
   }
 
   void RemoveCol(const size_t col_idx) {
@@ -127,90 +145,94 @@ public:
       *this = SparMat<ElemType>();
       return;
     }
-    auto new_cols = cols - 1;
-    auto new_size = rows * new_cols;
-    std::vector<long> new_indexes(new_size);
-    for (size_t x = 0; x < rows; ++x) {
-      for (size_t y = 0; y < cols; ++y) {
-        if (y < col_idx) {
-          new_indexes[CalcOffset_(x, y, new_cols)] = indexes[CalcOffset(x, y)];
-        } else if (y > col_idx) {
-          new_indexes[CalcOffset_(x, y-1, new_cols)] =
-              indexes[CalcOffset(x, y)];
-        }
+    for (auto x : col_row_idxs_[col_idx]) { row_elems_[x].erase(col_idx); }
+    for (auto &row_elems : row_elems_) {
+      auto it = row_elems.upper_bound(col_idx);
+      if (it == row_elems.end()) { continue; }
+      RowElems new_row_elems(row_elems.begin(), it);
+      for (; it != row_elems.end(); ++it) {
+        new_row_elems.emplace_hint(
+            new_row_elems.end(), it->first - 1, std::move(it->second));
       }
+      row_elems = std::move(new_row_elems);
     }
-    cols = new_cols;
-    indexes = new_indexes;
+    col_row_idxs_.erase(col_row_idxs_.begin() + col_idx);
+    cols--;
   }
 
   // Swap two rows and columns.
   void SwapTwoRows(const size_t row_idx1, const size_t row_idx2) {
     assert(row_idx1 < rows && row_idx2 < rows);
     if (row_idx1 == row_idx2) { return; }
-    for (size_t y = 0; y < cols; ++y) {
-      auto offset1 = CalcOffset(row_idx1, y);
-      auto offset2 = CalcOffset(row_idx2, y);
-      auto temp = indexes[offset1];
-      indexes[offset1] = indexes[offset2];
-      indexes[offset2] = temp;
+    std::swap(row_elems_[row_idx1], row_elems_[row_idx2]);
+    for (auto row_idx : {row_idx1, row_idx2}) {
+      for (auto &elem : row_elems_[row_idx]) {
+        auto &col_row_idxs = col_row_idxs_[elem.first];
+        col_row_idxs.erase(row_idx1 + row_idx2 - row_idx);
+      }
+    }
+    for (auto row_idx : {row_idx1, row_idx2}) {
+      for (auto &elem : row_elems_[row_idx]) {
+        col_row_idxs_[elem.first].insert(row_idx);
+      }
     }
   }
 
   void SwapTwoCols(const size_t col_idx1, const size_t col_idx2) {
     assert(col_idx1 < cols && col_idx2 < cols);
     if (col_idx1 == col_idx2) { return; }
-    for (size_t x = 0; x < rows; ++x) {
-      auto offset1 = CalcOffset(x, col_idx1);
-      auto offset2 = CalcOffset(x, col_idx2);
-      auto temp = indexes[offset1];
-      indexes[offset1] = indexes[offset2];
-      indexes[offset2] = temp;
-    }
+    std::vector<size_t> transposed_col_idxs(cols);
+    for (size_t y = 0; y < cols; ++y) { transposed_col_idxs[y] = y; }
+    std::swap(transposed_col_idxs[col_idx1], transposed_col_idxs[col_idx2]);
+    TransposeCols(transposed_col_idxs);
   }
 
-  // Transpose rows and columns.
+  // Transpose rows and columns. The new row i is the old row
+  // transposed_row_idxs[i].
   void TransposeRows(const std::vector<size_t> &transposed_row_idxs) {
     assert(transposed_row_idxs.size() == rows);
-    std::vector<long> new_indexes(indexes.size());
+    std::vector<RowElems> new_row_elems(rows);
     for (size_t i = 0; i < rows; ++i) {
-      auto transposed_row_idx = transposed_row_idxs[i];
-      for (size_t y = 0; y < cols; ++y) {
-        new_indexes[CalcOffset(i, y)] =
-            indexes[CalcOffset(transposed_row_idx, y)];
-      }
+      new_row_elems[i] = std::move(row_elems_[transposed_row_idxs[i]]);
     }
-    indexes = new_indexes;
+    row_elems_ = std::move(new_row_elems);
+    RebuildColRowIdxs_();
   }
 
   void TransposeCols(const std::vector<size_t> &transposed_col_idxs) {
     assert(transposed_col_idxs.size() == cols);
-    std::vector<long> new_indexes(indexes.size());
+    std::vector<size_t> new_col_idxs(cols);
+    std::vector<ColRowIdxs> new_col_row_idxs(cols);
     for (size_t i = 0; i < cols; ++i) {
-      auto transposed_col_idx = transposed_col_idxs[i];
-      for (size_t x = 0; x < rows; ++x) {
-        new_indexes[CalcOffset(x, i)] =
-            indexes[CalcOffset(x, transposed_col_idx)];
+      new_col_idxs[transposed_col_idxs[i]] = i;
+      new_col_row_idxs[i] = std::move(col_row_idxs_[transposed_col_idxs[i]]);
+    }
+    for (auto &row_elems : row_elems_) {
+      RowElems new_row_elems;
+      for (auto &elem : row_elems) {
+        new_row_elems.emplace(new_col_idxs[elem.first], std::move(elem.second));
       }
+      row_elems = std::move(new_row_elems);
     }
-    indexes = new_indexes;
-  }
-  
-  size_t CalcOffset(const size_t x, const size_t y) const {
-    return x*cols + y;
+    col_row_idxs_ = std::move(new_col_row_idxs);
   }
 
   size_t rows;
   size_t cols;
-  std::vector<ElemType> data;
-  std::vector<long> indexes;
 
 private:
-  size_t CalcOffset_(
-      const size_t x, const size_t y, const size_t new_cols) const {
-    return x*new_cols + y; 
+  void RebuildColRowIdxs_(void) {
+    col_row_idxs_.assign(cols, ColRowIdxs());
+    for (size_t x = 0; x < rows; ++x) {
+      for (auto &elem : row_elems_[x]) {
+        col_row_idxs_[elem.first].insert(col_row_idxs_[elem.first].end(), x);
+      }
+    }
   }
 
+  std::vector<RowElems> row_elems_;
+  std::vector<ColRowIdxs> col_row_idxs_;
+
   static ElemType nullelem;
 };
 
@@ -0,0 +1,158 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-21 15:30
+*
+* Description: GraceQ/MPS2 project. Implementation details for translation invariant MPO generator.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+
+#include <assert.h>
+
+#ifdef Release
+  #define NDEBUG
+#endif
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+template <typename TenType>
+void MpoFree(std::vector<TenType *> &mpo) {
+  std::unordered_set<TenType *> pmpo_tens(mpo.begin(), mpo.end());
+  for (auto pmpo_ten : pmpo_tens) { delete pmpo_ten; }
+}
+
+
+// The first site i0 of the cell of cell sites which repeats right after it in
+// the bulk of the MPO, -1 if there is none.
+template <typename TenType>
+long FindRepeatedMpoCell(const std::vector<TenType *> &mpo, const long cell) {
+  long N = mpo.size();
+  long run = 0;
+  // The head and the tail tensors have different legs.
+  for (long i = 1; i + cell < N-1; ++i) {
+    if (*mpo[i] == *mpo[i+cell]) {
+      ++run;
+      if (run == cell) { return i - cell + 1; }
+    } else {
+      run = 0;
+    }
+  }
+  return -1;
+}
+
+
+template <typename TenElemType>
+TransInvMPOGenerator<TenElemType>::TransInvMPOGenerator(
+    const long cell, const Index &pb, const QN &zero_div, const long threads) :
+    cell_(cell),
+    pb_out_(pb),
+    zero_div_(zero_div),
+    threads_(threads) {
+  assert(cell_ > 0);
+  id_op_ = GQTensorT({InverseIndex(pb_out_), pb_out_});
+  for (long i = 0; i < pb_out_.dim; ++i) { id_op_({i, i}) = 1; }
+}
+
+
+template <typename TenElemType>
+void TransInvMPOGenerator<TenElemType>::AddTerm(
+    const TenElemType coef,
+    const GQTensorVec &phys_ops,
+    const std::vector<long> &idxs,
+    const GQTensorVec &inst_ops) {
+  assert(phys_ops.size() == idxs.size());
+  assert(idxs.front() >= 0 && idxs.front() < cell_);
+  terms_.push_back({coef, phys_ops, idxs, inst_ops});
+}
+
+
+template <typename TenElemType>
+void TransInvMPOGenerator<TenElemType>::AddTerm(
+    const TenElemType coef,
+    const GQTensorVec &phys_ops,
+    const std::vector<long> &idxs,
+    const GQTensorT &inst_op) {
+  GQTensorT instop = inst_op;
+  if (instop == kNullOperator<TenElemType>) { instop = id_op_; }
+  auto phys_ops_num = phys_ops.size();
+  assert(phys_ops_num > 0);
+  GQTensorVec inst_ops(phys_ops_num-1, instop);
+
+  AddTerm(coef, phys_ops, idxs, inst_ops);
+}
+
+
+template <typename TenElemType>
+void TransInvMPOGenerator<TenElemType>::AddTerm(
+    const TenElemType coef,
+    const GQTensorT &phys_op,
+    const long idx) {
+  AddTerm(
+      coef,
+      GQTensorVec({phys_op}),
+      std::vector<long>({idx}),
+      GQTensorVec({}));
+}
+
+
+// The short chains have the length of N modulo the cell, thus their right
+// boundary is the one of the chain. The chain gets longer until a cell repeats
+// in its bulk, the MPO of N sites is generated directly if none repeats in the
+// chains shorter than N.
+template <typename TenElemType>
+typename TransInvMPOGenerator<TenElemType>::PGQTensorVec
+TransInvMPOGenerator<TenElemType>::Gen(const long N) {
+  long range = cell_;
+  for (auto &term : terms_) { range = std::max(range, term.idxs.back() + 1); }
+  long range_cells = (range + cell_ - 1) / cell_;
+  for (long cells = 2 * range_cells + 4; ; cells *= 2) {
+    long n = cells * cell_ + N % cell_;
+    if (n >= N) { break; }
+    auto mpo = GenChain_(n);
+    auto i0 = FindRepeatedMpoCell(mpo, cell_);
+    if (i0 == -1) {
+      MpoFree(mpo);
+      continue;
+    }
+
+    // The chain is P + B + B + S with the repeated cell B, the MPO of N sites
+    // is P + B + ... + B + S.
+    PGQTensorVec tmpo(mpo.begin(), mpo.begin() + i0);
+    long bulk_cells = (N - n) / cell_ + 2;
+    for (long k = 0; k < bulk_cells; ++k) {
+      tmpo.insert(tmpo.end(), mpo.begin() + i0, mpo.begin() + i0 + cell_);
+    }
+    tmpo.insert(tmpo.end(), mpo.begin() + i0 + 2*cell_, mpo.end());
+    for (long i = i0 + cell_; i < i0 + 2*cell_; ++i) { delete mpo[i]; }
+    std::cout << "Translation invariant MPO of " << N << " sites from "
+              << n << " sites" << std::endl;
+    return tmpo;
+  }
+  return GenChain_(N);
+}
+
+
+template <typename TenElemType>
+typename TransInvMPOGenerator<TenElemType>::PGQTensorVec
+TransInvMPOGenerator<TenElemType>::GenChain_(const long n) {
+  MPOGenerator<TenElemType> mpo_generator(n, pb_out_, zero_div_, threads_);
+  for (long orig = 0; orig < n; orig += cell_) {
+    for (auto &term : terms_) {
+      if (orig + term.idxs.back() >= n) { continue; }
+      std::vector<long> idxs;
+      for (auto idx : term.idxs) { idxs.push_back(orig + idx); }
+      mpo_generator.AddTerm(term.coef, term.phys_ops, idxs, term.inst_ops);
+    }
+  }
+  return mpo_generator.Gen();
+}
+} /* gqmps2 */
@@ -0,0 +1,257 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-20 14:10
+*
+* Description: GraceQ/MPS2 project. Implementation details for multi-target two-site algorithm.
+*/
+
+/**
+The lowest Targets eigenstates share one MPS whose bases are optimized for the
+weighted mixture of them (state averaging). Each update finds the targets by
+the block Lanczos solver on the same effective Hamiltonian, then truncates the
+stacked targets by one SVD. The target a is represented by the shared MPS with
+its own center tensor, which is carried along the sweep. After a sweep the
+centers sit on the site 0, the one of the lowest target is in the MPS.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+
+#include <assert.h>
+
+#ifdef Release
+  #define NDEBUG
+#endif
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Weights of the targets normalized to one, equal weights if none is given.
+inline std::vector<double> MultiTargetWeights(
+    const SweepParams &sweep_params) {
+  auto weights = sweep_params.TargetWeights;
+  if (weights.empty()) { weights.assign(sweep_params.Targets, 1.0); }
+  if (sweep_params.Targets < 1 ||
+      long(weights.size()) != sweep_params.Targets) {
+    std::cout << "Invalid targets " << sweep_params.Targets << " with "
+              << weights.size() << " weights." << std::endl;
+    exit(1);
+  }
+  auto tot_weight = std::accumulate(weights.begin(), weights.end(), 0.0);
+  for (auto &weight : weights) { weight /= tot_weight; }
+  return weights;
+}
+
+
+template <typename TenType>
+std::vector<double> MultiTargetTwoSiteUpdate(
+    const long i,
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params, const char dir,
+    BlockManager<TenType> &blk_mgr, UpdateArena &update_arena,
+    std::vector<TenType *> &excited_cents, double &trunc_err) {
+  Timer update_timer("update");
+  update_timer.Restart();
+
+  long N = mps.size();
+  if (dir != 'r' && dir != 'l') {
+    std::cout << "dir must be 'r' or 'l', but " << dir << std::endl;
+    exit(1);
+  }
+  auto lsite_idx = (dir == 'r') ? i : i-1;
+  auto rsite_idx = lsite_idx + 1;
+  auto lblock_len = lsite_idx;
+  auto rblock_len = N - rsite_idx - 1;
+  std::string where = "cent";
+  long svd_ldims = 2, svd_rdims = 2;
+  std::vector<std::vector<long>> init_state_ctrct_axes = {{2}, {0}};
+  if (lsite_idx == 0) {
+    where = "lend";
+    svd_ldims = 1;
+    init_state_ctrct_axes = {{1}, {0}};
+  } else if (rsite_idx == N-1) {
+    where = "rend";
+    svd_rdims = 1;
+  }
+
+  auto lblock = blk_mgr.Acquire('l', lblock_len);
+  auto rblock = blk_mgr.Acquire('r', rblock_len);
+  std::vector<TenType *> eff_ham = {
+      lblock, mpo[lsite_idx], mpo[rsite_idx], rblock};
+
+  // The center of each target is on the left site for the right moving
+  // updates and on the right one for the left moving updates. The missing
+  // ones start from random states.
+  std::vector<TenType *> init_states = {
+      Contract(*mps[lsite_idx], *mps[rsite_idx], init_state_ctrct_axes)};
+  for (auto &pcent : excited_cents) {
+    TenType *init_state;
+    if (pcent == nullptr) {
+      init_state = new TenType(init_states[0]->indexes);
+      init_state->Random(Div(*init_states[0]));
+    } else if (dir == 'r') {
+      init_state = Contract(*pcent, *mps[rsite_idx], init_state_ctrct_axes);
+    } else {
+      init_state = Contract(*mps[lsite_idx], *pcent, init_state_ctrct_axes);
+    }
+    delete pcent;
+    pcent = nullptr;
+    init_states.push_back(init_state);
+  }
+
+  Timer lancz_timer("Lancz");
+  lancz_timer.Restart();
+  auto lancz_res = BlockLanczosSolver(
+                       eff_ham, init_states,
+                       sweep_params.LanczParams,
+                       where, &update_arena);
+  auto lancz_elapsed_time = lancz_timer.Elapsed();
+
+  // The left bases of the targets side by side for the right moving updates,
+  // the right bases one over another for the left moving updates.
+  std::vector<const TenType *> targets(
+      lancz_res.vecs.begin(), lancz_res.vecs.end());
+  auto svd_res = StackedTruncatedSvd(
+      targets, MultiTargetWeights(sweep_params), (dir == 'r') ? 'c' : 'r',
+      svd_ldims, svd_rdims,
+      Div(*mps[lsite_idx]), Div(*mps[rsite_idx]),
+      sweep_params.Cutoff, sweep_params.Dmin, sweep_params.Dmax,
+      sweep_params.SvdMethod,
+      sweep_params.SvdOversampling, sweep_params.SvdPowerIters,
+      sweep_params.SvdThreads);
+  auto ee = MeasureEE(svd_res.s, svd_res.D);
+  delete svd_res.s;
+
+  // Project the targets to the new bases.
+  std::vector<long> lstate_axes(svd_ldims), rstate_axes(svd_rdims);
+  std::iota(lstate_axes.begin(), lstate_axes.end(), 0);
+  std::iota(rstate_axes.begin(), rstate_axes.end(), svd_ldims);
+  std::vector<long> v_axes(svd_rdims);
+  std::iota(v_axes.begin(), v_axes.end(), 1);
+  std::vector<TenType *> cents;
+  for (auto pvec : lancz_res.vecs) {
+    if (dir == 'r') {
+      cents.push_back(
+          Contract(Dag(*svd_res.u), *pvec, {lstate_axes, lstate_axes}));
+    } else {
+      cents.push_back(
+          Contract(*pvec, Dag(*svd_res.v), {rstate_axes, v_axes}));
+    }
+    delete pvec;
+  }
+  std::copy(cents.begin() + 1, cents.end(), excited_cents.begin());
+
+  // Update MPS sites and blocks.
+  delete mps[lsite_idx];
+  delete mps[rsite_idx];
+  if (dir == 'r') {
+    mps[lsite_idx] = svd_res.u;
+    mps[rsite_idx] = cents[0];
+    if (i != N-2) {
+      auto new_lblock = GrowLBlock(*eff_ham[0], *mps[i], *mpo[i], i);
+      auto new_lblock_hash = blk_mgr.GrowHash('l', i, *mps[i]);
+      blk_mgr.Put('l', i+1, new_lblock, new_lblock_hash);
+    }
+    blk_mgr.Drop('r', rblock_len);
+  } else {
+    mps[lsite_idx] = cents[0];
+    mps[rsite_idx] = svd_res.v;
+    if (i != 1) {
+      auto new_rblock = GrowRBlock(*eff_ham[3], *mps[i], *mpo[i], N-i-1);
+      auto new_rblock_hash = blk_mgr.GrowHash('r', N-i-1, *mps[i]);
+      blk_mgr.Put('r', N-i, new_rblock, new_rblock_hash);
+    }
+    blk_mgr.Drop('l', lblock_len);
+  }
+  blk_mgr.ArrangeAfter(i, dir);
+  update_arena.Reset();
+
+  auto update_elapsed_time = update_timer.Elapsed();
+  std::ostringstream line;
+  line << "Site " << std::setw(4) << i << " E =";
+  for (auto eng : lancz_res.engs) {
+    line << " " << std::setw(20)
+         << std::setprecision(kLanczEnergyOutputPrecision) << std::fixed
+         << eng;
+  }
+  line << " TruncErr = " << std::setprecision(2) << std::scientific
+       << svd_res.trunc_err << std::fixed
+       << " D = " << std::setw(5) << svd_res.D
+       << " Iter = " << std::setw(3) << lancz_res.iters
+       << " LanczT = " << std::setw(8) << lancz_elapsed_time
+       << " TotT = " << std::setw(8) << update_elapsed_time
+       << " S = " << std::setw(10) << std::setprecision(7) << ee
+       << std::scientific << "\n";
+  std::cout << line.str() << std::flush;
+  trunc_err = svd_res.trunc_err;
+  return lancz_res.engs;
+}
+
+
+// Multi-target two-site algorithm. The excited_cents are the centers on the
+// site 0 of the targets above the lowest one, an empty vector for random
+// initial targets. Returns the energies of the targets in ascending order.
+template <typename TenType>
+std::vector<double> MultiTargetTwoSiteAlgorithm(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params, std::vector<TenType *> &excited_cents) {
+  assert(mps.size() == mpo.size());
+  MultiTargetWeights(sweep_params);
+  if (excited_cents.empty()) {
+    excited_cents.assign(sweep_params.Targets - 1, nullptr);
+  } else if (long(excited_cents.size()) != sweep_params.Targets - 1) {
+    std::cout << "Need " << sweep_params.Targets - 1 << " excited centers, "
+              << "but " << excited_cents.size() << " are given." << std::endl;
+    exit(1);
+  }
+  if (sweep_params.FileIO && !IsPathExist(kRuntimeTempPath)) {
+    CreatPath(kRuntimeTempPath);
+  }
+
+  long N = mps.size();
+  BlockManager<TenType> blk_mgr(mpo, sweep_params);
+  UpdateArena update_arena;
+  SweepConvergence convergence(sweep_params);
+  InitBlocks(mps, mpo, blk_mgr, 0, 'r');
+
+  std::cout << "\n";
+  std::vector<double> energies(sweep_params.Targets, 0.0);
+  Timer sweep_timer("sweep");
+  for (long sweep = 0; sweep < sweep_params.Sweeps; ++sweep) {
+    std::cout << "sweep " << sweep << std::endl;
+    auto params = SweepParamsOfSweep(sweep_params, sweep);
+    if (!sweep_params.Schedule.empty()) { PrintSweepStage(params); }
+    sweep_timer.Restart();
+    double max_trunc_err = 0.0;
+    SweepPosition pos = {sweep, 0, 'r'};
+    while (pos.sweep == sweep) {
+      double trunc_err;
+      energies = MultiTargetTwoSiteUpdate(
+                     pos.site, mps, mpo, params, pos.dir,
+                     blk_mgr, update_arena, excited_cents, trunc_err);
+      max_trunc_err = std::max(max_trunc_err, trunc_err);
+      pos = NextSweepPosition(pos, N);
+    }
+    sweep_timer.PrintElapsed();
+    // The highest target converges the slowest.
+    if (convergence.Check(sweep, energies.back(), max_trunc_err)) {
+      std::cout << "converged after sweep " << sweep << "\n" << std::endl;
+      break;
+    }
+    std::cout << "\n";
+  }
+  blk_mgr.Flush();
+  return energies;
+}
+} /* gqmps2 */
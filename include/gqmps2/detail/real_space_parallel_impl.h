@@ -0,0 +1,413 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-19 10:30
+*
+* Description: GraceQ/MPS2 project. Implementation details for real-space parallel two-site algorithm.
+*/
+
+/**
+The chain is split into segments [bounds[k], bounds[k+1]). Each segment is
+swept by its own thread with the two-site update, the neighbouring segments
+sweep in the opposite directions thus they meet on every other boundary. The
+MPS is kept in the form
+
+  psi = M[0] ... M[b-1] Lambda_b^-1 M[b] ... M[N-1]
+
+with the inverse bond values Lambda_b^-1 on every boundary b. The two segments
+which meet on a boundary are stitched by a two-site update of the sites b-1
+and b from M[b-1] Lambda_b^-1 M[b], it gives the new bond values.
+
+Reference: E. M. Stoudenmire and S. R. White, Phys. Rev. B 87, 155137 (2013).
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <vector>
+#include <future>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <limits>
+
+#include <assert.h>
+
+#include "mkl.h"
+
+#ifdef Release
+  #define NDEBUG
+#endif
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// The bond values under it are dropped by the inverse.
+const double kRealSpaceInvBondValCutoff = 1.0E-12;
+
+
+// Bounds of the segments, each segment has at least two sites.
+inline std::vector<long> RealSpaceSegmentBounds(
+    const long N, const long segments) {
+  std::vector<long> bounds;
+  for (long k = 0; k <= segments; ++k) { bounds.push_back(k * N / segments); }
+  return bounds;
+}
+
+
+inline DGQTensor *InverseBondValues(const DGQTensor &s) {
+  auto pinv = new DGQTensor(s);
+  for (auto pblk : pinv->blocks()) {
+    auto dim = pblk->shape[0];
+    auto data = pblk->data();
+    for (long k = 0; k < dim; ++k) {
+      auto &val = data[k*dim + k];
+      val = (val > kRealSpaceInvBondValCutoff) ? 1.0 / val : 0.0;
+    }
+  }
+  return pinv;
+}
+
+
+// Contract the right bond of the MPS tensor with the given axis of the bond
+// matrix.
+template <typename TenType, typename MatType>
+TenType *ContractRightBond(
+    const TenType &ten, const MatType &mat, const long mat_axis = 0) {
+  long bond_axis = ten.indexes.size() - 1;
+  return Contract(ten, mat, {{bond_axis}, {mat_axis}});
+}
+
+
+// Bring the MPS from the right-canonical form with the center on the first
+// site to the segment form. The even segments get the center on their left
+// ends and the odd ones on their right ends, thus the first half sweep moves
+// the even segments to the right. The blocks which the first half sweep
+// needs are built.
+template <typename TenType>
+void PrepareRealSpaceSegments(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    BlockManager<TenType> &blk_mgr, const std::vector<long> &bounds,
+    std::vector<DGQTensor *> &bond_vals) {
+  long N = mps.size();
+  long segments = bounds.size() - 1;
+
+  // Left-canonical copy by untruncated SVDs. It gives the left blocks and the
+  // bond values of the boundaries. The bond matrices rotate the right bases
+  // of the right-canonical tensors to the bases of the bond values.
+  std::vector<TenType *> amps(N, nullptr);
+  std::vector<TenType *> bond_mats(N, nullptr);
+  auto is_bound = [&bounds](const long b) {
+                    return std::find(bounds.begin()+1, bounds.end()-1, b) !=
+                           bounds.end()-1;
+                  };
+  auto pcent = new TenType(*mps[0]);
+  for (long i = 0; i < N-1; ++i) {
+    auto zero_div = Div(*mps[i]) - Div(*mps[i]);
+    auto svd_res = Svd(*pcent, (i == 0) ? 1 : 2, 1, Div(*mps[i]), zero_div);
+    delete pcent;
+    amps[i] = svd_res.u;
+    blk_mgr.Put(
+        'l', i+1,
+        GrowLBlock(*blk_mgr.Acquire('l', i), *amps[i], *mpo[i], i));
+    auto psv = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+    pcent = Contract(*psv, *mps[i+1], {{1}, {0}});
+    delete psv;
+    if (is_bound(i+1)) {
+      bond_vals[i+1] = svd_res.s;
+      bond_mats[i+1] = svd_res.v;
+    } else {
+      delete svd_res.s;
+      delete svd_res.v;
+    }
+  }
+  amps[N-1] = pcent;
+
+  // Segment form. bmps is the right-canonical form with the bases of the bond
+  // values on the boundaries, which the right blocks are built from.
+  std::vector<TenType *> smps(N), bmps(N);
+  for (long k = 0; k < segments; ++k) {
+    auto s = bounds[k], e = bounds[k+1];
+    for (long j = s; j < e; ++j) {
+      TenType *pb;
+      if (j == s && s > 0) {
+        pb = Contract(*bond_mats[s], *mps[s], {{1}, {0}});
+      } else {
+        pb = new TenType(*mps[j]);
+      }
+      if (j == e-1 && e < N) {
+        auto pbw = ContractRightBond(*pb, Dag(*bond_mats[e]), 1);
+        delete pb;
+        pb = pbw;
+      }
+      bmps[j] = pb;
+      if (k % 2 == 0) {
+        smps[j] = (j == s && s > 0) ?
+                  Contract(*bond_vals[s], *pb, {{1}, {0}}) :
+                  new TenType(*pb);
+      } else {
+        smps[j] = (j == e-1 && e < N) ?
+                  ContractRightBond(*amps[j], *bond_vals[e]) :
+                  new TenType(*amps[j]);
+      }
+    }
+  }
+  for (long len = 1; len <= N-2; ++len) {
+    blk_mgr.Put(
+        'r', len,
+        GrowRBlock(
+            *blk_mgr.Acquire('r', len-1), *bmps[N-len], *mpo[N-len], len-1));
+  }
+
+  for (long j = 0; j < N; ++j) {
+    delete mps[j];
+    mps[j] = smps[j];
+    delete amps[j];
+    delete bmps[j];
+    delete bond_mats[j];
+  }
+}
+
+
+// Absorb the inverse bond values and bring the MPS back to the
+// right-canonical form with the center on the first site.
+template <typename TenType>
+void MergeRealSpaceSegments(
+    std::vector<TenType *> &mps, const std::vector<long> &bounds,
+    std::vector<DGQTensor *> &bond_vals) {
+  long N = mps.size();
+  for (size_t k = 1; k < bounds.size()-1; ++k) {
+    auto b = bounds[k];
+    auto pinv = InverseBondValues(*bond_vals[b]);
+    auto pten = ContractRightBond(*mps[b-1], *pinv);
+    delete mps[b-1];
+    mps[b-1] = pten;
+    delete pinv;
+    delete bond_vals[b];
+    bond_vals[b] = nullptr;
+  }
+  for (long i = N-1; i > 0; --i) {
+    auto zero_div = Div(*mps[i]) - Div(*mps[i]);
+    auto svd_res = Svd(
+                       *mps[i], 1, (i == N-1) ? 1 : 2,
+                       zero_div, Div(*mps[i]));
+    delete mps[i];
+    mps[i] = svd_res.v;
+    auto pus = Contract(*svd_res.u, *svd_res.s, {{1}, {0}});
+    delete svd_res.u;
+    delete svd_res.s;
+    auto pprev = ContractRightBond(*mps[i-1], *pus);
+    delete pus;
+    delete mps[i-1];
+    mps[i-1] = pprev;
+  }
+}
+
+
+// Sweep the segment [s, e) from one end to the other.
+template <typename TenType>
+double RealSpaceSegmentSweep(
+    const long s, const long e, const char dir,
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params,
+    BlockManager<TenType> &blk_mgr, UpdateArena &update_arena,
+    double &max_trunc_err) {
+  double e0 = 0.0;
+  double trunc_err;
+  max_trunc_err = 0.0;
+  if (dir == 'r') {
+    for (long i = s; i < e-1; ++i) {
+      e0 = TwoSiteUpdate(
+               i, mps, mpo, sweep_params, 'r', blk_mgr, update_arena,
+               trunc_err);
+      max_trunc_err = std::max(max_trunc_err, trunc_err);
+    }
+  } else {
+    for (long i = e-1; i > s; --i) {
+      e0 = TwoSiteUpdate(
+               i, mps, mpo, sweep_params, 'l', blk_mgr, update_arena,
+               trunc_err);
+      max_trunc_err = std::max(max_trunc_err, trunc_err);
+    }
+  }
+  return e0;
+}
+
+
+// Stitch the two segments which meet on the boundary b. Afterwards
+// M[b-1] = A Lambda_b and M[b] = Lambda_b B, and both the segments have the
+// blocks to turn around.
+template <typename TenType>
+double RealSpaceBoundaryUpdate(
+    const long b,
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params,
+    BlockManager<TenType> &blk_mgr, UpdateArena &update_arena,
+    std::vector<DGQTensor *> &bond_vals, double &trunc_err) {
+  auto pinv = InverseBondValues(*bond_vals[b]);
+  auto pten = ContractRightBond(*mps[b-1], *pinv);
+  delete mps[b-1];
+  mps[b-1] = pten;
+  delete pinv;
+
+  // The update drops the left block which the right segment grows from.
+  auto plblock = new TenType(*blk_mgr.Acquire('l', b-1));
+  DGQTensor *pbond_s;
+  auto e0 = TwoSiteUpdate(
+                b, mps, mpo, sweep_params, 'l', blk_mgr, update_arena,
+                trunc_err, &pbond_s);
+
+  pinv = InverseBondValues(*pbond_s);
+  auto pu = ContractRightBond(*mps[b-1], *pinv);
+  blk_mgr.Put('l', b, GrowLBlock(*plblock, *pu, *mpo[b-1], b-1));
+  pten = Contract(*pbond_s, *mps[b], {{1}, {0}});
+  delete mps[b];
+  mps[b] = pten;
+  delete bond_vals[b];
+  bond_vals[b] = pbond_s;
+  delete pinv;
+  delete pu;
+  delete plblock;
+  return e0;
+}
+
+
+// One sweep: the segments go to one end concurrently and the meeting ones are
+// stitched, then all the segments turn around.
+template <typename TenType>
+double RealSpaceParallelSweep(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params, BlockManager<TenType> &blk_mgr,
+    std::vector<UpdateArena> &update_arenas,
+    const std::vector<long> &bounds, std::vector<DGQTensor *> &bond_vals,
+    double &max_trunc_err) {
+  long segments = bounds.size() - 1;
+
+  // The threads are shared by the segments. The thread pools are shared by
+  // all the callers and run one job at a time, thus the matrix-vector
+  // multiplications and the sector decompositions of a segment run serially
+  // and each segment thread gets its share of the MKL threads instead.
+  long threads = std::max(
+                     1L, long(std::thread::hardware_concurrency()) / segments);
+  SweepParams params(sweep_params);
+  params.LanczParams.matvec_threads = 1;
+  params.SvdThreads = 1;
+  auto run = [threads](std::function<double(void)> task) {
+               return std::async(
+                          std::launch::async,
+                          [threads, task]() {
+                            mkl_set_num_threads_local(threads);
+                            return task();
+                          });
+             };
+
+  // The energy is the lowest one of the updates in the last phase, the
+  // segments are updated at the same time thus no single update is the last.
+  double e0 = 0.0;
+  max_trunc_err = 0.0;
+  std::vector<double> trunc_errs(segments);
+  for (long phase = 0; phase < 2; ++phase) {
+    e0 = std::numeric_limits<double>::max();
+    std::vector<std::future<double>> tasks;
+    for (long k = 0; k < segments; ++k) {
+      auto dir = ((k + phase) % 2 == 0) ? 'r' : 'l';
+      tasks.push_back(run([&, k, dir]() {
+        return RealSpaceSegmentSweep(
+                   bounds[k], bounds[k+1], dir, mps, mpo, params, blk_mgr,
+                   update_arenas[k], trunc_errs[k]);
+      }));
+    }
+    for (auto &task : tasks) { e0 = std::min(e0, task.get()); }
+    max_trunc_err = std::max(
+                        max_trunc_err,
+                        *std::max_element(trunc_errs.begin(), trunc_errs.end()));
+
+    tasks.clear();
+    std::fill(trunc_errs.begin(), trunc_errs.end(), 0.0);
+    for (long k = 0; k < segments-1; ++k) {
+      if ((k + phase) % 2 != 0) { continue; }
+      tasks.push_back(run([&, k]() {
+        return RealSpaceBoundaryUpdate(
+                   bounds[k+1], mps, mpo, params, blk_mgr,
+                   update_arenas[k], bond_vals, trunc_errs[k]);
+      }));
+    }
+    for (auto &task : tasks) { e0 = std::min(e0, task.get()); }
+    max_trunc_err = std::max(
+                        max_trunc_err,
+                        *std::max_element(trunc_errs.begin(), trunc_errs.end()));
+  }
+  return e0;
+}
+
+
+template <typename TenType>
+double RealSpaceParallelTwoSiteAlgorithm(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params) {
+  assert(mps.size() == mpo.size());
+  if (sweep_params.FileIO) {
+    std::cout << "The real-space parallel sweeps keep the blocks in memory, "
+              << "FileIO must be false." << std::endl;
+    exit(1);
+  }
+  long N = mps.size();
+  auto bounds = RealSpaceSegmentBounds(
+                    N,
+                    std::max(
+                        1L, std::min(sweep_params.RealSpaceSegments, N/2)));
+  long segments = bounds.size() - 1;
+  std::cout << "real-space parallel sweeps with " << segments
+            << " segments" << std::endl;
+
+  BlockManager<TenType> blk_mgr(mpo, sweep_params);
+  SweepCheckpoint<TenType> ckpt(N, sweep_params);
+  std::vector<UpdateArena> update_arenas(segments);
+  SweepConvergence convergence(sweep_params);
+  SweepPosition pos = {0, 0, 'r'};
+  std::vector<double> energies;
+  std::vector<DGQTensor *> bond_vals(N, nullptr);
+  bool segmented = false;
+  InitBlocks(mps, mpo, blk_mgr, pos.site, pos.dir);
+
+  std::cout << "\n";
+  double e0 = 0.0;
+  Timer sweep_timer("sweep");
+  for (long sweep = 0; sweep < sweep_params.Sweeps; ++sweep) {
+    std::cout << "sweep " << sweep << std::endl;
+    auto params = SweepParamsOfSweep(sweep_params, sweep);
+    if (!sweep_params.Schedule.empty()) { PrintSweepStage(params); }
+    sweep_timer.Restart();
+    double max_trunc_err;
+    if (!segmented) {
+      // The serial sweep gives the canonical form which the segments start
+      // from.
+      e0 = TwoSiteSweep(
+               mps, mpo, params, blk_mgr, ckpt, update_arenas[0],
+               pos, energies, max_trunc_err);
+      if (ckpt.Interrupted()) {
+        std::cout << "interrupted at sweep " << pos.sweep
+                  << " site " << pos.site
+                  << " direction " << pos.dir << "\n" << std::endl;
+        return e0;
+      }
+      PrepareRealSpaceSegments(mps, mpo, blk_mgr, bounds, bond_vals);
+      segmented = true;
+    } else {
+      e0 = RealSpaceParallelSweep(
+               mps, mpo, params, blk_mgr, update_arenas,
+               bounds, bond_vals, max_trunc_err);
+    }
+    sweep_timer.PrintElapsed();
+    if (convergence.Check(sweep, e0, max_trunc_err)) {
+      std::cout << "converged after sweep " << sweep << "\n" << std::endl;
+      break;
+    }
+    std::cout << "\n";
+  }
+  if (segmented) { MergeRealSpaceSegments(mps, bounds, bond_vals); }
+  return e0;
+}
+} /* gqmps2 */
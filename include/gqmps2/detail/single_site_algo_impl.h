@@ -0,0 +1,406 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 10:15
+*
+* Description: GraceQ/MPS2 project. Implementation details for single-site algorithm with subspace expansion.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
+#include <assert.h>
+
+#ifdef Release
+  #define NDEBUG
+#endif
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// Helpers
+// Embeddings of the bond (bond, new_bond) and of the fusion of the bond and
+// the MPO bond (bond, mpo_bond, new_bond) into the expanded bond, which is the
+// direct sum of them. The sectors of the expanded bond with the same quantum
+// number are merged, the part of the bond comes first. The legs of the bond
+// and the MPO bond are inversed thus they can be contracted with the state.
+template <typename TenType>
+void GenExpansionEmbeddings(
+    const Index &bond, const Index &mpo_bond,
+    TenType * &pbond_embed, TenType * &pfused_embed) {
+  struct Part {
+    long qnsct;     // Sector of the expanded bond.
+    long offset;    // Offset in the sector.
+  };
+  std::vector<QNSector> new_qnscts;
+  auto add_part = [&new_qnscts](const QN &qn, const long dim) -> Part {
+    for (size_t i = 0; i < new_qnscts.size(); ++i) {
+      if (new_qnscts[i].qn == qn) {
+        Part part = {long(i), new_qnscts[i].dim};
+        new_qnscts[i].dim += dim;
+        return part;
+      }
+    }
+    new_qnscts.push_back(QNSector(qn, dim));
+    return {long(new_qnscts.size()) - 1, 0};
+  };
+  std::vector<Part> bond_parts;
+  for (auto &qnsct : bond.qnscts) {
+    bond_parts.push_back(add_part(qnsct.qn, qnsct.dim));
+  }
+  std::vector<std::vector<Part>> fused_parts(bond.qnscts.size());
+  for (size_t j = 0; j < bond.qnscts.size(); ++j) {
+    for (auto &mpo_qnsct : mpo_bond.qnscts) {
+      auto &qn = bond.qnscts[j].qn;
+      auto fused_qn = (mpo_bond.dir == bond.dir) ?
+                      qn + mpo_qnsct.qn : qn - mpo_qnsct.qn;
+      fused_parts[j].push_back(
+          add_part(fused_qn, bond.qnscts[j].dim * mpo_qnsct.dim));
+    }
+  }
+  std::vector<long> new_offsets(new_qnscts.size(), 0);
+  for (size_t i = 1; i < new_qnscts.size(); ++i) {
+    new_offsets[i] = new_offsets[i-1] + new_qnscts[i-1].dim;
+  }
+  auto new_bond = Index(new_qnscts, bond.dir);
+
+  pbond_embed = new TenType({InverseIndex(bond), new_bond});
+  pfused_embed = new TenType(
+                     {InverseIndex(bond), InverseIndex(mpo_bond), new_bond});
+  long bond_offset = 0;
+  for (size_t j = 0; j < bond.qnscts.size(); ++j) {
+    auto bond_dim = bond.qnscts[j].dim;
+    auto new_offset = new_offsets[bond_parts[j].qnsct] + bond_parts[j].offset;
+    for (long k = 0; k < bond_dim; ++k) {
+      (*pbond_embed)({bond_offset + k, new_offset + k}) = 1.0;
+    }
+    long mpo_offset = 0;
+    for (size_t t = 0; t < mpo_bond.qnscts.size(); ++t) {
+      auto mpo_dim = mpo_bond.qnscts[t].dim;
+      auto &part = fused_parts[j][t];
+      new_offset = new_offsets[part.qnsct] + part.offset;
+      for (long k = 0; k < bond_dim; ++k) {
+        for (long w = 0; w < mpo_dim; ++w) {
+          (*pfused_embed)({
+              bond_offset + k, mpo_offset + w,
+              new_offset + k*mpo_dim + w}) = 1.0;
+        }
+      }
+      mpo_offset += mpo_dim;
+    }
+    bond_offset += bond_dim;
+  }
+}
+
+
+// Single-site algorithm
+template <typename TenType>
+double SingleSiteAlgorithm(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params) {
+  assert(mps.size() == mpo.size());
+  if ( sweep_params.FileIO && !IsPathExist(kRuntimeTempPath)) {
+    CreatPath(kRuntimeTempPath);
+  }
+
+  BlockManager<TenType> blk_mgr(mpo, sweep_params, 1);
+  SweepCheckpoint<TenType> ckpt(mps.size(), sweep_params);
+  UpdateArena update_arena;
+  SweepConvergence convergence(sweep_params);
+  SweepPosition pos = {0, 0, 'r'};
+  std::vector<double> energies;
+  if (sweep_params.Workflow == kTwoSiteAlgoWorkflowContinue) {
+    if (ckpt.Load(mps, pos, energies)) {
+      std::cout << "resume from sweep " << pos.sweep
+                << " site " << pos.site
+                << " direction " << pos.dir << std::endl;
+    }
+  } else {
+    ckpt.Clear();
+  }
+  InitBlocks(mps, mpo, blk_mgr, pos.site, pos.dir);
+
+  std::cout << "\n";
+  double e0 = energies.empty() ? 0.0 : energies.back();
+  Timer sweep_timer("sweep");
+  for (long sweep = pos.sweep; sweep < sweep_params.Sweeps; ++sweep) {
+    std::cout << "sweep " << sweep << std::endl;
+    auto params = SweepParamsOfSweep(sweep_params, sweep);
+    if (!sweep_params.Schedule.empty()) { PrintSweepStage(params); }
+    if (pos.site != 0 || pos.dir != 'r') { convergence.Skip(); }
+    sweep_timer.Restart();
+    double max_trunc_err;
+    e0 = SingleSiteSweep(
+             mps, mpo, params, blk_mgr, ckpt, update_arena,
+             pos, energies, max_trunc_err);
+    sweep_timer.PrintElapsed();
+    if (ckpt.Interrupted()) {
+      std::cout << "interrupted at sweep " << pos.sweep
+                << " site " << pos.site
+                << " direction " << pos.dir << "\n" << std::endl;
+      return e0;
+    }
+    PrintUpdateArenaStats(update_arena.Stats());
+    if (sweep_params.FileIO && sweep_params.BlockCodec != kBlockCodecNone) {
+      PrintBlockCodecStats(blk_mgr.CodecStats());
+    }
+    if (convergence.Check(sweep, e0, max_trunc_err)) {
+      std::cout << "converged after sweep " << sweep << "\n" << std::endl;
+      break;
+    }
+    std::cout << "\n";
+  }
+  // Keep the blocks on disk for the following runs.
+  blk_mgr.Flush();
+  ckpt.Clear();
+  return e0;
+}
+
+
+// Run the updates from pos to the end of the sweep. The single-site updates
+// visit the same positions as the two-site ones.
+template <typename TenType>
+double SingleSiteSweep(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params, BlockManager<TenType> &blk_mgr,
+    SweepCheckpoint<TenType> &ckpt, UpdateArena &update_arena,
+    SweepPosition &pos, std::vector<double> &energies,
+    double &max_trunc_err) {
+  long N = mps.size();
+  auto sweep = pos.sweep;
+  if (pos.site == 0 && pos.dir == 'r') { energies.clear(); }
+  double e0;
+  double trunc_err;
+  max_trunc_err = 0.0;
+  while (pos.sweep == sweep && !ckpt.Interrupted()) {
+    e0 = SingleSiteUpdate(
+             pos.site, mps, mpo, sweep_params, pos.dir, blk_mgr, update_arena,
+             trunc_err);
+    energies.push_back(e0);
+    max_trunc_err = std::max(max_trunc_err, trunc_err);
+    auto lsite_idx = (pos.dir == 'r') ? pos.site : pos.site-1;
+    ckpt.MarkDirty(lsite_idx);
+    ckpt.MarkDirty(lsite_idx+1);
+    pos = NextSweepPosition(pos, N);
+    if (ckpt.Tick()) {
+      blk_mgr.Flush();
+      ckpt.Write(mps, pos, energies);
+    }
+  }
+  return e0;
+}
+
+
+// Optimize the site i and move the canonical center to the next site in the
+// direction dir. The bond to the next site is expanded by the perturbation
+// ExpansionAlpha * (L W |psi>) (or (|psi> W R) for the left moving) before the
+// truncation, and the next site is padded with zeros on the expanded bond,
+// thus the bond dimension can grow and the sweeps do not get stuck.
+template <typename TenType>
+double SingleSiteUpdate(
+    const long i,
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params, const char dir,
+    BlockManager<TenType> &blk_mgr, UpdateArena &update_arena,
+    double &trunc_err) {
+  Timer update_timer("update");
+  update_timer.Restart();
+
+  long N = mps.size();
+  std::string where;
+  if (i == 0) {
+    where = "single_lend";
+  } else if (i == N-1) {
+    where = "single_rend";
+  } else {
+    where = "single_cent";
+  }
+  if ((dir == 'r' && i == N-1) || (dir == 'l' && i == 0) ||
+      (dir != 'r' && dir != 'l')) {
+    std::cout << "Invalid single-site update " << i << " " << dir << std::endl;
+    exit(1);
+  }
+  long lblock_len = i;
+  long rblock_len = N-i-1;
+  auto lblock = blk_mgr.Acquire('l', lblock_len);
+  auto rblock = blk_mgr.Acquire('r', rblock_len);
+
+  // Lanczos
+  std::vector<TenType *>eff_ham(3);
+  eff_ham[0] = lblock;
+  eff_ham[1] = mpo[i];
+  eff_ham[2] = rblock;
+  auto init_state = new TenType(*mps[i]);
+
+  Timer lancz_timer("Lancz");
+  lancz_timer.Restart();
+
+  auto lancz_res = (sweep_params.LanczParams.solver == kEigenSolverDavidson) ?
+                   DavidsonSolver(
+                       eff_ham, init_state,
+                       sweep_params.LanczParams,
+                       where, &update_arena) :
+                   LanczosSolver(
+                       eff_ham, init_state,
+                       sweep_params.LanczParams,
+                       where, &update_arena);
+
+  auto lancz_elapsed_time = lancz_timer.Elapsed();
+
+  // Subspace expansion.
+  auto nsite_idx = (dir == 'r') ? i+1 : i-1;
+  auto gs_vec = lancz_res.gs_vec;
+  auto nsite_ten = new TenType(*mps[nsite_idx]);
+  if (sweep_params.ExpansionAlpha != 0.0) {
+    TenType *pbond_embed, *pfused_embed, *pexpd_state, *ppert;
+    if (dir == 'r') {
+      long bond_leg = gs_vec->indexes.size() - 1;
+      if (where == "single_lend") {
+        ppert = Contract(*gs_vec, *mpo[i], {{0}, {0}});
+        GenExpansionEmbeddings(
+            gs_vec->indexes[bond_leg], mpo[i]->indexes[1],
+            pbond_embed, pfused_embed);
+        InplaceContract(ppert, *pfused_embed, {{0, 1}, {0, 1}});
+      } else {
+        ppert = Contract(*lblock, *gs_vec, {{0}, {0}});
+        InplaceContract(ppert, *mpo[i], {{0, 2}, {0, 1}});
+        GenExpansionEmbeddings(
+            gs_vec->indexes[bond_leg], mpo[i]->indexes[3],
+            pbond_embed, pfused_embed);
+        InplaceContract(ppert, *pfused_embed, {{1, 3}, {0, 1}});
+      }
+      pexpd_state = Contract(*gs_vec, *pbond_embed, {{bond_leg}, {0}});
+      auto temp_nsite_ten = Contract(
+                                Dag(*pbond_embed), *nsite_ten, {{0}, {0}});
+      delete nsite_ten;
+      nsite_ten = temp_nsite_ten;
+    } else {
+      if (where == "single_rend") {
+        ppert = Contract(*gs_vec, *mpo[i], {{1}, {0}});
+        GenExpansionEmbeddings(
+            gs_vec->indexes[0], mpo[i]->indexes[1],
+            pbond_embed, pfused_embed);
+        auto temp_pert = Contract(*pfused_embed, *ppert, {{0, 1}, {0, 1}});
+        delete ppert;
+        ppert = temp_pert;
+      } else {
+        ppert = Contract(*gs_vec, *rblock, {{2}, {0}});
+        InplaceContract(ppert, *mpo[i], {{1, 2}, {1, 3}});
+        GenExpansionEmbeddings(
+            gs_vec->indexes[0], mpo[i]->indexes[0],
+            pbond_embed, pfused_embed);
+        auto temp_pert = Contract(*pfused_embed, *ppert, {{0, 1}, {0, 2}});
+        delete ppert;
+        ppert = temp_pert;
+        ppert->Transpose({0, 2, 1});
+      }
+      pexpd_state = Contract(*pbond_embed, *gs_vec, {{0}, {0}});
+      long nsite_bond_leg = nsite_ten->indexes.size() - 1;
+      InplaceContract(nsite_ten, Dag(*pbond_embed), {{nsite_bond_leg}, {0}});
+    }
+    (*ppert) *= sweep_params.ExpansionAlpha;
+    (*pexpd_state) += (*ppert);
+    delete ppert;
+    delete pbond_embed;
+    delete pfused_embed;
+    delete gs_vec;
+    gs_vec = pexpd_state;
+  }
+
+  // SVD. The canonical center keeps the divergence of the site.
+  auto site_div = Div(*mps[i]);
+  auto zero_div = site_div - site_div;
+  long svd_ldims, svd_rdims;
+  if (dir == 'r') {
+    svd_ldims = gs_vec->indexes.size() - 1;
+    svd_rdims = 1;
+  } else {
+    svd_ldims = 1;
+    svd_rdims = gs_vec->indexes.size() - 1;
+  }
+  auto svd_res = SweepSvd(
+      *gs_vec,
+      svd_ldims, svd_rdims,
+      (dir == 'r') ? site_div : zero_div,
+      (dir == 'r') ? zero_div : site_div,
+      sweep_params);
+  delete gs_vec;
+  // The expanded state is not normalized.
+  svd_res.s->Normalize();
+
+  // Measure entanglement entropy.
+  auto ee = MeasureEE(svd_res.s, svd_res.D);
+
+  // Update MPS sites and blocks.
+  TenType *pcenter;
+  switch (dir) {
+    case 'r':
+      delete mps[i];
+      mps[i] = svd_res.u;
+      pcenter = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+      delete svd_res.s;
+      delete svd_res.v;
+      delete mps[nsite_idx];
+      mps[nsite_idx] = Contract(*pcenter, *nsite_ten, {{1}, {0}});
+      delete pcenter;
+      delete nsite_ten;
+
+      blk_mgr.Put(
+          'l', lblock_len+1,
+          GrowLBlock(*lblock, *mps[i], *mpo[i], lblock_len),
+          blk_mgr.GrowHash('l', lblock_len, *mps[i]));
+      blk_mgr.Drop('r', rblock_len);
+      break;
+    case 'l':
+      delete mps[i];
+      mps[i] = svd_res.v;
+      pcenter = Contract(*svd_res.u, *svd_res.s, {{1}, {0}});
+      delete svd_res.u;
+      delete svd_res.s;
+      delete mps[nsite_idx];
+      mps[nsite_idx] = Contract(
+                           *nsite_ten, *pcenter,
+                           {{long(nsite_ten->indexes.size()) - 1}, {0}});
+      delete pcenter;
+      delete nsite_ten;
+
+      blk_mgr.Put(
+          'r', rblock_len+1,
+          GrowRBlock(*rblock, *mps[i], *mpo[i], rblock_len),
+          blk_mgr.GrowHash('r', rblock_len, *mps[i]));
+      blk_mgr.Drop('l', lblock_len);
+  }
+
+  // Spill and prefetch the blocks for the next update.
+  blk_mgr.ArrangeAfter(i, dir);
+
+  // Release the temporaries of the update.
+  update_arena.Reset();
+
+  auto update_elapsed_time = update_timer.Elapsed();
+  std::cout << "Site " << std::setw(4) << i
+            << " E0 = " << std::setw(20) << std::setprecision(kLanczEnergyOutputPrecision) << std::fixed << lancz_res.gs_eng
+            << " TruncErr = " << std::setprecision(2) << std::scientific << svd_res.trunc_err << std::fixed
+            << " D = " << std::setw(5) << svd_res.D
+            << " Iter = " << std::setw(3) << lancz_res.iters
+            << " LanczT = " << std::setw(8) << lancz_elapsed_time
+            << " TotT = " << std::setw(8) << update_elapsed_time
+            << " S = " << std::setw(10) << std::setprecision(7) << ee;
+  if (!sweep_params.LanczParams.store_bases) {
+    std::cout << " Replay = " << std::setw(3) << lancz_res.replay_iters
+              << " ReplayT = " << std::setw(8) << std::setprecision(3)
+              << lancz_res.replay_time;
+  }
+  std::cout << std::scientific << std::endl;
+  trunc_err = svd_res.trunc_err;
+  return lancz_res.gs_eng;
+}
+} /* gqmps2 */
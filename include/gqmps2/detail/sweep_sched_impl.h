@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 15:40
+*
+* Description: GraceQ/MPS2 project. Implementation details for sweep schedule and convergence check.
+*/
+#include "gqmps2/gqmps2.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+
+namespace gqmps2 {
+
+
+inline std::vector<SweepStage> CaseParamsParserBasic::ParseSweepSchedule(
+    const std::string &item) {
+  std::vector<SweepStage> schedule;
+  for (auto &stage : case_params[item]) {
+    schedule.push_back(
+        SweepStage(
+            stage["Dmax"].get<long>(),
+            stage["Cutoff"].get<double>(),
+            stage["LanczErr"].get<double>(),
+            stage["MaxLanczIter"].get<long>()));
+  }
+  return schedule;
+}
+
+
+// Parameters used by the given sweep.
+inline SweepParams SweepParamsOfSweep(
+    const SweepParams &sweep_params, const long sweep) {
+  SweepParams params(sweep_params);
+  if (sweep_params.Schedule.empty()) { return params; }
+  auto stage_idx = std::min(
+                       size_t(sweep), sweep_params.Schedule.size() - 1);
+  auto &stage = sweep_params.Schedule[stage_idx];
+  params.Dmax = stage.Dmax;
+  params.Cutoff = stage.Cutoff;
+  params.LanczParams.error = stage.LanczErr;
+  params.LanczParams.max_iterations = stage.MaxLanczIter;
+  if (params.Dmin > params.Dmax) { params.Dmin = params.Dmax; }
+  return params;
+}
+
+
+inline void PrintSweepStage(const SweepParams &params) {
+  std::cout << "Dmax = " << params.Dmax
+            << " Cutoff = " << params.Cutoff
+            << " LanczErr = " << params.LanczParams.error
+            << " MaxLanczIter = " << params.LanczParams.max_iterations
+            << std::endl;
+}
+
+
+// Check of the convergence between the successive sweeps.
+class SweepConvergence {
+public:
+  SweepConvergence(const SweepParams &sweep_params) :
+      energy_tol_(sweep_params.EnergyConvTol),
+      trunc_err_tol_(sweep_params.TruncErrConvTol),
+      last_stage_sweep_(
+          sweep_params.Schedule.empty() ? 0 : sweep_params.Schedule.size()-1) {}
+
+  // Record the energy and the largest truncation error of the whole sweep-th
+  // sweep. Return true if the sweeps are converged. Only sweeps of the last
+  // stage of the schedule are compared, the earlier stages run a smaller Dmax
+  // and may stall before the final one is reached.
+  bool Check(const long sweep, const double energy, const double trunc_err) {
+    if (sweep < last_stage_sweep_) { return false; }
+    bool converged = false;
+    if (energy_tol_ > 0 && has_last_) {
+      converged = std::abs(energy - last_energy_) < energy_tol_;
+      if (trunc_err_tol_ > 0) {
+        converged = converged &&
+                    std::abs(trunc_err - last_trunc_err_) < trunc_err_tol_;
+      }
+    }
+    has_last_ = true;
+    last_energy_ = energy;
+    last_trunc_err_ = trunc_err;
+    return converged;
+  }
+
+  // The sweep is resumed from a checkpoint thus the statistics of it are
+  // incomplete.
+  void Skip(void) { has_last_ = false; }
+
+private:
+  double energy_tol_;
+  double trunc_err_tol_;
+  long last_stage_sweep_;
+  bool has_last_ = false;
+  double last_energy_ = 0.0;
+  double last_trunc_err_ = 0.0;
+};
+} /* gqmps2 */
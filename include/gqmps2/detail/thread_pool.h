@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 20:10
+*
+* Description: GraceQ/MPS2 project. Thread pool for the parallel loops of the matrix-vector multiplications.
+*/
+#ifndef GQMPS2_DETAIL_THREAD_POOL_H
+#define GQMPS2_DETAIL_THREAD_POOL_H
+
+
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+
+namespace gqmps2 {
+
+
+// Fixed number of threads which run the iterations of parallel loops. The
+// calling thread also runs iterations, thus a pool of size n has n-1 worker
+// threads. The iterations are handed out one by one, the expensive ones should
+// come first.
+class ThreadPool {
+public:
+  ThreadPool(const long size) : size_(std::max(size, 1L)) {
+    for (long i = 1; i < size_; ++i) {
+      workers_.emplace_back([this]() { Work_(); });
+    }
+  }
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  ~ThreadPool(void) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    job_cv_.notify_all();
+    for (auto &worker : workers_) { worker.join(); }
+  }
+
+  long Size(void) const { return size_; }
+
+  // Run func(i) for i in [0, n) and wait for all of them. The loops of several
+  // callers run one after another. A loop called from an iteration of a loop
+  // of the same pool runs serially on the calling thread.
+  void ParallelFor(const long n, const std::function<void(long)> &func) {
+    if (size_ == 1 || n <= 1 || RunningPool_() == this) {
+      for (long i = 0; i < n; ++i) { func(i); }
+      return;
+    }
+    std::lock_guard<std::mutex> job_lock(job_mutex_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      pfunc_ = &func;
+      n_ = n;
+      next_ = 0;
+      busy_ = workers_.size();
+      ++job_id_;
+    }
+    job_cv_.notify_all();
+    RunIters_();
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return busy_ == 0; });
+    pfunc_ = nullptr;
+  }
+
+private:
+  void Work_(void) {
+    long job_id = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        job_cv_.wait(lock, [this, job_id]() {
+                               return stop_ || job_id_ != job_id;
+                             });
+        if (stop_) { return; }
+        job_id = job_id_;
+      }
+      RunIters_();
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        --busy_;
+      }
+      done_cv_.notify_one();
+    }
+  }
+
+  void RunIters_(void) {
+    auto prev_pool = RunningPool_();
+    RunningPool_() = this;
+    for (auto i = next_++; i < n_; i = next_++) { (*pfunc_)(i); }
+    RunningPool_() = prev_pool;
+  }
+
+  // Pool whose iterations the current thread is running.
+  static ThreadPool * &RunningPool_(void) {
+    static thread_local ThreadPool *prunning_pool = nullptr;
+    return prunning_pool;
+  }
+
+  long size_;
+  std::vector<std::thread> workers_;
+  std::mutex job_mutex_;
+  std::mutex mutex_;
+  std::condition_variable job_cv_;
+  std::condition_variable done_cv_;
+  bool stop_ = false;
+  long job_id_ = 0;
+  long busy_ = 0;
+  const std::function<void(long)> *pfunc_ = nullptr;
+  long n_ = 0;
+  std::atomic<long> next_{0};
+};
+
+
+// Pools shared by the solvers, one for each size. They live until the program
+// exits, thus the returned pointer stays valid. nullptr for the size 1.
+inline ThreadPool *SharedThreadPool(const long size) {
+  static std::map<long, std::unique_ptr<ThreadPool>> pools;
+  static std::mutex mutex;
+  if (size <= 1) { return nullptr; }
+  std::lock_guard<std::mutex> lock(mutex);
+  auto &ppool = pools[size];
+  if (!ppool) { ppool.reset(new ThreadPool(size)); }
+  return ppool.get();
+}
+} /* gqmps2 */
+#endif /* ifndef GQMPS2_DETAIL_THREAD_POOL_H */
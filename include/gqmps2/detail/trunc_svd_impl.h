@@ -0,0 +1,631 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 17:05
+*
+* Description: GraceQ/MPS2 project. Implementation details for sector-parallel truncated SVD.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gqten/gqten.h"
+#include "gqmps2/detail/thread_pool.h"
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <random>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+
+#include <assert.h>
+
+#include "mkl.h"
+
+
+namespace gqmps2 {
+using namespace gqten;
+
+
+// The density matrix is used in the automatic mode when one side of the
+// sector matrix is at least this times larger than the other one.
+const long kDensityMatrixSvdRatio = 4;
+
+// Singular values from the density matrix below this times the largest one
+// of the sector are dropped, they are not accurate.
+const double kDensityMatrixSvdRelCutoff = 1.0E-7;
+
+const unsigned kRandomizedSvdSeed = 20201018;
+
+
+// Result of the decomposition, the same layout as the one of Svd.
+template <typename TenElemType>
+struct TruncSvdRes {
+  GQTensor<TenElemType> *u;
+  DGQTensor *s;
+  GQTensor<TenElemType> *v;
+  double trunc_err;
+  long D;
+};
+
+
+// Helpers.
+inline GQTEN_Double SvdConj(const GQTEN_Double x) { return x; }
+
+inline GQTEN_Complex SvdConj(const GQTEN_Complex z) { return std::conj(z); }
+
+
+inline void FillRandomNormal(
+    std::mt19937 &gen, std::vector<GQTEN_Double> &a) {
+  std::normal_distribution<double> dist;
+  for (auto &x : a) { x = dist(gen); }
+}
+
+
+inline void FillRandomNormal(
+    std::mt19937 &gen, std::vector<GQTEN_Complex> &a) {
+  std::normal_distribution<double> dist;
+  for (auto &z : a) { z = GQTEN_Complex(dist(gen), dist(gen)); }
+}
+
+
+// c = op(a) * op(b) for row-major matrices.
+inline void SvdGemm(
+    const CBLAS_TRANSPOSE transa, const CBLAS_TRANSPOSE transb,
+    const long m, const long n, const long k,
+    const GQTEN_Double *a, const long lda,
+    const GQTEN_Double *b, const long ldb,
+    GQTEN_Double *c, const long ldc) {
+  cblas_dgemm(
+      CblasRowMajor, transa, transb,
+      m, n, k,
+      1.0, a, lda, b, ldb,
+      0.0, c, ldc);
+}
+
+
+inline void SvdGemm(
+    const CBLAS_TRANSPOSE transa, const CBLAS_TRANSPOSE transb,
+    const long m, const long n, const long k,
+    const GQTEN_Complex *a, const long lda,
+    const GQTEN_Complex *b, const long ldb,
+    GQTEN_Complex *c, const long ldc) {
+  GQTEN_Complex alpha(1.0), beta(0.0);
+  cblas_zgemm(
+      CblasRowMajor, transa, transb,
+      m, n, k,
+      &alpha, a, lda, b, ldb,
+      &beta, c, ldc);
+}
+
+
+// Orthonormalize the columns of the m x n (m >= n) matrix in place.
+inline void SvdQr(const long m, const long n, GQTEN_Double *a) {
+  std::vector<GQTEN_Double> tau(n);
+  auto info = LAPACKE_dgeqrf(LAPACK_ROW_MAJOR, m, n, a, n, tau.data());
+  if (info == 0) {
+    info = LAPACKE_dorgqr(LAPACK_ROW_MAJOR, m, n, n, a, n, tau.data());
+  }
+  if (info != 0) {
+    std::cout << "?geqrf error." << std::endl;
+    exit(1);
+  }
+}
+
+
+inline void SvdQr(const long m, const long n, GQTEN_Complex *a) {
+  std::vector<GQTEN_Complex> tau(n);
+  auto info = LAPACKE_zgeqrf(LAPACK_ROW_MAJOR, m, n, a, n, tau.data());
+  if (info == 0) {
+    info = LAPACKE_zungqr(LAPACK_ROW_MAJOR, m, n, n, a, n, tau.data());
+  }
+  if (info != 0) {
+    std::cout << "?geqrf error." << std::endl;
+    exit(1);
+  }
+}
+
+
+// Thin SVD of the m x n matrix, a is destroyed. u is m x min(m, n) and vt is
+// min(m, n) x n.
+inline void SvdGesdd(
+    const long m, const long n, GQTEN_Double *a,
+    double *s, GQTEN_Double *u, GQTEN_Double *vt) {
+  auto info = LAPACKE_dgesdd(
+                  LAPACK_ROW_MAJOR, 'S', m, n, a, n,
+                  s, u, std::min(m, n), vt, n);
+  if (info != 0) {
+    std::cout << "?gesdd error." << std::endl;
+    exit(1);
+  }
+}
+
+
+inline void SvdGesdd(
+    const long m, const long n, GQTEN_Complex *a,
+    double *s, GQTEN_Complex *u, GQTEN_Complex *vt) {
+  auto info = LAPACKE_zgesdd(
+                  LAPACK_ROW_MAJOR, 'S', m, n, a, n,
+                  s, u, std::min(m, n), vt, n);
+  if (info != 0) {
+    std::cout << "?gesdd error." << std::endl;
+    exit(1);
+  }
+}
+
+
+// The blocks with the same quantum number on the new bond form the matrix of
+// a sector. The rows are the combinations of the left sectors, the columns
+// the ones of the right sectors. The decomposition keeps the singular values
+// in descending order, u is m x rank and vt is rank x n.
+template <typename TenElemType>
+struct SvdSector {
+  SvdSector(const QN &qn) : qn(qn) {}
+
+  QN qn;
+  std::map<std::vector<long>, long> row_slots;
+  std::map<std::vector<long>, long> col_slots;
+  std::vector<long> row_offsets;
+  std::vector<long> col_offsets;
+  long m = 0;
+  long n = 0;
+  std::vector<TenElemType> mat;
+  double weight = 0.0;      // Squared Frobenius norm.
+
+  long rank = 0;
+  std::vector<double> s;
+  std::vector<TenElemType> u;
+  std::vector<TenElemType> vt;
+  long kept = 0;
+};
+
+
+template <typename TenElemType>
+void SvdSectorFull(SvdSector<TenElemType> &sct) {
+  auto m = sct.m, n = sct.n;
+  sct.rank = std::min(m, n);
+  std::vector<TenElemType> a(sct.mat);
+  sct.s.resize(sct.rank);
+  sct.u.resize(m*sct.rank);
+  sct.vt.resize(sct.rank*n);
+  SvdGesdd(m, n, a.data(), sct.s.data(), sct.u.data(), sct.vt.data());
+}
+
+
+// Randomized range finder with power iterations, then the SVD of the
+// projected l x n matrix.
+template <typename TenElemType>
+void SvdSectorRandomized(
+    SvdSector<TenElemType> &sct, const long k, const long oversampling,
+    const long power_iters, std::mt19937 &gen) {
+  auto m = sct.m, n = sct.n;
+  auto l = k + oversampling;
+  if (l >= std::min(m, n)) {
+    SvdSectorFull(sct);
+    return;
+  }
+  auto mat = sct.mat.data();
+  std::vector<TenElemType> omega(n*l), q(m*l), z(n*l);
+  FillRandomNormal(gen, omega);
+  SvdGemm(
+      CblasNoTrans, CblasNoTrans, m, l, n,
+      mat, n, omega.data(), l, q.data(), l);
+  SvdQr(m, l, q.data());
+  for (long it = 0; it < power_iters; ++it) {
+    SvdGemm(
+        CblasConjTrans, CblasNoTrans, n, l, m,
+        mat, n, q.data(), l, z.data(), l);
+    SvdQr(n, l, z.data());
+    SvdGemm(
+        CblasNoTrans, CblasNoTrans, m, l, n,
+        mat, n, z.data(), l, q.data(), l);
+    SvdQr(m, l, q.data());
+  }
+
+  std::vector<TenElemType> b(l*n), ub(l*l), u(m*l);
+  std::vector<double> s(l);
+  SvdGemm(
+      CblasConjTrans, CblasNoTrans, l, n, m,
+      q.data(), l, mat, n, b.data(), n);
+  sct.vt.resize(l*n);
+  SvdGesdd(l, n, b.data(), s.data(), ub.data(), sct.vt.data());
+  SvdGemm(
+      CblasNoTrans, CblasNoTrans, m, l, l,
+      q.data(), l, ub.data(), l, u.data(), l);
+
+  // The oversampled singular vectors are not accurate.
+  sct.rank = k;
+  sct.s.assign(s.begin(), s.begin() + k);
+  sct.vt.resize(k*n);
+  sct.u.resize(m*k);
+  for (long i = 0; i < m; ++i) {
+    std::copy(u.begin() + i*l, u.begin() + i*l + k, sct.u.begin() + i*k);
+  }
+}
+
+
+// Eigen decomposition of the density matrix of the smaller side. The small
+// singular values lose half of the digits, they are dropped.
+template <typename TenElemType>
+void SvdSectorDensityMatrix(SvdSector<TenElemType> &sct, const long k) {
+  auto m = sct.m, n = sct.n;
+  auto mat = sct.mat.data();
+  auto dim = std::min(m, n);
+  std::vector<TenElemType> rho(dim*dim);
+  if (m <= n) {
+    SvdGemm(
+        CblasNoTrans, CblasConjTrans, m, m, n,
+        mat, n, mat, n, rho.data(), m);
+  } else {
+    SvdGemm(
+        CblasConjTrans, CblasNoTrans, n, n, m,
+        mat, n, mat, n, rho.data(), n);
+  }
+  std::vector<double> w(dim);
+  SubspaceHeev(dim, rho.data(), w.data());
+
+  // The eigenvalues are in ascending order.
+  auto max_rank = std::min(k, dim);
+  sct.s.clear();
+  for (long j = 0; j < max_rank; ++j) {
+    auto sv = std::sqrt(std::max(w[dim-1-j], 0.0));
+    if (j > 0 && sv <= kDensityMatrixSvdRelCutoff * sct.s[0]) { break; }
+    if (sv == 0.0) { break; }
+    sct.s.push_back(sv);
+  }
+  auto r = long(sct.s.size());
+  sct.rank = r;
+  std::vector<TenElemType> vecs(dim*r);
+  for (long i = 0; i < dim; ++i) {
+    for (long j = 0; j < r; ++j) {
+      vecs[i*r + j] = rho[i*dim + dim-1-j];
+    }
+  }
+  if (m <= n) {
+    sct.u = std::move(vecs);
+    sct.vt.resize(r*n);
+    SvdGemm(
+        CblasConjTrans, CblasNoTrans, r, n, m,
+        sct.u.data(), r, mat, n, sct.vt.data(), n);
+    for (long j = 0; j < r; ++j) {
+      for (long i = 0; i < n; ++i) { sct.vt[j*n + i] *= 1.0 / sct.s[j]; }
+    }
+  } else {
+    sct.vt.resize(r*n);
+    for (long j = 0; j < r; ++j) {
+      for (long i = 0; i < n; ++i) { sct.vt[j*n + i] = SvdConj(vecs[i*r + j]); }
+    }
+    sct.u.resize(m*r);
+    SvdGemm(
+        CblasNoTrans, CblasNoTrans, m, r, n,
+        mat, n, vecs.data(), r, sct.u.data(), r);
+    for (long i = 0; i < m; ++i) {
+      for (long j = 0; j < r; ++j) { sct.u[i*r + j] *= 1.0 / sct.s[j]; }
+    }
+  }
+}
+
+
+template <typename TenElemType>
+void DecompSvdSector(
+    SvdSector<TenElemType> &sct, const char method, const long max_rank,
+    const long oversampling, const long power_iters, const unsigned seed) {
+  sct.weight = 0.0;
+  for (auto &elem : sct.mat) { sct.weight += std::norm(elem); }
+  auto k = std::min(max_rank, std::min(sct.m, sct.n));
+  auto large_dim = std::max(sct.m, sct.n);
+  auto small_dim = std::min(sct.m, sct.n);
+  std::mt19937 gen(seed);
+  switch (method) {
+    case kSvdRandomized:
+      SvdSectorRandomized(sct, k, oversampling, power_iters, gen);
+      break;
+    case kSvdDensityMatrix:
+      SvdSectorDensityMatrix(sct, k);
+      break;
+    case kSvdAuto:
+      if (large_dim >= kDensityMatrixSvdRatio * small_dim) {
+        SvdSectorDensityMatrix(sct, k);
+      } else {
+        SvdSectorRandomized(sct, k, oversampling, power_iters, gen);
+      }
+      break;
+    default:
+      SvdSectorFull(sct);
+  }
+  sct.mat.clear();
+  sct.mat.shrink_to_fit();
+}
+
+
+// Truncated SVD of the weighted tensors with the same legs, stacked side by
+// side (stack = 'c') or one over another (stack = 'r'), with the first ldims
+// legs as the rows. The u of the side by side stack spans the state-averaged
+// left bases of the tensors, the v of the other one the right bases, the
+// other side is not built (nullptr). The stack 'n' of one tensor is the plain
+// truncated SVD.
+template <typename TenElemType>
+TruncSvdRes<TenElemType> StackedTruncatedSvd(
+    const std::vector<const GQTensor<TenElemType> *> &ts,
+    const std::vector<double> &weights, const char stack,
+    const long ldims, const long rdims,
+    const QN &ldiv, const QN &rdiv,
+    const double cutoff, const long Dmin, const long Dmax,
+    const char method,
+    const long oversampling = 10, const long power_iters = 2,
+    const long threads = 0) {
+  assert(ts.size() == weights.size());
+  assert(stack != 'n' || ts.size() == 1);
+  auto &t = *ts[0];
+  assert(ldims + rdims == long(t.indexes.size()));
+  auto zero_div = ldiv - ldiv;
+
+  // Collect the sector matrices. The stacked tensors are told apart by one
+  // more element of the row or column keys.
+  std::vector<SvdSector<TenElemType>> sectors;
+  std::vector<const QNBlock<TenElemType> *> blks;
+  std::vector<long> blk_tgts;
+  std::vector<long> blk_scts;
+  std::vector<long> blk_rows;
+  std::vector<long> blk_cols;
+  for (size_t a = 0; a < ts.size(); ++a) {
+    for (auto pblk : ts[a]->cblocks()) {
+      blks.push_back(pblk);
+      blk_tgts.push_back(a);
+    }
+  }
+  for (size_t b = 0; b < blks.size(); ++b) {
+    auto pblk = blks[b];
+    auto ids = BlockSectorIds(t, pblk);
+    auto lflow = zero_div;
+    for (long k = 0; k < ldims; ++k) {
+      if (t.indexes[k].dir == OUT) {
+        lflow = lflow + pblk->qnscts[k].qn;
+      } else {
+        lflow = lflow - pblk->qnscts[k].qn;
+      }
+    }
+    auto qn = ldiv - lflow;
+    long sct_id = -1;
+    for (size_t i = 0; i < sectors.size(); ++i) {
+      if (sectors[i].qn == qn) { sct_id = i; }
+    }
+    if (sct_id == -1) {
+      sectors.push_back(SvdSector<TenElemType>(qn));
+      sct_id = sectors.size() - 1;
+    }
+    auto &sct = sectors[sct_id];
+    std::vector<long> row_key(ids.begin(), ids.begin() + ldims);
+    std::vector<long> col_key(ids.begin() + ldims, ids.end());
+    if (stack == 'r') { row_key.push_back(blk_tgts[b]); }
+    if (stack == 'c') { col_key.push_back(blk_tgts[b]); }
+    long rdim = 1, cdim = 1;
+    for (long k = 0; k < ldims; ++k) { rdim *= pblk->shape[k]; }
+    for (long k = ldims; k < ldims + rdims; ++k) { cdim *= pblk->shape[k]; }
+    if (sct.row_slots.find(row_key) == sct.row_slots.end()) {
+      sct.row_slots[row_key] = sct.row_offsets.size();
+      sct.row_offsets.push_back(sct.m);
+      sct.m += rdim;
+    }
+    if (sct.col_slots.find(col_key) == sct.col_slots.end()) {
+      sct.col_slots[col_key] = sct.col_offsets.size();
+      sct.col_offsets.push_back(sct.n);
+      sct.n += cdim;
+    }
+    blk_scts.push_back(sct_id);
+    blk_rows.push_back(sct.row_offsets[sct.row_slots[row_key]]);
+    blk_cols.push_back(sct.col_offsets[sct.col_slots[col_key]]);
+  }
+  for (auto &sct : sectors) {
+    sct.mat.assign(sct.m * sct.n, TenElemType(0.0));
+  }
+  for (size_t b = 0; b < blks.size(); ++b) {
+    auto &sct = sectors[blk_scts[b]];
+    auto pblk = blks[b];
+    long cdim = 1;
+    for (long k = ldims; k < ldims + rdims; ++k) { cdim *= pblk->shape[k]; }
+    auto rdim = pblk->size / cdim;
+    auto data = pblk->cdata();
+    TenElemType scale = std::sqrt(weights[blk_tgts[b]]);
+    for (long r = 0; r < rdim; ++r) {
+      std::transform(
+          data + r*cdim, data + (r+1)*cdim,
+          sct.mat.begin() + (blk_rows[b] + r)*sct.n + blk_cols[b],
+          [scale](const TenElemType x) { return scale * x; });
+    }
+  }
+
+  // Decompose the sectors, the large ones first.
+  std::vector<size_t> order(sectors.size());
+  for (size_t i = 0; i < order.size(); ++i) { order[i] = i; }
+  std::sort(
+      order.begin(), order.end(),
+      [&sectors](const size_t a, const size_t b) {
+        return sectors[a].m * sectors[a].n > sectors[b].m * sectors[b].n;
+      });
+  auto decomp = [&](const long i) {
+    DecompSvdSector(
+        sectors[order[i]], method, Dmax, oversampling, power_iters,
+        kRandomizedSvdSeed + order[i]);
+  };
+  long thread_num = (threads > 0) ?
+                    threads : long(std::thread::hardware_concurrency());
+  auto ppool = (sectors.size() > 1) ? SharedThreadPool(thread_num) : nullptr;
+  if (ppool == nullptr) {
+    for (size_t i = 0; i < order.size(); ++i) { decomp(i); }
+  } else {
+    // One MKL thread for each thread of the pool.
+    ppool->ParallelFor(
+        order.size(),
+        [&decomp](const long i) {
+          auto mkl_threads = mkl_set_num_threads_local(1);
+          decomp(i);
+          mkl_set_num_threads_local(mkl_threads);
+        });
+  }
+
+  // Keep the largest singular values.
+  struct SingVal {
+    double s;
+    long sct;
+  };
+  std::vector<SingVal> sing_vals;
+  double tot_weight = 0.0;
+  for (size_t i = 0; i < sectors.size(); ++i) {
+    tot_weight += sectors[i].weight;
+    for (long j = 0; j < sectors[i].rank; ++j) {
+      sing_vals.push_back({sectors[i].s[j], long(i)});
+    }
+  }
+  if (sing_vals.empty()) {
+    std::cout << "No singular value is found in TruncatedSvd." << std::endl;
+    exit(1);
+  }
+  std::stable_sort(
+      sing_vals.begin(), sing_vals.end(),
+      [](const SingVal &a, const SingVal &b) { return a.s > b.s; });
+  auto max_D = std::min(Dmax, long(sing_vals.size()));
+  long D = 0;
+  double kept_weight = 0.0;
+  while (D < max_D) {
+    if (D >= Dmin && tot_weight - kept_weight <= cutoff * tot_weight) {
+      break;
+    }
+    kept_weight += sing_vals[D].s * sing_vals[D].s;
+    ++sectors[sing_vals[D].sct].kept;
+    ++D;
+  }
+  auto trunc_err = std::max(tot_weight - kept_weight, 0.0) / tot_weight;
+
+  // The new bond.
+  std::vector<QNSector> mid_qnscts;
+  std::vector<long> mid_scts;
+  for (size_t i = 0; i < sectors.size(); ++i) {
+    if (sectors[i].kept == 0) { continue; }
+    mid_qnscts.push_back(QNSector(sectors[i].qn, sectors[i].kept));
+    mid_scts.push_back(i);
+  }
+  auto mid_index = Index(mid_qnscts, OUT);
+  auto mid_offsets = QNSectorOffsets(mid_index);
+  std::vector<std::vector<long>> leg_offsets;
+  for (auto &index : t.indexes) {
+    leg_offsets.push_back(QNSectorOffsets(index));
+  }
+
+  std::vector<Index> u_indexes(t.indexes.begin(), t.indexes.begin() + ldims);
+  u_indexes.push_back(mid_index);
+  std::vector<Index> v_indexes = {InverseIndex(mid_index)};
+  v_indexes.insert(
+      v_indexes.end(), t.indexes.begin() + ldims, t.indexes.end());
+  auto pu = (stack == 'r') ? nullptr : new GQTensor<TenElemType>(u_indexes);
+  auto ps = new DGQTensor({InverseIndex(mid_index), mid_index});
+  auto pv = (stack == 'c') ? nullptr : new GQTensor<TenElemType>(v_indexes);
+
+  // Create the blocks by one element, then fill them.
+  for (size_t c = 0; c < mid_scts.size(); ++c) {
+    auto &sct = sectors[mid_scts[c]];
+    for (auto &row : sct.row_slots) {
+      if (pu == nullptr) { break; }
+      std::vector<long> coors;
+      for (long k = 0; k < ldims; ++k) {
+        coors.push_back(leg_offsets[k][row.first[k]]);
+      }
+      coors.push_back(mid_offsets[c]);
+      (*pu)(coors) = TenElemType(1.0);
+    }
+    for (auto &col : sct.col_slots) {
+      if (pv == nullptr) { break; }
+      std::vector<long> coors = {mid_offsets[c]};
+      for (long k = 0; k < rdims; ++k) {
+        coors.push_back(leg_offsets[ldims+k][col.first[k]]);
+      }
+      (*pv)(coors) = TenElemType(1.0);
+    }
+    for (long j = 0; j < sct.kept; ++j) {
+      (*ps)({mid_offsets[c] + j, mid_offsets[c] + j}) = sct.s[j];
+    }
+  }
+  if (pu == nullptr) { return {pu, ps, pv, trunc_err, D}; }
+  for (auto pblk : pu->blocks()) {
+    auto ids = BlockSectorIds(*pu, pblk);
+    auto &sct = sectors[mid_scts[ids.back()]];
+    ids.pop_back();
+    auto row_offset = sct.row_offsets[sct.row_slots[ids]];
+    auto rdim = pblk->size / sct.kept;
+    auto data = pblk->data();
+    for (long r = 0; r < rdim; ++r) {
+      std::copy(
+          sct.u.begin() + (row_offset + r)*sct.rank,
+          sct.u.begin() + (row_offset + r)*sct.rank + sct.kept,
+          data + r*sct.kept);
+    }
+  }
+  if (pv == nullptr) { return {pu, ps, pv, trunc_err, D}; }
+  for (auto pblk : pv->blocks()) {
+    auto ids = BlockSectorIds(*pv, pblk);
+    auto &sct = sectors[mid_scts[ids.front()]];
+    std::vector<long> col_key(ids.begin() + 1, ids.end());
+    auto col_offset = sct.col_offsets[sct.col_slots[col_key]];
+    auto cdim = pblk->size / sct.kept;
+    auto data = pblk->data();
+    for (long j = 0; j < sct.kept; ++j) {
+      std::copy(
+          sct.vt.begin() + j*sct.n + col_offset,
+          sct.vt.begin() + j*sct.n + col_offset + cdim,
+          data + j*cdim);
+    }
+  }
+  return {pu, ps, pv, trunc_err, D};
+}
+
+
+// Truncated SVD of the tensor with the first ldims legs as the rows. The
+// quantum number sectors are decomposed in parallel by the given method and
+// at most Dmax singular values are computed in each sector. Then the largest
+// ones are kept with the same rule of cutoff, Dmin and Dmax as Svd. The
+// truncation error is measured against the norm of the whole tensor, thus it
+// is exact also for the partial decompositions.
+template <typename TenElemType>
+TruncSvdRes<TenElemType> TruncatedSvd(
+    const GQTensor<TenElemType> &t,
+    const long ldims, const long rdims,
+    const QN &ldiv, const QN &rdiv,
+    const double cutoff, const long Dmin, const long Dmax,
+    const char method,
+    const long oversampling = 10, const long power_iters = 2,
+    const long threads = 0) {
+  return StackedTruncatedSvd<TenElemType>(
+      {&t}, {1.0}, 'n',
+      ldims, rdims,
+      ldiv, rdiv,
+      cutoff, Dmin, Dmax,
+      method, oversampling, power_iters, threads);
+}
+
+
+// Decompose the state by the method of the sweep parameters.
+template <typename TenElemType>
+TruncSvdRes<TenElemType> SweepSvd(
+    const GQTensor<TenElemType> &t,
+    const long ldims, const long rdims,
+    const QN &ldiv, const QN &rdiv,
+    const SweepParams &sweep_params) {
+  if (sweep_params.SvdMethod == kSvdFull) {
+    auto svd_res = Svd(
+        t,
+        ldims, rdims,
+        ldiv, rdiv,
+        sweep_params.Cutoff,
+        sweep_params.Dmin, sweep_params.Dmax);
+    return {svd_res.u, svd_res.s, svd_res.v, svd_res.trunc_err, svd_res.D};
+  }
+  return TruncatedSvd(
+      t,
+      ldims, rdims,
+      ldiv, rdiv,
+      sweep_params.Cutoff,
+      sweep_params.Dmin, sweep_params.Dmax,
+      sweep_params.SvdMethod,
+      sweep_params.SvdOversampling, sweep_params.SvdPowerIters,
+      sweep_params.SvdThreads);
+}
+} /* gqmps2 */
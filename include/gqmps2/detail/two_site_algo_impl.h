@@ -10,8 +10,11 @@
 
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <algorithm>
 
 #include <assert.h>
 
@@ -40,19 +43,77 @@ inline double MeasureEE(const DGQTensor *s, const long sdim) {
 }
 
 
-inline std::string GenBlockFileName(
-    const std::string &dir, const long blk_len) {
-  return kRuntimeTempPath + "/" +
-         dir + kBlockFileBaseName + std::to_string(blk_len) +
-         "." + kGQTenFileSuffix;
+inline void PrintBlockCodecStats(const BlockCodecStats &stats) {
+  const double mb = 1024.0 * 1024.0;
+  std::cout << "block codec ratio = " << std::setprecision(2) << std::fixed
+            << stats.Ratio();
+  if (stats.encode_time > 0) {
+    std::cout << " encode = " << stats.raw_bytes / mb / stats.encode_time
+              << " MB/s";
+  }
+  if (stats.decode_time > 0) {
+    std::cout << " decode = " << stats.decoded_bytes / mb / stats.decode_time
+              << " MB/s";
+  }
+  std::cout << std::scientific << std::endl;
+}
+
+
+inline void PrintUpdateArenaStats(const UpdateArenaStats &stats) {
+  const double mb = 1024.0 * 1024.0;
+  std::cout << "update arena served = " << std::setprecision(2) << std::fixed
+            << stats.served_bytes / mb << " MB"
+            << " peak = " << stats.peak_bytes / mb << " MB"
+            << " chunks = " << stats.chunk_allocs
+            << std::scientific << std::endl;
 }
 
 
-inline void RemoveFile(const std::string &file) {
-  if (std::remove(file.c_str())) {
-    std::cout << "Unable to delete " << file << std::endl;
-    exit(1);
+// Left block with length len+1 grown from the one with length len.
+template <typename TenType>
+TenType *GrowLBlock(
+    const TenType &lblock, const TenType &mps_ten, const TenType &mpo_ten,
+    const long len) {
+  TenType *new_lblock;
+  if (len == 0) {
+    new_lblock = Contract(mps_ten, mpo_ten, {{0}, {0}});
+    auto temp_new_lblock = Contract(*new_lblock, Dag(mps_ten), {{2}, {0}});
+    delete new_lblock;
+    new_lblock = temp_new_lblock;
+  } else {
+    new_lblock = Contract(lblock, mps_ten, {{0}, {0}});
+    auto temp_new_lblock = Contract(*new_lblock, mpo_ten, {{0, 2}, {0, 1}});
+    delete new_lblock;
+    new_lblock = temp_new_lblock;
+    temp_new_lblock = Contract(*new_lblock, Dag(mps_ten), {{0, 2}, {0, 1}});
+    delete new_lblock;
+    new_lblock = temp_new_lblock;
+  }
+  return new_lblock;
+}
+
+
+// Right block with length len+1 grown from the one with length len.
+template <typename TenType>
+TenType *GrowRBlock(
+    const TenType &rblock, const TenType &mps_ten, const TenType &mpo_ten,
+    const long len) {
+  TenType *new_rblock;
+  if (len == 0) {
+    new_rblock = Contract(mps_ten, mpo_ten, {{1}, {0}});
+    auto temp_new_rblock = Contract(*new_rblock, Dag(mps_ten), {{2}, {1}});
+    delete new_rblock;
+    new_rblock = temp_new_rblock;
+  } else {
+    new_rblock = Contract(mps_ten, rblock, {{2}, {0}});
+    auto temp_new_rblock = Contract(*new_rblock, mpo_ten, {{1, 2}, {1, 3}});
+    delete new_rblock;
+    new_rblock = temp_new_rblock;
+    temp_new_rblock = Contract(*new_rblock, Dag(mps_ten), {{3, 1}, {1, 2}});
+    delete new_rblock;
+    new_rblock = temp_new_rblock;
   }
+  return new_rblock;
 }
 
 
@@ -61,98 +122,159 @@ template <typename TenType>
 double TwoSiteAlgorithm(
     std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
     const SweepParams &sweep_params) {
+  assert(mps.size() == mpo.size());
+  if (sweep_params.RealSpaceSegments > 1) {
+    return RealSpaceParallelTwoSiteAlgorithm(mps, mpo, sweep_params);
+  }
   if ( sweep_params.FileIO && !IsPathExist(kRuntimeTempPath)) {
     CreatPath(kRuntimeTempPath);
   }
 
-  auto l_and_r_blocks = InitBlocks(mps, mpo, sweep_params);
+  BlockManager<TenType> blk_mgr(mpo, sweep_params);
+  SweepCheckpoint<TenType> ckpt(mps.size(), sweep_params);
+  UpdateArena update_arena;
+  SweepConvergence convergence(sweep_params);
+  SweepPosition pos = {0, 0, 'r'};
+  std::vector<double> energies;
+  if (sweep_params.Workflow == kTwoSiteAlgoWorkflowContinue) {
+    if (ckpt.Load(mps, pos, energies)) {
+      std::cout << "resume from sweep " << pos.sweep
+                << " site " << pos.site
+                << " direction " << pos.dir << std::endl;
+    }
+  } else {
+    ckpt.Clear();
+  }
+  InitBlocks(mps, mpo, blk_mgr, pos.site, pos.dir);
 
   std::cout << "\n";
-  double e0;
+  double e0 = energies.empty() ? 0.0 : energies.back();
   Timer sweep_timer("sweep");
-  for (long sweep = 0; sweep < sweep_params.Sweeps; ++sweep) {
+  for (long sweep = pos.sweep; sweep < sweep_params.Sweeps; ++sweep) {
     std::cout << "sweep " << sweep << std::endl;
+    auto params = SweepParamsOfSweep(sweep_params, sweep);
+    if (!sweep_params.Schedule.empty()) { PrintSweepStage(params); }
+    if (pos.site != 0 || pos.dir != 'r') { convergence.Skip(); }
     sweep_timer.Restart();
+    double max_trunc_err;
     e0 = TwoSiteSweep(
-        mps, mpo,
-        l_and_r_blocks.first, l_and_r_blocks.second,
-        sweep_params);
+             mps, mpo, params, blk_mgr, ckpt, update_arena,
+             pos, energies, max_trunc_err);
     sweep_timer.PrintElapsed();
+    if (ckpt.Interrupted()) {
+      std::cout << "interrupted at sweep " << pos.sweep
+                << " site " << pos.site
+                << " direction " << pos.dir << "\n" << std::endl;
+      return e0;
+    }
+    PrintUpdateArenaStats(update_arena.Stats());
+    if (sweep_params.FileIO && sweep_params.BlockCodec != kBlockCodecNone) {
+      PrintBlockCodecStats(blk_mgr.CodecStats());
+    }
+    if (convergence.Check(sweep, e0, max_trunc_err)) {
+      std::cout << "converged after sweep " << sweep << "\n" << std::endl;
+      break;
+    }
     std::cout << "\n";
   }
+  // Keep the blocks on disk for the following runs.
+  blk_mgr.Flush();
+  ckpt.Clear();
   return e0;
 }
 
 
+// Prepare the blocks for the update (i, dir). The blocks in the block arena
+// which are built from the same tensors are reused. Returns the number of the
+// reused blocks.
 template<typename TenType>
-std::pair<std::vector<TenType *>, std::vector<TenType *>> InitBlocks(
+long InitBlocks(
     const std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
-    const SweepParams &sweep_params) {
-  assert(mps.size() == mpo.size());
-  auto N = mps.size();
-  std::vector<TenType *> rblocks(N-1);
-  std::vector<TenType *> lblocks(N-1);
+    BlockManager<TenType> &blk_mgr,
+    const long i, const char dir) {
+  long N = mps.size();
+  long lblock_len = blk_mgr.BlockLen('l', i, dir);
+  long rblock_len = blk_mgr.BlockLen('r', i, dir);
+  long reused_blk_num = 0;
 
-  if (sweep_params.Workflow == kTwoSiteAlgoWorkflowContinue) {
-    return std::make_pair(lblocks, rblocks);
+  // Left blocks.
+  auto hash = blk_mgr.InitHash('l');
+  if (blk_mgr.Reuse('l', 0, hash)) {
+    ++reused_blk_num;
+  } else {
+    blk_mgr.Put('l', 0, new TenType(), hash);
+  }
+  for (long len = 1; len <= lblock_len; ++len) {
+    hash = blk_mgr.GrowHash('l', len-1, *mps[len-1]);
+    if (blk_mgr.Reuse('l', len, hash)) {
+      ++reused_blk_num;
+      continue;
+    }
+    auto lblock = GrowLBlock(
+                      *blk_mgr.Acquire('l', len-1),
+                      *mps[len-1], *mpo[len-1],
+                      len-1);
+    blk_mgr.Put('l', len, lblock, hash);
+    blk_mgr.Arrange(i, dir);
   }
 
-  // Generate blocks.
   // Right blocks.
-  auto rblock0 = new TenType();
-  rblocks[0] = rblock0;
-  auto rblock1 = Contract(*mps.back(), *mpo.back(), {{1}, {0}});
-  auto temp_rblock1 = Contract(*rblock1, Dag(*mps.back()), {{2}, {1}});
-  delete rblock1;
-  rblock1 = temp_rblock1;
-  rblocks[1] = rblock1;
-  std::string file;
-  if (sweep_params.FileIO) {
-    file = GenBlockFileName("r", 0);
-    WriteGQTensorTOFile(*rblock0, file);
-    delete rblocks[0];
-    file = GenBlockFileName("r", 1);
-    WriteGQTensorTOFile(*rblock1, file);
+  hash = blk_mgr.InitHash('r');
+  if (blk_mgr.Reuse('r', 0, hash)) {
+    ++reused_blk_num;
+  } else {
+    blk_mgr.Put('r', 0, new TenType(), hash);
   }
-  for (size_t i = 2; i < N-1; ++i) {
-    auto rblocki = Contract(*mps[N-i], *rblocks[i-1], {{2}, {0}});
-    auto temp_rblocki = Contract(*rblocki, *mpo[N-i], {{1, 2}, {1, 3}});
-    delete rblocki;
-    rblocki = temp_rblocki;
-    temp_rblocki = Contract(*rblocki, Dag(*mps[N-i]), {{3, 1}, {1, 2}});
-    delete rblocki;
-    rblocki = temp_rblocki;
-    rblocks[i] = rblocki;
-    if (sweep_params.FileIO) {
-      auto file = GenBlockFileName("r", i);
-      WriteGQTensorTOFile(*rblocki, file);
-      delete rblocks[i-1];
+  for (long len = 1; len <= rblock_len; ++len) {
+    hash = blk_mgr.GrowHash('r', len-1, *mps[N-len]);
+    if (blk_mgr.Reuse('r', len, hash)) {
+      ++reused_blk_num;
+      continue;
     }
+    auto rblock = GrowRBlock(
+                      *blk_mgr.Acquire('r', len-1),
+                      *mps[N-len], *mpo[N-len],
+                      len-1);
+    blk_mgr.Put('r', len, rblock, hash);
+    blk_mgr.Arrange(i, dir);
   }
-  if (sweep_params.FileIO) { delete rblocks[N-2]; }
+  blk_mgr.Arrange(i, dir);
 
-  // Left blocks.
-  if (sweep_params.FileIO) {
-    auto file = GenBlockFileName("l", 0);
-    WriteGQTensorTOFile(TenType(), file);
+  if (reused_blk_num > 0) {
+    std::cout << "reuse " << reused_blk_num << " blocks" << std::endl;
   }
-
-  return std::make_pair(lblocks, rblocks);
+  return reused_blk_num;
 }
 
 
+// Run the updates from pos to the end of the sweep.
 template <typename TenType>
 double TwoSiteSweep(
     std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
-    std::vector<TenType *> &lblocks, std::vector<TenType *> &rblocks,
-    const SweepParams &sweep_params) {
-  auto N = mps.size();
+    const SweepParams &sweep_params, BlockManager<TenType> &blk_mgr,
+    SweepCheckpoint<TenType> &ckpt, UpdateArena &update_arena,
+    SweepPosition &pos, std::vector<double> &energies,
+    double &max_trunc_err) {
+  long N = mps.size();
+  auto sweep = pos.sweep;
+  if (pos.site == 0 && pos.dir == 'r') { energies.clear(); }
   double e0;
-  for (size_t i = 0; i < N-1; ++i) {
-    e0 = TwoSiteUpdate(i, mps, mpo, lblocks, rblocks, sweep_params, 'r');
-  }
-  for (size_t i = N-1; i > 0; --i) {
-    e0 = TwoSiteUpdate(i, mps, mpo, lblocks, rblocks, sweep_params, 'l');
+  double trunc_err;
+  max_trunc_err = 0.0;
+  while (pos.sweep == sweep && !ckpt.Interrupted()) {
+    e0 = TwoSiteUpdate(
+             pos.site, mps, mpo, sweep_params, pos.dir, blk_mgr, update_arena,
+             trunc_err);
+    energies.push_back(e0);
+    max_trunc_err = std::max(max_trunc_err, trunc_err);
+    auto lsite_idx = (pos.dir == 'r') ? pos.site : pos.site-1;
+    ckpt.MarkDirty(lsite_idx);
+    ckpt.MarkDirty(lsite_idx+1);
+    pos = NextSweepPosition(pos, N);
+    if (ckpt.Tick()) {
+      blk_mgr.Flush();
+      ckpt.Write(mps, pos, energies);
+    }
   }
   return e0;
 }
@@ -162,8 +284,9 @@ template <typename TenType>
 double TwoSiteUpdate(
     const long i,
     std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
-    std::vector<TenType *> &lblocks, std::vector<TenType *> &rblocks,
-    const SweepParams &sweep_params, const char dir) {
+    const SweepParams &sweep_params, const char dir,
+    BlockManager<TenType> &blk_mgr, UpdateArena &update_arena,
+    double &trunc_err, DGQTensor **pbond_s = nullptr) {
   Timer update_timer("update");
   update_timer.Restart();
 
@@ -178,7 +301,6 @@ double TwoSiteUpdate(
   long svd_ldims, svd_rdims;
   long lsite_idx, rsite_idx;
   long lblock_len, rblock_len;
-  std::string lblock_file, rblock_file;
 
   switch (dir) {
     case 'r':
@@ -233,27 +355,10 @@ double TwoSiteUpdate(
       exit(1);
   }
 
-  if (sweep_params.FileIO) {
-    switch (dir) {
-      case 'r':
-        rblock_file = GenBlockFileName("r", rblock_len);
-        ReadGQTensorFromFile(rblocks[rblock_len], rblock_file);
-        if (rblock_len != 0) {
-          RemoveFile(rblock_file);
-        }
-        break;
-      case 'l':
-        lblock_file = GenBlockFileName("l", lblock_len);
-        ReadGQTensorFromFile(lblocks[lblock_len], lblock_file);
-        if (lblock_len != 0) {
-          RemoveFile(lblock_file);
-        }
-        break;
-      default:
-        std::cout << "dir must be 'r' or 'l', but " << dir << std::endl; 
-        exit(1);
-    }
-  }
+  // The blocks have been prefetched during the last update if they were
+  // spilled to disk.
+  auto lblock = blk_mgr.Acquire('l', lblock_len);
+  auto rblock = blk_mgr.Acquire('r', rblock_len);
 
 #ifdef GQMPS2_TIMING_MODE
   bef_lanc_timer.PrintElapsed();
@@ -261,10 +366,10 @@ double TwoSiteUpdate(
 
   // Lanczos
   std::vector<TenType *>eff_ham(4);
-  eff_ham[0] = lblocks[lblock_len];
+  eff_ham[0] = lblock;
   eff_ham[1] = mpo[lsite_idx];
   eff_ham[2] = mpo[rsite_idx];
-  eff_ham[3] = rblocks[rblock_len];
+  eff_ham[3] = rblock;
   auto init_state = Contract(
                         *mps[lsite_idx], *mps[rsite_idx],
                         init_state_ctrct_axes);
@@ -272,10 +377,15 @@ double TwoSiteUpdate(
   Timer lancz_timer("Lancz");
   lancz_timer.Restart();
 
-  auto lancz_res = LanczosSolver(
+  auto lancz_res = (sweep_params.LanczParams.solver == kEigenSolverDavidson) ?
+                   DavidsonSolver(
+                       eff_ham, init_state,
+                       sweep_params.LanczParams,
+                       where, &update_arena) :
+                   LanczosSolver(
                        eff_ham, init_state,
                        sweep_params.LanczParams,
-                       where);
+                       where, &update_arena);
 
 #ifdef GQMPS2_TIMING_MODE
   auto lancz_elapsed_time = lancz_timer.PrintElapsed();
@@ -289,12 +399,11 @@ double TwoSiteUpdate(
   svd_timer.Restart();
 #endif
 
-  auto svd_res = Svd(
+  auto svd_res = SweepSvd(
       *lancz_res.gs_vec,
       svd_ldims, svd_rdims,
       Div(*mps[lsite_idx]), Div(*mps[rsite_idx]),
-      sweep_params.Cutoff,
-      sweep_params.Dmin, sweep_params.Dmax);
+      sweep_params);
 
 #ifdef GQMPS2_TIMING_MODE
   svd_timer.PrintElapsed();
@@ -314,6 +423,7 @@ double TwoSiteUpdate(
 #endif
 
   TenType *new_lblock, *new_rblock;
+  uint64_t new_lblock_hash, new_rblock_hash;
   bool update_block = true;
   switch (dir) {
     case 'r':
@@ -326,24 +436,13 @@ double TwoSiteUpdate(
       mps[lsite_idx] = svd_res.u;
       delete mps[rsite_idx];
       mps[rsite_idx] = Contract(*svd_res.s, *svd_res.v, {{1}, {0}});
+      if (pbond_s != nullptr) { *pbond_s = new DGQTensor(*svd_res.s); }
       delete svd_res.s;
       delete svd_res.v;
 
-      if (i == 0) {
-        new_lblock = Contract(*mps[i], *mpo[i], {{0}, {0}});
-        auto temp_new_lblock = Contract(
-                                   *new_lblock, Dag(*mps[i]),
-                                   {{2}, {0}});
-        delete new_lblock;
-        new_lblock = temp_new_lblock;
-      } else if (i != N-2) {
-        new_lblock = Contract(*lblocks[i], *mps[i], {{0}, {0}});
-        auto temp_new_lblock = Contract(*new_lblock, *mpo[i], {{0, 2}, {0, 1}});
-        delete new_lblock;
-        new_lblock = temp_new_lblock;
-        temp_new_lblock = Contract(*new_lblock, Dag(*mps[i]), {{0, 2}, {0, 1}});
-        delete new_lblock;
-        new_lblock = temp_new_lblock;
+      if (i != N-2) {
+        new_lblock = GrowLBlock(*eff_ham[0], *mps[i], *mpo[i], i);
+        new_lblock_hash = blk_mgr.GrowHash('l', i, *mps[i]);
       } else {
         update_block = false;
       }
@@ -353,24 +452,10 @@ double TwoSiteUpdate(
       dump_blk_timer.Restart();
 #endif
 
-      if (sweep_params.FileIO) {
-        if (update_block) {
-          auto target_blk_len = i+1;
-          lblocks[target_blk_len] = new_lblock;
-          auto target_blk_file = GenBlockFileName("l", target_blk_len);
-          WriteGQTensorTOFile(*new_lblock, target_blk_file);
-          delete eff_ham[0];
-          delete eff_ham[3];
-        } else {
-          delete eff_ham[0];
-        }
-      } else {
-        if (update_block) {
-          auto target_blk_len = i+1;
-          delete lblocks[target_blk_len];
-          lblocks[target_blk_len] = new_lblock;
-        }
+      if (update_block) {
+        blk_mgr.Put('l', i+1, new_lblock, new_lblock_hash);
       }
+      blk_mgr.Drop('r', rblock_len);
 
 #ifdef GQMPS2_TIMING_MODE
       dump_blk_timer.PrintElapsed();
@@ -385,24 +470,15 @@ double TwoSiteUpdate(
 
       delete mps[lsite_idx];
       mps[lsite_idx] = Contract(*svd_res.u, *svd_res.s, us_ctrct_axes);
+      if (pbond_s != nullptr) { *pbond_s = new DGQTensor(*svd_res.s); }
       delete svd_res.u;
       delete svd_res.s;
       delete mps[rsite_idx];
       mps[rsite_idx] = svd_res.v;
 
-      if (i == N-1) {
-        new_rblock = Contract(*mps[i], *mpo[i], {{1}, {0}});
-        auto temp_new_rblock = Contract(*new_rblock, Dag(*mps[i]), {{2}, {1}});
-        delete new_rblock;
-        new_rblock = temp_new_rblock;
-      } else if (i != 1) {
-        new_rblock = Contract(*mps[i], *eff_ham[3], {{2}, {0}});
-        auto temp_new_rblock = Contract(*new_rblock, *mpo[i], {{1, 2}, {1, 3}});
-        delete new_rblock;
-        new_rblock = temp_new_rblock;
-        temp_new_rblock = Contract(*new_rblock, Dag(*mps[i]), {{3, 1}, {1, 2}});
-        delete new_rblock;
-        new_rblock = temp_new_rblock;
+      if (i != 1) {
+        new_rblock = GrowRBlock(*eff_ham[3], *mps[i], *mpo[i], N-i-1);
+        new_rblock_hash = blk_mgr.GrowHash('r', N-i-1, *mps[i]);
       } else {
         update_block = false;
       }
@@ -412,24 +488,10 @@ double TwoSiteUpdate(
       dump_blk_timer.Restart();
 #endif
 
-      if (sweep_params.FileIO) {
-        if (update_block) {
-          auto target_blk_len = N-i;
-          rblocks[target_blk_len] = new_rblock;
-          auto target_blk_file = GenBlockFileName("r", target_blk_len);
-          WriteGQTensorTOFile(*new_rblock, target_blk_file);
-          delete eff_ham[0];
-          delete eff_ham[3];
-        } else {
-          delete eff_ham[3];
-        }
-      } else {
-        if (update_block) {
-          auto target_blk_len = N-i;
-          delete rblocks[target_blk_len];
-          rblocks[target_blk_len] = new_rblock;
-        }
+      if (update_block) {
+        blk_mgr.Put('r', N-i, new_rblock, new_rblock_hash);
       }
+      blk_mgr.Drop('l', lblock_len);
 
 #ifdef GQMPS2_TIMING_MODE
       dump_blk_timer.PrintElapsed();
@@ -437,12 +499,21 @@ double TwoSiteUpdate(
 
   }
 
+  // Spill and prefetch the blocks for the next update.
+  blk_mgr.ArrangeAfter(i, dir);
+
+  // Release the temporaries of the update.
+  update_arena.Reset();
+
 #ifdef GQMPS2_TIMING_MODE
   blk_update_timer.PrintElapsed();
 #endif
 
+  // Written at once since the segments of the real-space parallel sweeps
+  // update concurrently.
   auto update_elapsed_time = update_timer.Elapsed();
-  std::cout << "Site " << std::setw(4) << i
+  std::ostringstream line;
+  line << "Site " << std::setw(4) << i
             << " E0 = " << std::setw(20) << std::setprecision(kLanczEnergyOutputPrecision) << std::fixed << lancz_res.gs_eng
             << " TruncErr = " << std::setprecision(2) << std::scientific << svd_res.trunc_err << std::fixed
             << " D = " << std::setw(5) << svd_res.D
@@ -450,7 +521,14 @@ double TwoSiteUpdate(
             << " LanczT = " << std::setw(8) << lancz_elapsed_time
             << " TotT = " << std::setw(8) << update_elapsed_time
             << " S = " << std::setw(10) << std::setprecision(7) << ee;
-  std::cout << std::scientific << std::endl;
+  if (!sweep_params.LanczParams.store_bases) {
+    line << " Replay = " << std::setw(3) << lancz_res.replay_iters
+              << " ReplayT = " << std::setw(8) << std::setprecision(3)
+              << lancz_res.replay_time;
+  }
+  line << std::scientific << "\n";
+  std::cout << line.str() << std::flush;
+  trunc_err = svd_res.trunc_err;
   return lancz_res.gs_eng;
 }
 } /* gqmps2 */ 
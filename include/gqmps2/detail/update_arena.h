@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-17 19:20
+*
+* Description: GraceQ/MPS2 project. Bump allocator for the temporaries of one site update.
+*/
+#ifndef GQMPS2_DETAIL_UPDATE_ARENA_H
+#define GQMPS2_DETAIL_UPDATE_ARENA_H
+
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+
+namespace gqmps2 {
+
+
+const size_t kUpdateArenaAlign = 64;
+
+const size_t kUpdateArenaMinChunkSize = 1024 * 1024;
+
+
+struct UpdateArenaStats {
+  size_t served_bytes = 0;      // Bytes served since the arena was created.
+  size_t peak_bytes = 0;        // Peak usage in one update.
+  size_t chunk_allocs = 0;      // Chunks requested from the system.
+  size_t resets = 0;
+};
+
+
+// Temporaries of one site update are served from large chunks by bumping a
+// pointer and are released all together by Reset at the end of the update.
+// After a reset the chunks are merged into one chunk with the peak usage, thus
+// the following updates with similar sizes make no system allocation.
+class UpdateArena {
+public:
+  UpdateArena(void) = default;
+
+  UpdateArena(const UpdateArena &) = delete;
+  UpdateArena &operator=(const UpdateArena &) = delete;
+
+  ~UpdateArena(void) { FreeChunks_(); }
+
+  void *Allocate(const size_t bytes) {
+    auto aligned_bytes = RoundUp_(std::max(bytes, size_t(1)));
+    if (chunks_.empty() ||
+        chunks_.back().used + aligned_bytes > chunks_.back().size) {
+      NewChunk_(aligned_bytes);
+    }
+    auto &chunk = chunks_.back();
+    auto ptr = chunk.data + chunk.used;
+    chunk.used += aligned_bytes;
+    used_bytes_ += aligned_bytes;
+    stats_.served_bytes += bytes;
+    stats_.peak_bytes = std::max(stats_.peak_bytes, used_bytes_);
+    return ptr;
+  }
+
+  template <typename T>
+  T *Allocate(const size_t n) {
+    return static_cast<T *>(Allocate(n * sizeof(T)));
+  }
+
+  // Release all the temporaries.
+  void Reset(void) {
+    if (chunks_.size() > 1) {
+      size_t total_size = 0;
+      for (auto &chunk : chunks_) { total_size += chunk.size; }
+      FreeChunks_();
+      NewChunk_(total_size);
+    }
+    if (!chunks_.empty()) { chunks_.back().used = 0; }
+    used_bytes_ = 0;
+    ++stats_.resets;
+  }
+
+  size_t UsedBytes(void) const { return used_bytes_; }
+
+  const UpdateArenaStats &Stats(void) const { return stats_; }
+
+private:
+  struct Chunk {
+    char *data;
+    size_t size;
+    size_t used;
+  };
+
+  static size_t RoundUp_(const size_t size) {
+    return ((size + kUpdateArenaAlign - 1) / kUpdateArenaAlign) *
+           kUpdateArenaAlign;
+  }
+
+  void NewChunk_(const size_t min_size) {
+    auto size = RoundUp_(std::max(min_size, kUpdateArenaMinChunkSize));
+    if (!chunks_.empty()) { size = std::max(size, 2 * chunks_.back().size); }
+    void *data;
+    if (posix_memalign(&data, kUpdateArenaAlign, size) != 0) {
+      std::cout << "Unable to allocate " << size << " bytes for update arena"
+                << std::endl;
+      exit(1);
+    }
+    chunks_.push_back({static_cast<char *>(data), size, 0});
+    ++stats_.chunk_allocs;
+  }
+
+  void FreeChunks_(void) {
+    for (auto &chunk : chunks_) { free(chunk.data); }
+    chunks_.clear();
+  }
+
+  std::vector<Chunk> chunks_;
+  size_t used_bytes_ = 0;
+  UpdateArenaStats stats_;
+};
+
+
+// STL allocator on an update arena. The memory is only released by the reset
+// of the arena.
+template <typename T>
+class UpdateArenaAllocator {
+public:
+  using value_type = T;
+
+  UpdateArenaAllocator(UpdateArena *parena) : parena_(parena) {}
+
+  template <typename U>
+  UpdateArenaAllocator(const UpdateArenaAllocator<U> &other) :
+      parena_(other.parena_) {}
+
+  T *allocate(const size_t n) { return parena_->Allocate<T>(n); }
+
+  void deallocate(T *, const size_t) {}
+
+  template <typename U>
+  bool operator==(const UpdateArenaAllocator<U> &other) const {
+    return parena_ == other.parena_;
+  }
+
+  template <typename U>
+  bool operator!=(const UpdateArenaAllocator<U> &other) const {
+    return parena_ != other.parena_;
+  }
+
+  UpdateArena *parena_;
+};
+
+
+template <typename T>
+using UpdateArenaVector = std::vector<T, UpdateArenaAllocator<T>>;
+} /* gqmps2 */
+#endif /* ifndef GQMPS2_DETAIL_UPDATE_ARENA_H */
@@ -12,11 +12,19 @@
 #include "gqten/gqten.h"
 #include "gqmps2/detail/mpogen/fsm.h"
 #include "gqmps2/detail/mpogen/coef_op_alg.h"
+#include "gqmps2/detail/update_arena.h"
+#include "gqmps2/detail/hash.h"
+
+#ifdef GQMPS2_MPI
+#include "mpi.h"
+#endif
 
 #include <string>
 #include <vector>
 #include <iostream>
 #include <fstream>
+#include <cstdio>
+#include <cstdint>
 
 #include <sys/stat.h>
 
@@ -33,18 +41,37 @@ const std::string kCaseParamsJsonObjName = "CaseParams";
 const std::string kMpsPath = "mps";
 const std::string kRuntimeTempPath = ".temp";
 const std::string kBlockFileBaseName = "block";
+const std::string kBlockArenaFileName = "blocks.arena";
+const std::string kCheckpointFileName = "checkpoint";
+const std::string kCheckpointMpsTenBaseName = "ckpt_mps_ten";
 const std::string kMpsTenBaseName = "mps_ten";
+const std::string kMpoCachePath = "mpo_cache";
+const std::string kMpoTenBaseName = "mpo_ten";
 
 const char kTwoSiteAlgoWorkflowInitial = 'i';
 const char kTwoSiteAlgoWorkflowRestart = 'r';
 const char kTwoSiteAlgoWorkflowContinue = 'c';
 
+const char kBlockCodecNone = 'n';
+const char kBlockCodecShuffleRle = 's';
+
+const char kEigenSolverLanczos = 'l';
+const char kEigenSolverDavidson = 'd';
+
+const char kSvdFull = 'f';
+const char kSvdRandomized = 'r';
+const char kSvdDensityMatrix = 'm';
+const char kSvdAuto = 'a';
+
 const int kLanczEnergyOutputPrecision = 16;
 
 template <typename TenElemType>
 const GQTensor<TenElemType> kNullOperator = GQTensor<TenElemType>();    // C++14
 
 
+struct SweepStage;
+
+
 // Simulation case parameter parser basic class.
 class CaseParamsParserBasic {
 public:
@@ -81,6 +108,10 @@ public:
     return case_params[item].get<bool>();
   }
 
+  // Parse a sweep schedule given as an array of objects with keys "Dmax",
+  // "Cutoff", "LanczErr" and "MaxLanczIter", one object for each stage.
+  std::vector<SweepStage> ParseSweepSchedule(const std::string &item);
+
   json case_params;
 
 private:
@@ -88,11 +119,29 @@ private:
 };
 
 
+// Hash of the operators for the label convertor of the MPO generator.
+template <typename TenElemType>
+struct GQTensorLabelHash {
+  size_t operator()(const GQTensor<TenElemType> &) const;
+};
+
+
+// Non-zero elements of an operator realized by the MPO generator.
+template <typename TenElemType>
+struct MpoOpElems {
+  std::vector<long> bpb_coors;
+  std::vector<long> tpb_coors;
+  std::vector<TenElemType> elems;
+};
+
+
 // MPO generator.
 template <typename TenElemType>
 class MPOGenerator {
 public:
-  MPOGenerator(const long, const Index &, const QN &);
+  // The MPO tensors are realized by threads threads, 0 for the hardware
+  // concurrency.
+  MPOGenerator(const long, const Index &, const QN &, const long threads = 0);
 
   using TenElemVec = std::vector<TenElemType>;
   using GQTensorT = GQTensor<TenElemType>;
@@ -120,6 +169,21 @@ public:
 
   PGQTensorVec Gen(void);
 
+  // Generate the MPO, then compress it numerically by CompressMpo.
+  PGQTensorVec Gen(const double compress_cutoff);
+
+  // Content hash of the physical bond, the zero divergence, the registered
+  // operators, coefficients and terms. It does not change between the runs.
+  uint64_t Hash(void);
+
+  // Load the MPO from the cache directory if it holds the MPO of the same
+  // hash, otherwise generate it by Gen and save it there.
+  PGQTensorVec GenCached(const std::string &cache_path = kMpoCachePath);
+
+  PGQTensorVec GenCached(
+      const double compress_cutoff,
+      const std::string &cache_path = kMpoCachePath);
+
 private:
   long N_;
   Index pb_in_;
@@ -128,7 +192,10 @@ private:
   GQTensorT id_op_;
   FSM fsm_;
   LabelConvertor<TenElemType> coef_label_convertor_;
-  LabelConvertor<GQTensorT> op_label_convertor_;
+  LabelConvertor<GQTensorT, GQTensorLabelHash<TenElemType>>
+      op_label_convertor_;
+  long threads_;
+  uint64_t terms_hash_;
 
   GQTensorT GenIdOpTen_(const Index &);
 
@@ -142,21 +209,99 @@ private:
   GQTensorT *HeadMpoTenRepr2MpoTen_(
       const SparOpReprMat &,
       const Index &,
-      const TenElemVec &, const GQTensorVec &);
+      const std::vector<size_t> &,
+      const std::vector<MpoOpElems<TenElemType>> &);
 
   GQTensorT *TailMpoTenRepr2MpoTen_(
       const SparOpReprMat &,
       const Index &,
-      const TenElemVec &, const GQTensorVec &);
+      const std::vector<size_t> &,
+      const std::vector<MpoOpElems<TenElemType>> &);
 
   GQTensorT *CentMpoTenRepr2MpoTen_(
       const SparOpReprMat &,
       const Index &,
       const Index &,
-      const TenElemVec &, const GQTensorVec &);
+      const std::vector<size_t> &,
+      const std::vector<MpoOpElems<TenElemType>> &);
+};
+
+// Generator of translation invariant MPOs from the terms of a unit cell of cell
+// sites. The site indexes of a term are counted from the origin of the cell,
+// the first one is in the cell. The terms are repeated on all the cells of the
+// chain and the ones crossing the open boundary are dropped. The MPO of a short
+// chain is generated, and its bulk cell which repeats is shared by all the bulk
+// cells of the chain. Thus the MPO must be freed by MpoFree and can not be
+// compressed by CompressMpo.
+template <typename TenElemType>
+class TransInvMPOGenerator {
+public:
+  TransInvMPOGenerator(
+      const long cell, const Index &, const QN &, const long threads = 0);
+
+  using GQTensorT = GQTensor<TenElemType>;
+  using GQTensorVec = std::vector<GQTensorT>;
+  using PGQTensorVec = std::vector<GQTensorT *>;
+
+  void AddTerm(
+      const TenElemType,
+      const GQTensorVec &,
+      const std::vector<long> &,
+      const GQTensorVec &);
+
+  void AddTerm(
+      const TenElemType,
+      const GQTensorVec &,
+      const std::vector<long> &,
+      const GQTensorT &inst_op=kNullOperator<TenElemType>);
+
+  void AddTerm(
+      const TenElemType,
+      const GQTensorT &,
+      const long);
+
+  // MPO of N sites.
+  PGQTensorVec Gen(const long N);
+
+private:
+  struct Term {
+    TenElemType coef;
+    GQTensorVec phys_ops;
+    std::vector<long> idxs;
+    GQTensorVec inst_ops;
+  };
+
+  long cell_;
+  Index pb_out_;
+  QN zero_div_;
+  long threads_;
+  GQTensorT id_op_;
+  std::vector<Term> terms_;
+
+  PGQTensorVec GenChain_(const long);
 };
 
 
+// Free the MPO tensors, the ones shared by several sites are freed once.
+template <typename TenType>
+void MpoFree(std::vector<TenType *> &);
+
+
+// Numerical compression of the MPO by SVD sweeps with the relative truncation
+// error cutoff. The bond dimensions before and after are printed. The sites
+// must not share tensors.
+template <typename TenElemType>
+void CompressMpo(std::vector<GQTensor<TenElemType> *> &, const double);
+
+// MPO I/O in the tensor binary file format. LoadMpo returns false if any
+// tensor file is missing.
+template <typename TenType>
+void DumpMpo(const std::vector<TenType *> &, const std::string &);
+
+template <typename TenType>
+bool LoadMpo(std::vector<TenType *> &, const std::string &);
+
+
 // Lanczos Ground state search algorithm.
 struct LanczosParams {
   LanczosParams(double err, long max_iter) :
@@ -164,10 +309,33 @@ struct LanczosParams {
   LanczosParams(double err) : LanczosParams(err, 200) {}
   LanczosParams(void) : LanczosParams(1.0E-7, 200) {}
   LanczosParams(const LanczosParams &lancz_params) :
-      LanczosParams(lancz_params.error, lancz_params.max_iterations) {}
+      LanczosParams(lancz_params.error, lancz_params.max_iterations) {
+    store_bases = lancz_params.store_bases;
+    solver = lancz_params.solver;
+    davidson_max_bases = lancz_params.davidson_max_bases;
+    block_lanczos_max_bases = lancz_params.block_lanczos_max_bases;
+    matvec_threads = lancz_params.matvec_threads;
+  }
 
   double error;
   long max_iterations;
+  // Keep all the Lanczos bases. If false, only the last two bases are kept
+  // and the ground state is rebuilt by replaying the iterations, which costs
+  // about the same number of extra matrix-vector multiplications.
+  bool store_bases = true;
+  // Eigensolver used by the sweeps. kEigenSolverDavidson: Davidson solver
+  // preconditioned by the diagonal of the effective Hamiltonian.
+  char solver = kEigenSolverLanczos;
+  // The Davidson iteration restarts from the current ground state when the
+  // number of the bases reaches it.
+  long davidson_max_bases = 20;
+  // The block Lanczos iteration for k states restarts from the k lowest Ritz
+  // vectors when the number of the bases reaches it, at least 3k.
+  long block_lanczos_max_bases = 60;
+  // Threads of the matrix-vector multiplications. The blocks of each
+  // contraction result are distributed to the threads, each runs its block
+  // products with one MKL thread. 1 for the MKL threading only.
+  long matvec_threads = 1;
 };
 
 template <typename TenElemType>
@@ -175,16 +343,57 @@ struct LanczosRes {
   long iters;
   double gs_eng;
   GQTensor<TenElemType> *gs_vec;
+  long replay_iters = 0;      // Matrix-vector multiplications of the replay.
+  double replay_time = 0.0;
 };
 
 template <typename TenElemType>
 LanczosRes<TenElemType> LanczosSolver(
     const std::vector<GQTensor<TenElemType> *> &, GQTensor<TenElemType> *,
     const LanczosParams &,
-    const std::string &);
+    const std::string &,
+    UpdateArena *parena = nullptr);
+
+template <typename TenElemType>
+LanczosRes<TenElemType> DavidsonSolver(
+    const std::vector<GQTensor<TenElemType> *> &, GQTensor<TenElemType> *,
+    const LanczosParams &,
+    const std::string &,
+    UpdateArena *parena = nullptr);
+
+// Lowest eigenstates found by the block Lanczos solver, in ascending order of
+// the energies.
+template <typename TenElemType>
+struct BlockLanczosRes {
+  long iters;
+  std::vector<double> engs;
+  std::vector<GQTensor<TenElemType> *> vecs;
+};
+
+template <typename TenElemType>
+BlockLanczosRes<TenElemType> BlockLanczosSolver(
+    const std::vector<GQTensor<TenElemType> *> &,
+    std::vector<GQTensor<TenElemType> *> &,
+    const LanczosParams &,
+    const std::string &,
+    UpdateArena *parena = nullptr);
 
 
 // Two sites update algorithm.
+// Parameters of the sweeps from a given one until the next stage.
+struct SweepStage {
+  SweepStage(
+      const long dmax, const double cutoff,
+      const double lancz_err, const long max_lancz_iter) :
+      Dmax(dmax), Cutoff(cutoff),
+      LanczErr(lancz_err), MaxLanczIter(max_lancz_iter) {}
+
+  long Dmax;
+  double Cutoff;
+  double LanczErr;
+  long MaxLanczIter;
+};
+
 struct SweepParams {
   SweepParams(
       const long sweeps,
@@ -206,6 +415,67 @@ struct SweepParams {
   char Workflow;
 
   LanczosParams LanczParams;
+
+  // Overlap the block file I/O with the Lanczos solver (only for FileIO mode).
+  bool AsyncFileIO = true;
+
+  // Memory budget of the environment blocks in GB (only for FileIO mode). The
+  // blocks which are used latest are spilled to disk when it is exceeded. The
+  // default 0 spills all the blocks which the current update does not need.
+  double MemBudget = 0.0;
+
+  // Codec of the blocks spilled to disk (only for FileIO mode).
+  // kBlockCodecShuffleRle: byte shuffle plus run-length coding.
+  char BlockCodec = kBlockCodecNone;
+
+  // Write a checkpoint every CheckpointInterval updates, 0 for no checkpoint.
+  // The checkpoints need the FileIO mode. The continue workflow resumes from
+  // the last checkpoint.
+  long CheckpointInterval = 0;
+
+  // Stop after MaxUpdates updates of this run as an interrupted job does, the
+  // checkpoint is kept for the continue workflow. 0 for no limit.
+  long MaxUpdates = 0;
+
+  // Mixing factor of the subspace expansion (only for the single-site
+  // algorithm), 0 for no expansion thus the bond dimensions are fixed.
+  double ExpansionAlpha = 1.0E-4;
+
+  // Decomposition of the optimized state. kSvdFull: full SVD of all the
+  // blocks by Svd. The others decompose the quantum number sectors in
+  // parallel and compute at most Dmax singular values in each sector,
+  // kSvdRandomized: randomized SVD with SvdOversampling extra vectors and
+  // SvdPowerIters power iterations, kSvdDensityMatrix: eigen decomposition of
+  // the density matrix of the smaller side, kSvdAuto: the density matrix if
+  // one side of the sector is much smaller, else the randomized SVD.
+  char SvdMethod = kSvdFull;
+  long SvdOversampling = 10;
+  long SvdPowerIters = 2;
+  // Threads of the sector decompositions, 0 for the hardware concurrency.
+  long SvdThreads = 0;
+
+  // Schedule of the sweeps. The sweep i uses the stage Schedule[i], the
+  // sweeps after the last stage use the last one. The Dmax, Cutoff and the
+  // Lanczos error and max iterations above are used if it is empty.
+  std::vector<SweepStage> Schedule;
+
+  // Stop once the energy changes less than EnergyConvTol and the largest
+  // truncation error changes less than TruncErrConvTol between two successive
+  // sweeps of the last stage of the Schedule. 0 for no early stop, or no check
+  // of the truncation error.
+  double EnergyConvTol = 0.0;
+  double TruncErrConvTol = 0.0;
+
+  // Split the chain into RealSpaceSegments segments which are swept by
+  // concurrent threads after the first serial sweep (only for the two-site
+  // algorithm without FileIO). 1 for the serial sweeps.
+  long RealSpaceSegments = 1;
+
+  // Number of the lowest eigenstates targeted by the multi-target algorithm
+  // and their weights in the state-averaged bases. Equal weights if
+  // TargetWeights is empty.
+  long Targets = 1;
+  std::vector<double> TargetWeights;
 };
 
 template <typename TenType>
@@ -214,6 +484,42 @@ double TwoSiteAlgorithm(
     const std::vector<TenType *> &,
     const SweepParams &);
 
+// Real-space parallel two sites update algorithm.
+template <typename TenType>
+double RealSpaceParallelTwoSiteAlgorithm(
+    std::vector<TenType *> &,
+    const std::vector<TenType *> &,
+    const SweepParams &);
+
+// Multi-target two sites update algorithm. The targets share the MPS and
+// have their own centers.
+template <typename TenType>
+std::vector<double> MultiTargetTwoSiteAlgorithm(
+    std::vector<TenType *> &,
+    const std::vector<TenType *> &,
+    const SweepParams &,
+    std::vector<TenType *> &);
+
+#ifdef GQMPS2_MPI
+// MPI real-space parallel two sites update algorithm. Each rank sweeps one
+// segment and holds only its own segment of the MPS, also in the end when the
+// MPS is in the right-canonical form with the center on the first site.
+template <typename TenType>
+double MpiRealSpaceParallelTwoSiteAlgorithm(
+    std::vector<TenType *> &,
+    const std::vector<TenType *> &,
+    const SweepParams &,
+    MPI_Comm);
+#endif
+
+
+// Single site update algorithm with subspace expansion.
+template <typename TenType>
+double SingleSiteAlgorithm(
+    std::vector<TenType *> &,
+    const std::vector<TenType *> &,
+    const SweepParams &);
+
 
 // MPS operations.
 template <typename TenType>
@@ -318,6 +624,14 @@ inline void ReadGQTensorFromFile(TenType * &rpt, const std::string &file) {
 }
 
 
+inline void RemoveFile(const std::string &file) {
+  if (std::remove(file.c_str())) {
+    std::cout << "Unable to delete " << file << std::endl;
+    exit(1);
+  }
+}
+
+
 inline bool IsPathExist(const std::string &path) {
   struct stat buffer;
   return (stat(path.c_str(), &buffer) == 0);
@@ -337,9 +651,26 @@ inline void CreatPath(const std::string &path) {
 
 
 // Implementation details
+#include "gqmps2/detail/ctrct_plan_impl.h"
 #include "gqmps2/detail/lanczos_impl.h"
+#include "gqmps2/detail/davidson_impl.h"
+#include "gqmps2/detail/block_lanczos_impl.h"
+#include "gqmps2/detail/trunc_svd_impl.h"
 #include "gqmps2/detail/mpogen/mpogen_impl.h"
+#include "gqmps2/detail/mpogen/trans_inv_mpogen_impl.h"
+#include "gqmps2/detail/mpogen/mpo_compress_impl.h"
+#include "gqmps2/detail/blk_io_impl.h"
+#include "gqmps2/detail/blk_mgr_impl.h"
+#include "gqmps2/detail/ckpt_impl.h"
+#include "gqmps2/detail/mpogen/mpo_cache_impl.h"
+#include "gqmps2/detail/sweep_sched_impl.h"
 #include "gqmps2/detail/two_site_algo_impl.h"
+#include "gqmps2/detail/real_space_parallel_impl.h"
+#include "gqmps2/detail/multi_target_algo_impl.h"
+#ifdef GQMPS2_MPI
+#include "gqmps2/detail/mpi_real_space_impl.h"
+#endif
+#include "gqmps2/detail/single_site_algo_impl.h"
 #include "gqmps2/detail/mps_ops_impl.h"
 #include "gqmps2/detail/mps_measu_impl.h"
 
@@ -0,0 +1,204 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-16 21:40
+*
+* Description: GraceQ/MPS2 project. Unittests for block arena.
+*/
+#include "gqmps2/detail/blk_arena.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstddef>
+
+#include "gtest/gtest.h"
+
+
+using namespace gqmps2;
+
+
+const std::string kTestArenaFile = "test_blocks.arena";
+
+
+std::vector<char> GenTestData(const size_t size, const char seed) {
+  std::vector<char> data(size);
+  for (size_t i = 0; i < size; ++i) { data[i] = char(seed + i % 97); }
+  return data;
+}
+
+
+std::vector<char> LoadTestData(BlockArena &arena, const std::string &name) {
+  std::vector<char> data;
+  arena.Load(
+      name,
+      [&data](const char *pdata, const size_t size) {
+        data.assign(pdata, pdata + size);
+      });
+  return data;
+}
+
+
+TEST(TestBlockArena, StoreAndLoad) {
+  BlockArena arena(kTestArenaFile, 8, false);
+  auto data1 = GenTestData(100, 'a');
+  auto data2 = GenTestData(10000, 'b');
+  arena.Store("rblock1", data1.data(), data1.size());
+  arena.Store("rblock2", data2.data(), data2.size());
+  EXPECT_TRUE(arena.Has("rblock1"));
+  EXPECT_TRUE(arena.Has("rblock2"));
+  EXPECT_FALSE(arena.Has("lblock1"));
+  EXPECT_EQ(LoadTestData(arena, "rblock1"), data1);
+  EXPECT_EQ(LoadTestData(arena, "rblock2"), data2);
+  EXPECT_EQ(arena.DataSize(), data1.size() + data2.size());
+
+  // Overwrite a block with a larger one.
+  auto data3 = GenTestData(100000, 'c');
+  arena.Store("rblock1", data3.data(), data3.size());
+  EXPECT_EQ(LoadTestData(arena, "rblock1"), data3);
+  EXPECT_EQ(LoadTestData(arena, "rblock2"), data2);
+
+  arena.Release("rblock2");
+  EXPECT_FALSE(arena.Has("rblock2"));
+
+  // Tags.
+  EXPECT_EQ(arena.Tag("rblock1"), 0U);
+  EXPECT_EQ(arena.Tag("rblock2"), 0U);
+  arena.Store("rblock1", data1.data(), data1.size(), 123);
+  EXPECT_EQ(arena.Tag("rblock1"), 123U);
+  EXPECT_EQ(LoadTestData(arena, "rblock1"), data1);
+  arena.Store("rblock1", data3.data(), data3.size());
+  EXPECT_EQ(arena.Tag("rblock1"), 0U);
+  EXPECT_EQ(arena.DataSize(), data3.size());
+  std::remove(kTestArenaFile.c_str());
+}
+
+
+// The data are written in place and the data handed to a loader stay valid
+// when the file grows meanwhile.
+TEST(TestBlockArena, InPlaceAccess) {
+  BlockArena arena(kTestArenaFile, 4, false);
+  auto data1 = GenTestData(3000, 'k');
+  arena.Store(
+      "rblock1", data1.size(),
+      [&data1](char *pdata, const size_t size) {
+        ASSERT_EQ(size, data1.size());
+        std::copy(data1.begin(), data1.end(), pdata);
+      },
+      7);
+  EXPECT_EQ(arena.Tag("rblock1"), 7U);
+  EXPECT_EQ(LoadTestData(arena, "rblock1"), data1);
+
+  auto file_size = arena.FileSize();
+  auto data2 = GenTestData(4 * file_size, 'l');
+  arena.Load(
+      "rblock1",
+      [&](const char *pdata, const size_t size) {
+        arena.Store("rblock2", data2.data(), data2.size());
+        EXPECT_EQ(std::vector<char>(pdata, pdata + size), data1);
+      });
+  EXPECT_GT(arena.FileSize(), file_size);
+  EXPECT_EQ(LoadTestData(arena, "rblock1"), data1);
+  EXPECT_EQ(LoadTestData(arena, "rblock2"), data2);
+  std::remove(kTestArenaFile.c_str());
+}
+
+
+TEST(TestBlockArena, SlotReuse) {
+  BlockArena arena(kTestArenaFile, 4, false);
+  auto data = GenTestData(50000, 'd');
+  arena.Store("lblock1", data.data(), data.size());
+  arena.Store("lblock2", data.data(), data.size());
+  auto file_size = arena.FileSize();
+  for (long i = 3; i < 20; ++i) {
+    arena.Release("lblock" + std::to_string(i-2));
+    auto name = "lblock" + std::to_string(i);
+    arena.Store(name, data.data(), data.size());
+    EXPECT_EQ(LoadTestData(arena, name), data);
+  }
+  EXPECT_EQ(arena.FileSize(), file_size);
+  std::remove(kTestArenaFile.c_str());
+}
+
+
+// The regions of the slot records which are taken by larger blocks are
+// reused, also after the arena is reopened.
+TEST(TestBlockArena, RegionReuse) {
+  auto small_data = GenTestData(8000, 'g');
+  auto large_data = GenTestData(100000, 'h');
+  auto medium_data = GenTestData(20000, 'i');
+  size_t data_end;
+  {
+    BlockArena arena(kTestArenaFile, 2, false);
+    arena.Store("lblock1", small_data.data(), small_data.size());
+    arena.Store("lblock2", small_data.data(), small_data.size());
+    arena.Release("lblock1");
+    arena.Release("lblock2");
+    // Both released regions are too small, the first one becomes free.
+    arena.Store("lblock3", large_data.data(), large_data.size());
+    data_end = arena.DataEnd();
+  }
+  {
+    BlockArena arena(kTestArenaFile, 2, true);
+    // The second region is merged with the free one before it.
+    arena.Store("lblock4", medium_data.data(), medium_data.size());
+    EXPECT_EQ(arena.DataEnd(), data_end);
+    EXPECT_EQ(LoadTestData(arena, "lblock3"), large_data);
+    EXPECT_EQ(LoadTestData(arena, "lblock4"), medium_data);
+
+    // The region at the end of the data shortens it.
+    auto huge_data = GenTestData(300000, 'j');
+    arena.Release("lblock3");
+    arena.Release("lblock4");
+    arena.Store("lblock5", small_data.data(), small_data.size());
+    arena.Store("lblock6", huge_data.data(), huge_data.size());
+    EXPECT_EQ(
+        arena.DataEnd(),
+        data_end - BlockArenaRoundUp(large_data.size() * 9 / 8) +
+        BlockArenaRoundUp(huge_data.size() * 9 / 8));
+    EXPECT_EQ(LoadTestData(arena, "lblock5"), small_data);
+    EXPECT_EQ(LoadTestData(arena, "lblock6"), huge_data);
+  }
+  std::remove(kTestArenaFile.c_str());
+}
+
+
+TEST(TestBlockArena, Reopen) {
+  auto data1 = GenTestData(3000, 'e');
+  auto data2 = GenTestData(5000, 'f');
+  {
+    BlockArena arena(kTestArenaFile, 8, false);
+    arena.Store("rblock0", data1.data(), data1.size(), 1);
+    arena.Store("lblock0", data2.data(), data2.size(), 2);
+  }
+  {
+    BlockArena arena(kTestArenaFile, 8, true);
+    EXPECT_EQ(LoadTestData(arena, "rblock0"), data1);
+    EXPECT_EQ(LoadTestData(arena, "lblock0"), data2);
+    EXPECT_EQ(arena.Tag("rblock0"), 1U);
+    EXPECT_EQ(arena.Tag("lblock0"), 2U);
+  }
+  {
+    // Different slot table layout.
+    BlockArena arena(kTestArenaFile, 16, true);
+    EXPECT_FALSE(arena.Has("rblock0"));
+  }
+  {
+    BlockArena arena(kTestArenaFile, 8, false);
+    EXPECT_FALSE(arena.Has("rblock0"));
+    EXPECT_FALSE(arena.Has("lblock0"));
+    arena.Store("rblock0", data1.data(), data1.size(), 1);
+  }
+  {
+    // Another version.
+    std::FILE *pfile = std::fopen(kTestArenaFile.c_str(), "r+b");
+    uint64_t version = kBlockArenaVersion + 1;
+    std::fseek(pfile, offsetof(BlockArenaHead, version), SEEK_SET);
+    std::fwrite(&version, sizeof(version), 1, pfile);
+    std::fclose(pfile);
+    BlockArena arena(kTestArenaFile, 8, true);
+    EXPECT_FALSE(arena.Has("rblock0"));
+  }
+  std::remove(kTestArenaFile.c_str());
+}
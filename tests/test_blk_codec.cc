@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-16 23:40
+*
+* Description: GraceQ/MPS2 project. Unittests for block codec.
+*/
+#include "gqmps2/detail/blk_codec.h"
+
+#include <string>
+#include <vector>
+#include <random>
+
+#include "gtest/gtest.h"
+
+
+using namespace gqmps2;
+
+
+void RunTestBlockCodecCase(const std::string &data) {
+  auto encoded = EncodeBlock(data.data(), data.size());
+  EXPECT_TRUE(IsEncodedBlock(encoded.data(), encoded.size()));
+  EXPECT_EQ(EncodedBlockRawSize(encoded.data()), data.size());
+  auto decoded = DecodeBlock(encoded.data(), encoded.size());
+  EXPECT_EQ(decoded, data);
+}
+
+
+std::string GenTestDoubles(const std::vector<double> &elems) {
+  return std::string(
+             reinterpret_cast<const char *>(elems.data()),
+             elems.size() * sizeof(double));
+}
+
+
+TEST(TestBlockCodec, Shuffle) {
+  std::string data("abcdefgh12345678xyz");
+  std::string shuffled(data.size(), '\0');
+  BlockShuffle(data.data(), &shuffled[0], data.size());
+  EXPECT_EQ(shuffled, "a1b2c3d4e5f6g7h8xyz");
+  std::string unshuffled(data.size(), '\0');
+  BlockUnshuffle(shuffled.data(), &unshuffled[0], shuffled.size());
+  EXPECT_EQ(unshuffled, data);
+}
+
+
+TEST(TestBlockCodec, RoundTrip) {
+  RunTestBlockCodecCase("");
+  RunTestBlockCodecCase("a");
+  RunTestBlockCodecCase("aaa");
+  RunTestBlockCodecCase(std::string(1000, 'x') + "yz" + std::string(7, '\0'));
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  std::vector<double> elems(10001);
+  for (auto &elem : elems) { elem = dist(gen); }
+  RunTestBlockCodecCase(GenTestDoubles(elems) + "tail");
+}
+
+
+TEST(TestBlockCodec, Ratio) {
+  // Block with many zero sectors.
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+  std::vector<double> elems(100000, 0.0);
+  for (size_t i = 0; i < elems.size(); ++i) {
+    if ((i / 1000) % 3 == 0) { elems[i] = dist(gen); }
+  }
+  auto data = GenTestDoubles(elems);
+  auto encoded = EncodeBlock(data.data(), data.size());
+  EXPECT_LT(encoded.size(), data.size() / 2);
+  EXPECT_EQ(DecodeBlock(encoded.data(), encoded.size()), data);
+
+  // Incompressible data grow only a little.
+  for (auto &elem : elems) { elem = dist(gen); }
+  data = GenTestDoubles(elems);
+  encoded = EncodeBlock(data.data(), data.size());
+  EXPECT_LT(
+      encoded.size(),
+      data.size() + data.size() / 64 + kBlockCodecHeadSize);
+}
@@ -9,6 +9,7 @@
 #include "gtest/gtest.h"
 
 #include <string>
+#include <vector>
 
 
 using namespace gqmps2;
@@ -26,6 +27,7 @@ struct CustomCaseParamsParser : public CaseParamsParserBasic {
     case_char = ParseChar("Char");
     case_str = ParseStr("String");
     case_bool = ParseBool("Boolean");
+    case_schedule = ParseSweepSchedule("Schedule");
   }
 
   int case_int;
@@ -33,6 +35,7 @@ struct CustomCaseParamsParser : public CaseParamsParserBasic {
   char case_char;
   std::string case_str;
   bool case_bool;
+  std::vector<SweepStage> case_schedule;
 };
 
 
@@ -43,6 +46,15 @@ TEST(TestCaseParamsParser, Case1) {
   EXPECT_EQ(params.case_char, 'c');
   EXPECT_EQ(params.case_str, "string");
   EXPECT_EQ(params.case_bool, false);
+  ASSERT_EQ(params.case_schedule.size(), 2);
+  EXPECT_EQ(params.case_schedule[0].Dmax, 100);
+  EXPECT_DOUBLE_EQ(params.case_schedule[0].Cutoff, 1.0E-6);
+  EXPECT_DOUBLE_EQ(params.case_schedule[0].LanczErr, 1.0E-6);
+  EXPECT_EQ(params.case_schedule[0].MaxLanczIter, 50);
+  EXPECT_EQ(params.case_schedule[1].Dmax, 400);
+  EXPECT_DOUBLE_EQ(params.case_schedule[1].Cutoff, 1.0E-9);
+  EXPECT_DOUBLE_EQ(params.case_schedule[1].LanczErr, 1.0E-9);
+  EXPECT_EQ(params.case_schedule[1].MaxLanczIter, 200);
 }
 
 
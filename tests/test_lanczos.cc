@@ -46,7 +46,12 @@ void RunTestCentLanczosSolverCase(
     GQTensor<TenElemType> *pinit_state,
     const LanczosParams &lanczos_params) {
   std::cout << "\n";
-  auto lancz_res = LanczosSolver(
+  auto lancz_res = (lanczos_params.solver == kEigenSolverDavidson) ?
+                   DavidsonSolver(
+                       eff_ham, pinit_state,
+                       lanczos_params,
+                       "cent") :
+                   LanczosSolver(
                        eff_ham, pinit_state,
                        lanczos_params,
                        "cent");
@@ -85,6 +90,47 @@ void RunTestCentLanczosSolverCase(
 }
 
 
+template <typename TenElemType>
+void RunTestCentBlockLanczosSolverCase(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    std::vector<GQTensor<TenElemType> *> &init_states,
+    const LanczosParams &lanczos_params) {
+  std::cout << "\n";
+  long k = init_states.size();
+  auto lancz_res = BlockLanczosSolver(
+                       eff_ham, init_states,
+                       lanczos_params,
+                       "cent");
+
+  auto eff_ham_ten = Contract(*eff_ham[0], *eff_ham[1], {{1}, {0}});
+  InplaceContract(eff_ham_ten, *eff_ham[2], {{4}, {0}});
+  InplaceContract(eff_ham_ten, *eff_ham[3], {{6}, {1}});
+  eff_ham_ten->Transpose({0, 2, 4, 6, 1, 3, 5, 7});
+  assert(eff_ham_ten->cblocks().size() == 1);
+  auto dense_mat = eff_ham_ten->blocks()[0]->data();
+  auto dense_mat_dim = D * d * d * D;
+  auto w = new double [dense_mat_dim];
+  LapackeSyev(
+      LAPACK_ROW_MAJOR, 'N', 'U',
+      dense_mat_dim, dense_mat, dense_mat_dim, w);
+
+  ASSERT_EQ(long(lancz_res.engs.size()), k);
+  for (long i = 0; i < k; ++i) {
+    EXPECT_NEAR(lancz_res.engs[i], w[i], 1.0E-8);
+    for (long j = 0; j < k; ++j) {
+      auto overlap = Contract(
+                         *lancz_res.vecs[i], Dag(*lancz_res.vecs[j]),
+                         {{0, 1, 2, 3}, {0, 1, 2, 3}});
+      EXPECT_NEAR(std::abs(overlap->scalar), (i == j) ? 1.0 : 0.0, 1.0E-8);
+      delete overlap;
+    }
+  }
+  for (auto pvec : lancz_res.vecs) { delete pvec; }
+  delete eff_ham_ten;
+  delete[] w;
+}
+
+
 TEST_F(TestLanczos, TestCentLanczosSolver) {
   // Tensor with double elements.
   auto dlblock = DGQTensor({idx_Dout, idx_dh, idx_Din});
@@ -133,6 +179,95 @@ TEST_F(TestLanczos, TestCentLanczosSolver) {
       pdinit_state,
       lanczos_params2);
 
+  // Memory-lean Lanczos solver gives the same ground state.
+  pdinit_state = new DGQTensor({idx_Din, idx_dout, idx_dout, idx_Dout});
+  srand(0);
+  pdinit_state->Random(QN({QNNameVal("Sz", 0)}));
+  auto pdinit_state2 = new DGQTensor(*pdinit_state);
+  auto lancz_res = LanczosSolver(
+                       {&dlblock, &dlsite, &drsite, &drblock},
+                       pdinit_state,
+                       lanczos_params,
+                       "cent");
+  LanczosParams lean_lanczos_params(1.0E-9);
+  lean_lanczos_params.store_bases = false;
+  auto lean_lancz_res = LanczosSolver(
+                            {&dlblock, &dlsite, &drsite, &drblock},
+                            pdinit_state2,
+                            lean_lanczos_params,
+                            "cent");
+  EXPECT_EQ(lean_lancz_res.iters, lancz_res.iters);
+  EXPECT_EQ(lean_lancz_res.replay_iters, lean_lancz_res.iters);
+  EXPECT_NEAR(lean_lancz_res.gs_eng, lancz_res.gs_eng, 1.0E-12);
+  auto overlap = Contract(
+                     *lean_lancz_res.gs_vec, Dag(*lancz_res.gs_vec),
+                     {{0, 1, 2, 3}, {0, 1, 2, 3}});
+  EXPECT_NEAR(overlap->scalar, 1.0, 1.0E-10);
+  delete overlap;
+  delete lancz_res.gs_vec;
+  delete lean_lancz_res.gs_vec;
+
+  // Davidson solver.
+  pdinit_state = new DGQTensor({idx_Din, idx_dout, idx_dout, idx_Dout});
+  srand(0);
+  pdinit_state->Random(QN({QNNameVal("Sz", 0)}));
+  LanczosParams davidson_params(1.0E-12);
+  davidson_params.solver = kEigenSolverDavidson;
+  RunTestCentLanczosSolverCase(
+      {&dlblock, &dlsite, &drsite, &drblock},
+      pdinit_state,
+      davidson_params);
+
+  // Davidson solver with restarts.
+  pdinit_state = new DGQTensor({idx_Din, idx_dout, idx_dout, idx_Dout});
+  srand(0);
+  pdinit_state->Random(QN({QNNameVal("Sz", 0)}));
+  davidson_params.davidson_max_bases = 4;
+  RunTestCentLanczosSolverCase(
+      {&dlblock, &dlsite, &drsite, &drblock},
+      pdinit_state,
+      davidson_params);
+
+  // Multithreaded matrix-vector multiplications.
+  pdinit_state = new DGQTensor({idx_Din, idx_dout, idx_dout, idx_Dout});
+  srand(0);
+  pdinit_state->Random(QN({QNNameVal("Sz", 0)}));
+  LanczosParams threaded_lanczos_params(1.0E-9);
+  threaded_lanczos_params.matvec_threads = 4;
+  RunTestCentLanczosSolverCase(
+      {&dlblock, &dlsite, &drsite, &drblock},
+      pdinit_state,
+      threaded_lanczos_params);
+
+  // Block Lanczos solver for the three lowest states.
+  std::vector<DGQTensor *> dinit_states;
+  srand(0);
+  for (long i = 0; i < 3; ++i) {
+    auto pstate = new DGQTensor({idx_Din, idx_dout, idx_dout, idx_Dout});
+    pstate->Random(QN({QNNameVal("Sz", 0)}));
+    dinit_states.push_back(pstate);
+  }
+  LanczosParams block_lanczos_params(1.0E-12);
+  RunTestCentBlockLanczosSolverCase(
+      {&dlblock, &dlsite, &drsite, &drblock},
+      dinit_states,
+      block_lanczos_params);
+
+  // Block Lanczos solver with thick restarts.
+  dinit_states.clear();
+  srand(0);
+  for (long i = 0; i < 3; ++i) {
+    auto pstate = new DGQTensor({idx_Din, idx_dout, idx_dout, idx_Dout});
+    pstate->Random(QN({QNNameVal("Sz", 0)}));
+    dinit_states.push_back(pstate);
+  }
+  LanczosParams restarted_block_lanczos_params(1.0E-12);
+  restarted_block_lanczos_params.block_lanczos_max_bases = 9;
+  RunTestCentBlockLanczosSolverCase(
+      {&dlblock, &dlsite, &drsite, &drblock},
+      dinit_states,
+      restarted_block_lanczos_params);
+
   // Tensor with complex elements.
   auto zlblock = ZGQTensor({idx_Dout, idx_dh, idx_Din});
   auto zlsite  = ZGQTensor({idx_dh, idx_din, idx_dout, idx_dh});
@@ -168,6 +303,28 @@ TEST_F(TestLanczos, TestCentLanczosSolver) {
       {&zlblock, &zlsite, &zrsite, &zrblock},
       pzinit_state,
       lanczos_params);
+
+  // Davidson solver.
+  pzinit_state = new ZGQTensor({idx_Din, idx_dout, idx_dout, idx_Dout});
+  srand(0);
+  pzinit_state->Random(QN({QNNameVal("Sz", 0)}));
+  RunTestCentLanczosSolverCase(
+      {&zlblock, &zlsite, &zrsite, &zrblock},
+      pzinit_state,
+      davidson_params);
+
+  // Block Lanczos solver.
+  std::vector<ZGQTensor *> zinit_states;
+  srand(0);
+  for (long i = 0; i < 3; ++i) {
+    auto pstate = new ZGQTensor({idx_Din, idx_dout, idx_dout, idx_Dout});
+    pstate->Random(QN({QNNameVal("Sz", 0)}));
+    zinit_states.push_back(pstate);
+  }
+  RunTestCentBlockLanczosSolverCase(
+      {&zlblock, &zlsite, &zrsite, &zrblock},
+      zinit_states,
+      block_lanczos_params);
 }
 
 
@@ -177,7 +334,12 @@ void RunTestLendLanczosSolverCase(
     GQTensor<TenElemType> *pinit_state,
     const LanczosParams &lanczos_params) {
   std::cout << "\n";
-  auto lancz_res = LanczosSolver(
+  auto lancz_res = (lanczos_params.solver == kEigenSolverDavidson) ?
+                   DavidsonSolver(
+                       eff_ham, pinit_state,
+                       lanczos_params,
+                       "lend") :
+                   LanczosSolver(
                        eff_ham, pinit_state,
                        lanczos_params,
                        "lend");
@@ -249,6 +411,17 @@ TEST_F(TestLanczos, TestLendLanczosSolver) {
       pdinit_state,
       lanczos_params);
 
+  // Davidson solver.
+  pdinit_state = new DGQTensor({idx_dout, idx_dout, idx_Dout});
+  srand(0);
+  pdinit_state->Random(QN({QNNameVal("Sz", 0)}));
+  LanczosParams davidson_params(1.0E-12);
+  davidson_params.solver = kEigenSolverDavidson;
+  RunTestLendLanczosSolverCase(
+      {&dnull_ten, &dlsite, &drsite, &drblock},
+      pdinit_state,
+      davidson_params);
+
   // Tensor with complex element.
   auto zlsite = ZGQTensor({idx_din, idx_dh, idx_dout});
   auto zrsite = ZGQTensor({idx_dh, idx_din, idx_dout, idx_dh});
@@ -283,4 +456,85 @@ TEST_F(TestLanczos, TestLendLanczosSolver) {
       {&znull_ten, &zlsite, &zrsite, &zrblock},
       pzinit_state,
       lanczos_params);
+
+  // Davidson solver.
+  pzinit_state = new ZGQTensor({idx_dout, idx_dout, idx_Dout});
+  srand(0);
+  pzinit_state->Random(QN({QNNameVal("Sz", 0)}));
+  RunTestLendLanczosSolverCase(
+      {&znull_ten, &zlsite, &zrsite, &zrblock},
+      pzinit_state,
+      davidson_params);
+}
+
+
+template <typename TenElemType>
+void RunTestEffHamMulStatePlanCase(
+    const std::vector<GQTensor<TenElemType> *> &eff_ham,
+    const std::vector<Index> &state_idxs,
+    const QN &state_div) {
+  UpdateArena arena;
+  EffHamMulStatePlan<TenElemType> eff_ham_mul_state(eff_ham, "cent", arena);
+  for (long i = 0; i < 3; ++i) {
+    GQTensor<TenElemType> state(state_idxs);
+    state.Random(state_div);
+    auto res = eff_ham_mul_state(&state);
+    auto benchmark_res = eff_ham_mul_state_cent(eff_ham, &state);
+    auto diff = *res + (-(*benchmark_res));
+    EXPECT_NEAR(diff.Normalize(), 0.0, 1.0E-10 * benchmark_res->Normalize());
+    delete res;
+    delete benchmark_res;
+  }
+  EXPECT_EQ(eff_ham_mul_state.MulNum(), 3);
+  EXPECT_EQ(eff_ham_mul_state.PlanNum(), 1);
+
+  // The states with the same block structure are multiplied in one batch.
+  std::vector<GQTensor<TenElemType> *> states;
+  for (long i = 0; i < 3; ++i) {
+    auto pstate = new GQTensor<TenElemType>(state_idxs);
+    pstate->Random(state_div);
+    states.push_back(pstate);
+  }
+  auto ress = eff_ham_mul_state(states);
+  ASSERT_EQ(ress.size(), states.size());
+  for (size_t i = 0; i < states.size(); ++i) {
+    auto benchmark_res = eff_ham_mul_state_cent(eff_ham, states[i]);
+    auto diff = *ress[i] + (-(*benchmark_res));
+    EXPECT_NEAR(diff.Normalize(), 0.0, 1.0E-10 * benchmark_res->Normalize());
+    delete ress[i];
+    delete benchmark_res;
+    delete states[i];
+  }
+  EXPECT_EQ(eff_ham_mul_state.MulNum(), 6);
+  EXPECT_EQ(eff_ham_mul_state.PlanNum(), 1);
+}
+
+
+TEST_F(TestLanczos, TestEffHamMulStatePlan) {
+  auto qn0 = QN({QNNameVal("Sz", 0)});
+  auto qn1 = QN({QNNameVal("Sz", 1)});
+  auto idx_pin = Index({QNSector(qn0, 1), QNSector(qn1, 1)}, IN);
+  auto idx_pout = InverseIndex(idx_pin);
+  auto idx_vin = Index({QNSector(qn0, 3), QNSector(qn1, 4)}, IN);
+  auto idx_vout = InverseIndex(idx_vin);
+  std::vector<Index> state_idxs = {idx_vin, idx_pout, idx_pout, idx_vout};
+
+  srand(0);
+  auto dlblock = DGQTensor({idx_vout, idx_dh, idx_vin});
+  auto dsite = DGQTensor({idx_dh, idx_pin, idx_pout, idx_dh});
+  auto drblock = DGQTensor({idx_vin, idx_dh, idx_vout});
+  dlblock.Random(qn0);
+  dsite.Random(qn0);
+  drblock.Random(qn0);
+  RunTestEffHamMulStatePlanCase<GQTEN_Double>(
+      {&dlblock, &dsite, &dsite, &drblock}, state_idxs, qn1);
+
+  auto zlblock = ZGQTensor({idx_vout, idx_dh, idx_vin});
+  auto zsite = ZGQTensor({idx_dh, idx_pin, idx_pout, idx_dh});
+  auto zrblock = ZGQTensor({idx_vin, idx_dh, idx_vout});
+  zlblock.Random(qn0);
+  zsite.Random(qn0);
+  zrblock.Random(qn0);
+  RunTestEffHamMulStatePlanCase<GQTEN_Complex>(
+      {&zlblock, &zsite, &zsite, &zrblock}, state_idxs, qn0);
 }
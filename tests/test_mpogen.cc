@@ -12,6 +12,14 @@
 
 #include "gtest/gtest.h"
 
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <unordered_set>
+#include <functional>
+#include <cmath>
+
 using namespace gqmps2;
 using namespace gqten;
 
@@ -84,9 +92,10 @@ TEST_F(TestMpoGenerator, TestAddTermCase1) {
 
 TEST_F(TestMpoGenerator, TestAddTermCase2) {
   auto s = OpRepr(1);
+  // The duplicate is merged at insertion.
   SparOpReprMat bchmk_m0(1, 1), bchmk_m1(1, 1);
-  bchmk_m0.SetElem(0, 0, s);
-  bchmk_m1.SetElem(0, 0, s+s);
+  bchmk_m0.SetElem(0, 0, s+s);
+  bchmk_m1.SetElem(0, 0, s);
 
   DMPOGenerator mpo_generator1(2, phys_idx_out, qn0);
   mpo_generator1.AddTerm(1., {dsz, dsz}, {0, 1}, {did});
@@ -157,7 +166,7 @@ TEST_F(TestMpoGenerator, TestAddTermCase4) {
   bchmk_m3.SetElem(1, 0, s);
   bchmk_m3.SetElem(1, 1, kIdOpRepr);
   bchmk_m4.SetElem(0, 0, kIdOpRepr);
-  bchmk_m4.SetElem(0, 1, s);
+  bchmk_m4.SetElem(1, 0, s);
 
   DMPOGenerator mpo_generator1(5, phys_idx_out, qn0);
   mpo_generator1.AddTerm(1., {dsz, dsz}, {0, 4}, {did});
@@ -260,3 +269,154 @@ TEST_F(TestMpoGenerator, TestAddTermCase6) {
   EXPECT_EQ(fsm_comp_mat_repr[1], bchmk_m1);
   EXPECT_EQ(fsm_comp_mat_repr[2], bchmk_m2);
 }
+
+
+// Dense operator of the MPO with the legs (in0, out0, in1, out1, ...).
+template <typename TenElemType>
+GQTensor<TenElemType> *ContractMpo(
+    const std::vector<GQTensor<TenElemType> *> &mpo) {
+  long N = mpo.size();
+  auto pres = new GQTensor<TenElemType>(*mpo[0]);
+  for (long i = 1; i < N; ++i) {
+    long rvb_leg = (i == 1) ? 1 : 2*i;
+    long lvb_leg = (i == N-1) ? 1 : 0;
+    auto pnext = Contract(*pres, *mpo[i], {{rvb_leg}, {lvb_leg}});
+    delete pres;
+    pres = pnext;
+  }
+  return pres;
+}
+
+
+TEST_F(TestMpoGenerator, TestMpoCompression) {
+  long N = 6;
+  DMPOGenerator mpo_generator(N, phys_idx_out, qn0);
+  for (long i = 0; i < N; ++i) {
+    for (long j = i+1; j < N; ++j) {
+      mpo_generator.AddTerm(std::exp(-double(j-i)), {dsz, dsz}, {i, j});
+    }
+  }
+  auto mpo = mpo_generator.Gen();
+  std::vector<DGQTensor *> comp_mpo;
+  for (auto pmpo_ten : mpo) { comp_mpo.push_back(new DGQTensor(*pmpo_ten)); }
+  CompressMpo(comp_mpo, 1.0E-14);
+
+  // Exponential decay interactions need three states on each bond.
+  EXPECT_LE(comp_mpo[0]->indexes[1].dim, 3);
+  for (long i = 1; i < N-1; ++i) {
+    EXPECT_LE(comp_mpo[i]->indexes[3].dim, 3);
+  }
+  auto pop = ContractMpo(mpo);
+  auto pcomp_op = ContractMpo(comp_mpo);
+  auto diff = *pcomp_op + (-(*pop));
+  EXPECT_NEAR(diff.Normalize(), 0.0, 1.0E-10 * pop->Normalize());
+  delete pop;
+  delete pcomp_op;
+  for (auto pmpo_ten : mpo) { delete pmpo_ten; }
+  for (auto pmpo_ten : comp_mpo) { delete pmpo_ten; }
+}
+
+
+TEST_F(TestMpoGenerator, TestMpoCache) {
+  long N = 4;
+  auto gen_heisenberg = [this, N](const double j) {
+    DMPOGenerator mpo_generator(N, phys_idx_out, qn0);
+    for (long i = 0; i < N-1; ++i) {
+      mpo_generator.AddTerm(j, {dsz, dsz}, {i, i+1});
+    }
+    return mpo_generator;
+  };
+  auto mpo_generator = gen_heisenberg(1.0);
+  EXPECT_EQ(mpo_generator.Hash(), gen_heisenberg(1.0).Hash());
+  EXPECT_NE(mpo_generator.Hash(), gen_heisenberg(0.5).Hash());
+
+  std::string cache_path = "mpo_cache_test";
+  auto mpo = mpo_generator.GenCached(cache_path);
+  auto cached_mpo = gen_heisenberg(1.0).GenCached(cache_path);
+  for (long i = 0; i < N; ++i) {
+    EXPECT_EQ(*cached_mpo[i], *mpo[i]);
+    delete cached_mpo[i];
+  }
+
+  // A hit does not generate the MPO.
+  long gen_num = 0;
+  std::function<std::vector<DGQTensor *>(void)> counted_gen =
+      [&mpo_generator, &gen_num](void) {
+        ++gen_num;
+        return mpo_generator.Gen();
+      };
+  cached_mpo = GenMpoThroughCache<DGQTensor>(
+                   N, mpo_generator.Hash(), cache_path, counted_gen);
+  EXPECT_EQ(gen_num, 0);
+  for (long i = 0; i < N; ++i) {
+    EXPECT_EQ(*cached_mpo[i], *mpo[i]);
+  }
+  auto missed_mpo = GenMpoThroughCache<DGQTensor>(
+                        N, mpo_generator.Hash() + 1, cache_path, counted_gen);
+  EXPECT_EQ(gen_num, 1);
+
+  for (auto hash : {mpo_generator.Hash(), mpo_generator.Hash() + 1}) {
+    std::ostringstream mpo_path;
+    mpo_path << cache_path << "/"
+             << std::hex << std::setw(16) << std::setfill('0') << hash;
+    for (long i = 0; i < N; ++i) {
+      RemoveFile(GenMpoTenFileName(mpo_path.str(), i));
+    }
+    RemoveFile(mpo_path.str());
+  }
+  for (long i = 0; i < N; ++i) {
+    delete mpo[i];
+    delete cached_mpo[i];
+    delete missed_mpo[i];
+  }
+  RemoveFile(cache_path);
+}
+
+
+TEST_F(TestMpoGenerator, TestTransInvMpoGen) {
+  long N = 10;
+  TransInvMPOGenerator<GQTEN_Complex> tmpo_generator(1, phys_idx_out, qn0);
+  ZMPOGenerator mpo_generator(N, phys_idx_out, qn0);
+  for (auto &op : {zsz, zsx, zsy}) {
+    tmpo_generator.AddTerm(1.0, {op, op}, {0, 1});
+    for (long i = 0; i < N-1; ++i) {
+      mpo_generator.AddTerm(1.0, {op, op}, {i, i+1});
+    }
+  }
+  tmpo_generator.AddTerm(0.3, zsz, 0);
+  for (long i = 0; i < N; ++i) { mpo_generator.AddTerm(0.3, zsz, i); }
+  auto tmpo = tmpo_generator.Gen(N);
+  auto mpo = mpo_generator.Gen();
+
+  // The bulk tensors are shared.
+  ASSERT_EQ(long(tmpo.size()), N);
+  std::unordered_set<ZGQTensor *> ptmpo_tens(tmpo.begin(), tmpo.end());
+  EXPECT_LT(long(ptmpo_tens.size()), N);
+  auto ptop = ContractMpo(tmpo);
+  auto pop = ContractMpo(mpo);
+  auto diff = *ptop + (-(*pop));
+  EXPECT_NEAR(diff.Normalize(), 0.0, 1.0E-12 * pop->Normalize());
+  delete ptop;
+  delete pop;
+  MpoFree(tmpo);
+  MpoFree(mpo);
+}
+
+
+// Operators which are equal get the same label, whatever the order of their
+// blocks and the rounding of their elements.
+TEST_F(TestMpoGenerator, TestOpLabelHash) {
+  DGQTensor op1({phys_idx_in, phys_idx_out});
+  DGQTensor op2({phys_idx_in, phys_idx_out});
+  op1({0, 0}) = 0.5;
+  op1({1, 1}) = -0.5;
+  op2({1, 1}) = -0.5;
+  op2({0, 0}) = 0.5 + 1.0E-16;
+  ASSERT_EQ(op1, op2);
+  EXPECT_EQ(
+      GQTensorLabelHash<GQTEN_Double>()(op1),
+      GQTensorLabelHash<GQTEN_Double>()(op2));
+  LabelConvertor<DGQTensor, GQTensorLabelHash<GQTEN_Double>>
+      op_label_convertor(did);
+  EXPECT_EQ(op_label_convertor.Convert(op1), op_label_convertor.Convert(op2));
+}
@@ -313,11 +313,13 @@ void RunTestSparCoefReprMatInitializationCase(size_t row_num, size_t col_num) {
   SparCoefReprMat spar_mat(row_num, col_num);
   EXPECT_EQ(spar_mat.rows, row_num);
   EXPECT_EQ(spar_mat.cols, col_num);
-  EXPECT_TRUE(spar_mat.data.empty());
-  auto size = row_num * col_num;
-  auto indexes = spar_mat.indexes;
-  EXPECT_EQ(indexes.size(), size);
-  for (size_t i = 0; i < size; ++i) { EXPECT_EQ(indexes[i], -1); }
+  EXPECT_EQ(spar_mat.nnz(), 0);
+  for (size_t x = 0; x < row_num; ++x) {
+    EXPECT_TRUE(spar_mat.GetRowElems(x).empty());
+  }
+  for (size_t y = 0; y < col_num; ++y) {
+    EXPECT_TRUE(spar_mat.GetColRowIdxs(y).empty());
+  }
 }
 
 
@@ -325,8 +327,7 @@ TEST(TestSparCoefReprMat, Initialization) {
   SparCoefReprMat null_coef_repr_mat;
   EXPECT_EQ(null_coef_repr_mat.rows, 0);
   EXPECT_EQ(null_coef_repr_mat.cols, 0);
-  EXPECT_TRUE(null_coef_repr_mat.data.empty());
-  EXPECT_TRUE(null_coef_repr_mat.indexes.empty());
+  EXPECT_EQ(null_coef_repr_mat.nnz(), 0);
 
   RunTestSparCoefReprMatInitializationCase(1, 1);
   RunTestSparCoefReprMatInitializationCase(5, 1);
@@ -449,12 +450,11 @@ void RunTestSparCoefReprMatRemoveRowAndColCase(
     auto new_rows = row_num - 1;
     EXPECT_EQ(spar_mat_to_rmv_row.rows, new_rows);
     EXPECT_EQ(spar_mat_to_rmv_row.cols, col_num);
-    auto new_size = new_rows * col_num;
-    EXPECT_EQ(spar_mat_to_rmv_row.indexes, std::vector<long>(new_size, -1));
+    EXPECT_EQ(spar_mat_to_rmv_row.nnz(), 0);
   } else {
     EXPECT_EQ(spar_mat_to_rmv_row.rows, 0);
     EXPECT_EQ(spar_mat_to_rmv_row.cols, 0);
-    EXPECT_TRUE(spar_mat_to_rmv_row.indexes.empty());
+    EXPECT_EQ(spar_mat_to_rmv_row.nnz(), 0);
   }
 
   auto spar_mat_to_rmv_col = spar_mat;
@@ -463,12 +463,11 @@ void RunTestSparCoefReprMatRemoveRowAndColCase(
     auto new_cols = col_num - 1;
     EXPECT_EQ(spar_mat_to_rmv_col.rows, row_num);
     EXPECT_EQ(spar_mat_to_rmv_col.cols, new_cols);
-    auto new_size = row_num * new_cols;
-    EXPECT_EQ(spar_mat_to_rmv_col.indexes, std::vector<long>(new_size, -1));
+    EXPECT_EQ(spar_mat_to_rmv_col.nnz(), 0);
   } else {
     EXPECT_EQ(spar_mat_to_rmv_col.rows, 0);
     EXPECT_EQ(spar_mat_to_rmv_col.cols, 0);
-    EXPECT_TRUE(spar_mat_to_rmv_col.indexes.empty());
+    EXPECT_EQ(spar_mat_to_rmv_col.nnz(), 0);
   }
 }
 
@@ -560,11 +559,13 @@ void RunTestSparOpReprMatInitializationCase(size_t row_num, size_t col_num) {
   SparOpReprMat spar_mat(row_num, col_num);
   EXPECT_EQ(spar_mat.rows, row_num);
   EXPECT_EQ(spar_mat.cols, col_num);
-  EXPECT_TRUE(spar_mat.data.empty());
-  auto size = row_num * col_num;
-  auto indexes = spar_mat.indexes;
-  EXPECT_EQ(indexes.size(), size);
-  for (size_t i = 0; i < size; ++i) { EXPECT_EQ(indexes[i], -1); }
+  EXPECT_EQ(spar_mat.nnz(), 0);
+  for (size_t x = 0; x < row_num; ++x) {
+    EXPECT_TRUE(spar_mat.GetRowElems(x).empty());
+  }
+  for (size_t y = 0; y < col_num; ++y) {
+    EXPECT_TRUE(spar_mat.GetColRowIdxs(y).empty());
+  }
 }
 
 
@@ -572,8 +573,7 @@ TEST(TestSparOpReprMat, Initialization) {
   SparOpReprMat null_op_repr_mat;
   EXPECT_EQ(null_op_repr_mat.rows, 0);
   EXPECT_EQ(null_op_repr_mat.cols, 0);
-  EXPECT_TRUE(null_op_repr_mat.data.empty());
-  EXPECT_TRUE(null_op_repr_mat.indexes.empty());
+  EXPECT_EQ(null_op_repr_mat.nnz(), 0);
 
   RunTestSparOpReprMatInitializationCase(1, 1);
   RunTestSparOpReprMatInitializationCase(5, 1);
@@ -1313,6 +1313,30 @@ void RunTestSparOpReprMatRowCompresserCase12(void) {
 }
 
 
+// The row 2 is the row 1, but the rows 0 and 1 both overlap with it.
+void RunTestSparOpReprMatRowCompresserCase13(void) {
+  OpRepr a(1), b(2), c(3), d(4), e(5);
+  SparOpReprMat m1(3, 2), m2(1, 3);
+  m1.SetElem(0, 0, a);
+  m1.SetElem(1, 0, a);
+  m1.SetElem(1, 1, b);
+  m1.SetElem(2, 0, a);
+  m1.SetElem(2, 1, b);
+  m2.SetElem(0, 0, c);
+  m2.SetElem(0, 1, d);
+  m2.SetElem(0, 2, e);
+  SparOpReprMat bchmk_m1(2, 2), bchmk_m2(1, 2);
+  bchmk_m1.SetElem(0, 0, a);
+  bchmk_m1.SetElem(1, 0, a);
+  bchmk_m1.SetElem(1, 1, b);
+  bchmk_m2.SetElem(0, 0, c);
+  bchmk_m2.SetElem(0, 1, d + e);
+  SparOpReprMatRowCompresser(m1, m2);
+  EXPECT_EQ(m1, bchmk_m1);
+  EXPECT_EQ(m2, bchmk_m2);
+}
+
+
 TEST(TestSparOpReprMat, TestSparOpReprMatRowCompresser) {
   RunTestSparOpReprMatRowCompresserCase1();
   RunTestSparOpReprMatRowCompresserCase2();
@@ -1326,6 +1350,7 @@ TEST(TestSparOpReprMat, TestSparOpReprMatRowCompresser) {
   RunTestSparOpReprMatRowCompresserCase10();
   RunTestSparOpReprMatRowCompresserCase11();
   RunTestSparOpReprMatRowCompresserCase12();
+  RunTestSparOpReprMatRowCompresserCase13();
 }
 
 
@@ -1559,6 +1584,30 @@ void RunTestSparOpReprMatColCompresserCase11(void) {
 }
 
 
+// The col 2 is the col 1, but the cols 0 and 1 both overlap with it.
+void RunTestSparOpReprMatColCompresserCase12(void) {
+  OpRepr a(1), b(2), c(3), d(4), e(5);
+  SparOpReprMat m1(2, 3), m2(3, 1);
+  m1.SetElem(0, 0, a);
+  m1.SetElem(0, 1, a);
+  m1.SetElem(1, 1, b);
+  m1.SetElem(0, 2, a);
+  m1.SetElem(1, 2, b);
+  m2.SetElem(0, 0, c);
+  m2.SetElem(1, 0, d);
+  m2.SetElem(2, 0, e);
+  SparOpReprMat bchmk_m1(2, 2), bchmk_m2(2, 1);
+  bchmk_m1.SetElem(0, 0, a);
+  bchmk_m1.SetElem(0, 1, a);
+  bchmk_m1.SetElem(1, 1, b);
+  bchmk_m2.SetElem(0, 0, c);
+  bchmk_m2.SetElem(1, 0, d + e);
+  SparOpReprMatColCompresser(m1, m2);
+  EXPECT_EQ(m1, bchmk_m1);
+  EXPECT_EQ(m2, bchmk_m2);
+}
+
+
 TEST(TestSparOpReprMat, TestSparOpReprMatColCompresser) {
   RunTestSparOpReprMatColCompresserCase1();
   RunTestSparOpReprMatColCompresserCase2();
@@ -1571,4 +1620,5 @@ TEST(TestSparOpReprMat, TestSparOpReprMatColCompresser) {
   RunTestSparOpReprMatColCompresserCase9();
   RunTestSparOpReprMatColCompresserCase10();
   RunTestSparOpReprMatColCompresserCase11();
+  RunTestSparOpReprMatColCompresserCase12();
 }
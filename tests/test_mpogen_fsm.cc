@@ -9,6 +9,9 @@
 
 #include "gtest/gtest.h"
 
+#include <complex>
+#include <cmath>
+
 
 void RunTestFSMInitializationCase(const size_t N) {
   if (N == 0) {
@@ -98,21 +101,19 @@ void RunTestAddPathCase3(void) {
   FSM fsm(2);
   fsm.AddPath(0, 1, {s, s});
   fsm.AddPath(0, 1, {s, s});
-  FSMNode n1, n2, n3, n4;
+  FSMNode n1, n2, n3;
   n1.fsm_site_idx = 0;
   n1.fsm_stat_idx = 0;
   n2.fsm_site_idx = 1;
   n2.fsm_stat_idx = 1;
   n3.fsm_site_idx = 2;
   n3.fsm_stat_idx = -1;
-  n4.fsm_site_idx = 1;
-  n4.fsm_stat_idx = 2;
 
+  // The duplicate is merged.
   auto paths = fsm.GetFSMPaths();
-  EXPECT_EQ(paths[0].op_reprs, OpReprVec({s, s}));
+  EXPECT_EQ(paths.size(), 1);
+  EXPECT_EQ(paths[0].op_reprs, OpReprVec({s+s, s}));
   EXPECT_EQ(paths[0].fsm_nodes, FSMNodeVec({n1, n2, n3}));
-  EXPECT_EQ(paths[1].op_reprs, OpReprVec({s, s}));
-  EXPECT_EQ(paths[1].fsm_nodes, FSMNodeVec({n1, n4, n3}));
 }
 
 
@@ -196,12 +197,59 @@ void RunTestAddPathCase5(void) {
 }
 
 
+void RunTestAddPathCase6(void) {
+  CoefLabel j1 = 1, j2 = 2;
+  OpLabel s = 1, t = 2;
+  OpRepr op_s(s), op_t(t);
+  FSM fsm(6);
+  fsm.AddPath(1, 4, {1, 2, 4}, {OpRepr(j1, s), kIdOpRepr, op_s});
+  fsm.AddPath(1, 4, {OpRepr(j2, s), kIdOpRepr, kIdOpRepr, op_s});
+  fsm.AddPath(1, 4, {OpRepr(j1, s), op_t, op_t, op_s});
+  fsm.AddPath(2, 3, {2}, {op_s});
+  EXPECT_EQ(fsm.GetSpanPathNum(), 3);
+
+  auto paths = fsm.GetFSMPaths();
+  EXPECT_EQ(paths.size(), 3);
+  EXPECT_EQ(
+      paths[0].op_reprs,
+      OpReprVec({
+          kIdOpRepr, OpRepr({j1, j2}, {s, s}), kIdOpRepr, kIdOpRepr, op_s,
+          kIdOpRepr}));
+  EXPECT_EQ(
+      paths[1].op_reprs,
+      OpReprVec({kIdOpRepr, OpRepr(j1, s), op_t, op_t, op_s, kIdOpRepr}));
+  EXPECT_EQ(
+      paths[2].op_reprs,
+      OpReprVec({kIdOpRepr, kIdOpRepr, op_s, op_s, kIdOpRepr, kIdOpRepr}));
+  FSMNodeVec bchmk_nodes2(7);
+  std::vector<long> bchmk_stats2 = {0, 0, 0, 3, -1, -1, -1};
+  for (size_t i = 0; i < 7; ++i) {
+    bchmk_nodes2[i].fsm_site_idx = i;
+    bchmk_nodes2[i].fsm_stat_idx = bchmk_stats2[i];
+  }
+  EXPECT_EQ(paths[2].fsm_nodes, bchmk_nodes2);
+
+  // Same matrix representation as the uncompacted paths.
+  FSM bchmk_fsm(6);
+  bchmk_fsm.AddPath(
+      1, 4, {OpRepr({j1, j2}, {s, s}), kIdOpRepr, kIdOpRepr, op_s});
+  bchmk_fsm.AddPath(1, 4, {OpRepr(j1, s), op_t, op_t, op_s});
+  bchmk_fsm.AddPath(2, 3, {op_s, op_s});
+  auto mat_repr = fsm.GenMatRepr();
+  auto bchmk_mat_repr = bchmk_fsm.GenMatRepr();
+  for (size_t i = 0; i < 6; ++i) {
+    EXPECT_EQ(mat_repr[i], bchmk_mat_repr[i]);
+  }
+}
+
+
 TEST(TestFSM, TestAddPath) {
   RunTestAddPathCase1();
   RunTestAddPathCase2();
   RunTestAddPathCase3();
   RunTestAddPathCase4();
   RunTestAddPathCase5();
+  RunTestAddPathCase6();
 }
 
 
@@ -257,12 +305,10 @@ void RunTestGenMatReprCase3(void) {
   FSM fsm(2);
   fsm.AddPath(0, 1, {s, s});
   fsm.AddPath(0, 1, {s, s});
-  SparOpReprMat bchmk_mat0(1, 2);
-  bchmk_mat0.SetElem(0, 0, s);
-  bchmk_mat0.SetElem(0, 1, s);
-  SparOpReprMat bchmk_mat1(2, 1);
+  SparOpReprMat bchmk_mat0(1, 1);
+  bchmk_mat0.SetElem(0, 0, s+s);
+  SparOpReprMat bchmk_mat1(1, 1);
   bchmk_mat1.SetElem(0, 0, s);
-  bchmk_mat1.SetElem(1, 0, s);
 
   auto fsm_mat_repr = fsm.GenMatRepr();
   EXPECT_EQ(fsm_mat_repr[0], bchmk_mat0);
@@ -386,8 +432,8 @@ void RunTestGenCompressedMatReprCase3(void) {
   fsm.AddPath(0, 1, {s, s});
   fsm.AddPath(0, 1, {s, s});
   SparOpReprMat bchmk_m0(1, 1), bchmk_m1(1, 1);
-  bchmk_m0.SetElem(0, 0, s);
-  bchmk_m1.SetElem(0, 0, s+s);
+  bchmk_m0.SetElem(0, 0, s+s);
+  bchmk_m1.SetElem(0, 0, s);
   auto fsm_comp_mat_repr = fsm.GenCompressedMatRepr();
   EXPECT_EQ(fsm_comp_mat_repr[0], bchmk_m0);
   EXPECT_EQ(fsm_comp_mat_repr[1], bchmk_m1);
@@ -436,7 +482,7 @@ void RunTestGenCompressedMatReprCase5(void) {
   bchmk_m3.SetElem(1, 0, s);
   bchmk_m3.SetElem(1, 1, kIdOpRepr);
   bchmk_m4.SetElem(0, 0, kIdOpRepr);
-  bchmk_m4.SetElem(0, 1, s);
+  bchmk_m4.SetElem(1, 0, s);
   auto fsm_comp_mat_repr = fsm.GenCompressedMatRepr();
   EXPECT_EQ(fsm_comp_mat_repr[0], bchmk_m0);
   EXPECT_EQ(fsm_comp_mat_repr[1], bchmk_m1);
@@ -514,6 +560,35 @@ void RunTestGenCompressedMatReprCase7(void) {
 }
 
 
+// Long J1-J2 chain, each bulk bond carries the ready and the final states and
+// the three operators for the distances one and two.
+void RunTestGenCompressedMatReprCase8(void) {
+  OpLabel sz_label = 1, sp_label = 2, sm_label = 3;
+  auto sz = OpRepr(sz_label), sp = OpRepr(sp_label), sm = OpRepr(sm_label);
+  size_t N = 1000;
+  FSM fsm(N);
+  for (size_t i = 0; i < N-1; ++i) {
+    fsm.AddPath(i, i+1, {OpRepr(CoefRepr(1), sz_label), sz});
+    fsm.AddPath(i, i+1, {OpRepr(CoefRepr(2), sp_label), sm});
+    fsm.AddPath(i, i+1, {OpRepr(CoefRepr(2), sm_label), sp});
+    if (i < N-2) {
+      fsm.AddPath(i, i+2, {OpRepr(CoefRepr(3), sz_label), kIdOpRepr, sz});
+      fsm.AddPath(i, i+2, {OpRepr(CoefRepr(4), sp_label), kIdOpRepr, sm});
+      fsm.AddPath(i, i+2, {OpRepr(CoefRepr(4), sm_label), kIdOpRepr, sp});
+    }
+  }
+  auto fsm_comp_mat_repr = fsm.GenCompressedMatRepr();
+  EXPECT_EQ(fsm_comp_mat_repr.front().rows, 1);
+  EXPECT_EQ(fsm_comp_mat_repr.front().cols, 4);
+  for (size_t i = 1; i < N-2; ++i) {
+    EXPECT_EQ(fsm_comp_mat_repr[i].rows, fsm_comp_mat_repr[i-1].cols);
+    EXPECT_EQ(fsm_comp_mat_repr[i].cols, 8);
+  }
+  EXPECT_EQ(fsm_comp_mat_repr[N-2].cols, 4);
+  EXPECT_EQ(fsm_comp_mat_repr.back().cols, 1);
+}
+
+
 TEST(TestFSM, TestGenCompressedMatRepr) {
   RunTestGenCompressedMatReprCase1();
   RunTestGenCompressedMatReprCase2();
@@ -522,6 +597,7 @@ TEST(TestFSM, TestGenCompressedMatRepr) {
   RunTestGenCompressedMatReprCase5();
   RunTestGenCompressedMatReprCase6();
   RunTestGenCompressedMatReprCase7();
+  RunTestGenCompressedMatReprCase8();
 }
 
 
@@ -536,4 +612,35 @@ TEST(TestLabelConvertor, TestConversion) {
   EXPECT_EQ(real_coef_label_convertor.Convert(2.0), 1);
 
   EXPECT_EQ(real_coef_label_convertor.Convert(1.), 0);
+
+  // Site dependent couplings.
+  for (long i = 1; i <= 100000; ++i) {
+    EXPECT_EQ(real_coef_label_convertor.Convert(std::exp(-0.001 * i)), i + 1);
+  }
+  EXPECT_EQ(real_coef_label_convertor.Convert(std::exp(-0.001 * 1)), 2);
+  EXPECT_EQ(real_coef_label_convertor.Convert(std::exp(-0.001 * 6)), 7);
+  EXPECT_EQ(real_coef_label_convertor.Convert(2.0), 1);
+  EXPECT_EQ(real_coef_label_convertor.GetLabelObjMapping().size(), 100002);
+
+  auto cplx_coef_label_convertor =
+      LabelConvertor<std::complex<double>>(std::complex<double>(1.0));
+  EXPECT_EQ(cplx_coef_label_convertor.Convert(std::complex<double>(1, 2)), 1);
+  EXPECT_EQ(cplx_coef_label_convertor.Convert(std::complex<double>(2, 1)), 2);
+  EXPECT_EQ(cplx_coef_label_convertor.Convert(std::complex<double>(1, 2)), 1);
+  EXPECT_EQ(cplx_coef_label_convertor.Convert(1.0), 0);
+}
+
+
+// All the objects collide, the labels are found by the equality check.
+struct TestCollidingHash {
+  size_t operator()(const double) const { return 0; }
+};
+
+
+TEST(TestLabelConvertor, TestHashCollision) {
+  auto coef_label_convertor = LabelConvertor<double, TestCollidingHash>(1.0);
+  EXPECT_EQ(coef_label_convertor.Convert(2.0), 1);
+  EXPECT_EQ(coef_label_convertor.Convert(3.0), 2);
+  EXPECT_EQ(coef_label_convertor.Convert(2.0), 1);
+  EXPECT_EQ(coef_label_convertor.Convert(1.0), 0);
 }
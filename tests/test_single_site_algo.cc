@@ -0,0 +1,133 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 11:40
+*
+* Description: GraceQ/mps2 project. Unittest for single site algorithm.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gtest/gtest.h"
+#include "gqten/gqten.h"
+
+#include <vector>
+
+
+using namespace gqmps2;
+using namespace gqten;
+using DTenPtrVec = std::vector<DGQTensor *>;
+using ZTenPtrVec = std::vector<ZGQTensor *>;
+
+
+template <typename TenType>
+void RunTestSingleSiteAlgorithmCase(
+    std::vector<TenType *> &mps, const std::vector<TenType *> &mpo,
+    const SweepParams &sweep_params,
+    const double benmrk_e0, const double precision) {
+  auto e0 = SingleSiteAlgorithm(mps, mpo, sweep_params);
+  EXPECT_NEAR(e0, benmrk_e0, precision);
+}
+
+
+// Test spin systems
+struct TestSingleSiteAlgorithmSpinSystem : public testing::Test {
+  long N = 6;
+
+  QN qn0 = QN({QNNameVal("Sz", 0)});
+  Index pb_out = Index({
+                     QNSector(QN({QNNameVal("Sz", 1)}), 1),
+                     QNSector(QN({QNNameVal("Sz", -1)}), 1)}, OUT);
+  Index pb_in = InverseIndex(pb_out);
+
+  DGQTensor  dsz  = DGQTensor({pb_in, pb_out});
+  DGQTensor  dsp  = DGQTensor({pb_in, pb_out});
+  DGQTensor  dsm  = DGQTensor({pb_in, pb_out});
+  DTenPtrVec dmps = DTenPtrVec(N);
+
+  ZGQTensor  zsz  = ZGQTensor({pb_in, pb_out});
+  ZGQTensor  zsp  = ZGQTensor({pb_in, pb_out});
+  ZGQTensor  zsm  = ZGQTensor({pb_in, pb_out});
+  ZTenPtrVec zmps = ZTenPtrVec(N);
+
+  void SetUp(void) {
+    dsz({0, 0}) = 0.5;
+    dsz({1, 1}) = -0.5;
+    dsp({0, 1}) = 1;
+    dsm({1, 0}) = 1;
+
+    zsz({0, 0}) = 0.5;
+    zsz({1, 1}) = -0.5;
+    zsp({0, 1}) = 1;
+    zsm({1, 0}) = 1;
+  }
+};
+
+
+TEST_F(TestSingleSiteAlgorithmSpinSystem, 1DHeisenberg) {
+  auto dmpo_gen = MPOGenerator<GQTEN_Double>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    dmpo_gen.AddTerm(1,   {dsz, dsz}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsp, dsm}, {i, i+1});
+    dmpo_gen.AddTerm(0.5, {dsm, dsp}, {i, i+1});
+  }
+  auto dmpo = dmpo_gen.Gen();
+
+  // The bond dimensions grow from 4 to 8 by the subspace expansion.
+  auto sweep_params = SweepParams(
+                     4,
+                     1, 8, 1.0E-12,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  RunTestSingleSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-10);
+
+  // No file I/O case with Davidson solver.
+  sweep_params = SweepParams(
+                     4,
+                     1, 8, 1.0E-12,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.LanczParams.solver = kEigenSolverDavidson;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  RunTestSingleSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-10);
+
+  // Late sweeps at the fixed bond dimension following the two-site sweeps.
+  sweep_params = SweepParams(
+                     2,
+                     8, 8, 1.0E-9,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  sweep_params.Workflow = kTwoSiteAlgoWorkflowRestart;
+  sweep_params.ExpansionAlpha = 0.0;
+  RunTestSingleSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-12);
+
+  // Complex Hamiltonian
+  auto zmpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
+  for (long i = 0; i < N-1; ++i) {
+    zmpo_gen.AddTerm(1,   {zsz, zsz}, {i, i+1});
+    zmpo_gen.AddTerm(0.5, {zsp, zsm}, {i, i+1});
+    zmpo_gen.AddTerm(0.5, {zsm, zsp}, {i, i+1});
+  }
+  auto zmpo = zmpo_gen.Gen();
+
+  sweep_params = SweepParams(
+                     4,
+                     1, 8, 1.0E-12,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  RandomInitMps(zmps, pb_out, qn0, qn0, 4);
+  RunTestSingleSiteAlgorithmCase(
+      zmps, zmpo, sweep_params,
+      -2.493577133888, 1.0E-10);
+}
@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 20:40
+*
+* Description: GraceQ/MPS2 project. Unittests for thread pool.
+*/
+#include "gqmps2/detail/thread_pool.h"
+
+#include <vector>
+#include <atomic>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+
+using namespace gqmps2;
+
+
+TEST(TestThreadPool, ParallelFor) {
+  ThreadPool pool(4);
+  EXPECT_EQ(pool.Size(), 4);
+  std::vector<long> res(1000, 0);
+  for (long rep = 0; rep < 10; ++rep) {
+    pool.ParallelFor(1000, [&res](const long i) { res[i] += i; });
+  }
+  for (long i = 0; i < 1000; ++i) { EXPECT_EQ(res[i], 10 * i); }
+
+  std::atomic<long> cnt(0);
+  pool.ParallelFor(0, [&cnt](const long) { ++cnt; });
+  pool.ParallelFor(1, [&cnt](const long) { ++cnt; });
+  pool.ParallelFor(3, [&cnt](const long) { ++cnt; });
+  EXPECT_EQ(cnt, 4);
+}
+
+
+TEST(TestThreadPool, SharedThreadPool) {
+  EXPECT_EQ(SharedThreadPool(1), nullptr);
+  auto ppool = SharedThreadPool(3);
+  ASSERT_NE(ppool, nullptr);
+  EXPECT_EQ(ppool->Size(), 3);
+  EXPECT_EQ(SharedThreadPool(3), ppool);
+  EXPECT_EQ(SharedThreadPool(2)->Size(), 2);
+  // Other sizes do not free the pool.
+  EXPECT_EQ(SharedThreadPool(3), ppool);
+}
+
+
+TEST(TestThreadPool, ConcurrentAndNestedCallers) {
+  ThreadPool pool(4);
+  std::vector<std::vector<long>> res(4, std::vector<long>(1000, 0));
+  std::vector<std::thread> callers;
+  for (long c = 0; c < 4; ++c) {
+    callers.emplace_back(
+        [&pool, &res, c]() {
+          for (long rep = 0; rep < 20; ++rep) {
+            pool.ParallelFor(1000, [&res, c](const long i) { res[c][i] += i; });
+          }
+        });
+  }
+  for (auto &caller : callers) { caller.join(); }
+  for (long c = 0; c < 4; ++c) {
+    for (long i = 0; i < 1000; ++i) { EXPECT_EQ(res[c][i], 20 * i); }
+  }
+
+  std::atomic<long> cnt(0);
+  pool.ParallelFor(
+      8,
+      [&pool, &cnt](const long) {
+        pool.ParallelFor(8, [&cnt](const long) { ++cnt; });
+      });
+  EXPECT_EQ(cnt, 64);
+}
@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-18 18:30
+*
+* Description: GraceQ/MPS2 project. Unittests for sector-parallel truncated SVD.
+*/
+#include "gqmps2/gqmps2.h"
+#include "gtest/gtest.h"
+#include "gqten/gqten.h"
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+
+
+using namespace gqmps2;
+using namespace gqten;
+
+
+struct TestTruncatedSvd : public testing::Test {
+  QN qn0 = QN({QNNameVal("Sz", 0)});
+  QN qnp1 = QN({QNNameVal("Sz", 1)});
+  QN qnm1 = QN({QNNameVal("Sz", -1)});
+  Index idx_l = Index({
+                    QNSector(qnm1, 20),
+                    QNSector(qn0, 20),
+                    QNSector(qnp1, 20)}, IN);
+  Index idx_p = Index({QNSector(qnp1, 1), QNSector(qnm1, 1)}, OUT);
+  Index idx_mid = Index({
+                      QNSector(QN({QNNameVal("Sz", -2)}), 2),
+                      QNSector(qnm1, 2),
+                      QNSector(qn0, 2),
+                      QNSector(qnp1, 2),
+                      QNSector(QN({QNNameVal("Sz", 2)}), 2)}, OUT);
+  Index idx_r = Index({
+                    QNSector(qnm1, 30),
+                    QNSector(qn0, 30),
+                    QNSector(qnp1, 30)}, OUT);
+};
+
+
+inline std::vector<double> SingVals(const DGQTensor &s, const long D) {
+  std::vector<double> sing_vals;
+  for (long i = 0; i < D; ++i) { sing_vals.push_back(s.Elem({i, i})); }
+  std::sort(sing_vals.begin(), sing_vals.end(), std::greater<double>());
+  return sing_vals;
+}
+
+
+// The methods are exact for the sectors of low rank, and accurate for the
+// sectors with fast decaying singular values.
+template <typename TenElemType>
+void RunTestTruncatedSvdCase(
+    const GQTensor<TenElemType> &t, const QN &div, const long Dmax) {
+  auto zero_div = div - div;
+  auto svd_res = Svd(t, 2, 1, div, zero_div, 1.0E-14, 1, Dmax);
+  auto bemrk_sing_vals = SingVals(*svd_res.s, svd_res.D);
+  for (auto method : {kSvdRandomized, kSvdDensityMatrix, kSvdAuto}) {
+    auto trunc_svd_res = TruncatedSvd(
+                             t, 2, 1, div, zero_div, 1.0E-14, 1, Dmax,
+                             method, 4, 2, 2);
+    EXPECT_EQ(trunc_svd_res.D, svd_res.D);
+    EXPECT_NEAR(trunc_svd_res.trunc_err, svd_res.trunc_err, 1.0E-8);
+    auto sing_vals = SingVals(*trunc_svd_res.s, trunc_svd_res.D);
+    for (long i = 0; i < svd_res.D; ++i) {
+      EXPECT_NEAR(sing_vals[i], bemrk_sing_vals[i], 1.0E-8);
+    }
+
+    // Without truncation the decomposition restores the tensor.
+    if (trunc_svd_res.trunc_err < 1.0E-14) {
+      auto us = Contract(*trunc_svd_res.u, *trunc_svd_res.s, {{2}, {0}});
+      auto usv = Contract(*us, *trunc_svd_res.v, {{2}, {0}});
+      (*usv) *= -1.0;
+      (*usv) += t;
+      auto diff = Contract(*usv, Dag(*usv), {{0, 1, 2}, {0, 1, 2}});
+      EXPECT_NEAR(std::abs(diff->scalar), 0.0, 1.0E-8);
+      delete us;
+      delete usv;
+      delete diff;
+    }
+    delete trunc_svd_res.u;
+    delete trunc_svd_res.s;
+    delete trunc_svd_res.v;
+  }
+  delete svd_res.u;
+  delete svd_res.s;
+  delete svd_res.v;
+}
+
+
+TEST_F(TestTruncatedSvd, LowRankTensor) {
+  srand(0);
+  auto da = DGQTensor({idx_l, idx_p, idx_mid});
+  auto db = DGQTensor({InverseIndex(idx_mid), idx_r});
+  da.Random(qn0);
+  db.Random(qn0);
+  auto dt = Contract(da, db, {{2}, {0}});
+  RunTestTruncatedSvdCase(*dt, qn0, 6);
+  RunTestTruncatedSvdCase(*dt, qn0, 40);
+  delete dt;
+
+  auto za = ZGQTensor({idx_l, idx_p, idx_mid});
+  auto zb = ZGQTensor({InverseIndex(idx_mid), idx_r});
+  za.Random(qn0);
+  zb.Random(qn0);
+  auto zt = Contract(za, zb, {{2}, {0}});
+  RunTestTruncatedSvdCase(*zt, qn0, 6);
+  RunTestTruncatedSvdCase(*zt, qn0, 40);
+  delete zt;
+}
+
+
+// The sectors have full rank and the singular values decay by half in each
+// sector, the bond is truncated to 12 of the 90 states.
+TEST_F(TestTruncatedSvd, TruncatedFullRankTensor) {
+  srand(0);
+  Index idx_full_mid = Index({
+                           QNSector(qnm1, 30),
+                           QNSector(qn0, 30),
+                           QNSector(qnp1, 30)}, OUT);
+  auto da = DGQTensor({idx_l, idx_p, idx_full_mid});
+  auto ds = DGQTensor({InverseIndex(idx_full_mid), idx_full_mid});
+  auto db = DGQTensor({InverseIndex(idx_full_mid), idx_r});
+  da.Random(qn0);
+  db.Random(qn0);
+  for (long i = 0; i < idx_full_mid.dim; ++i) {
+    ds({i, i}) = std::pow(0.5, i % 30);
+  }
+  auto pdas = Contract(da, ds, {{2}, {0}});
+  auto dt = Contract(*pdas, db, {{2}, {0}});
+  auto svd_res = Svd(*dt, 2, 1, qn0, qn0, 0.0, 1, 12);
+  EXPECT_EQ(svd_res.D, 12);
+  EXPECT_GT(svd_res.trunc_err, 1.0E-6);
+  RunTestTruncatedSvdCase(*dt, qn0, 12);
+  delete svd_res.u;
+  delete svd_res.s;
+  delete svd_res.v;
+  delete pdas;
+  delete dt;
+
+  auto za = ZGQTensor({idx_l, idx_p, idx_full_mid});
+  auto zs = ZGQTensor({InverseIndex(idx_full_mid), idx_full_mid});
+  auto zb = ZGQTensor({InverseIndex(idx_full_mid), idx_r});
+  za.Random(qn0);
+  zb.Random(qn0);
+  for (long i = 0; i < idx_full_mid.dim; ++i) {
+    zs({i, i}) = std::pow(0.5, i % 30);
+  }
+  auto pzas = Contract(za, zs, {{2}, {0}});
+  auto zt = Contract(*pzas, zb, {{2}, {0}});
+  RunTestTruncatedSvdCase(*zt, qn0, 12);
+  delete pzas;
+  delete zt;
+}
@@ -118,6 +118,137 @@ TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DIsing) {
   RandomInitMps(dmps, pb_out, qn0, qn0, 2);
   RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
 
+  // Synchronous file I/O case.
+  sweep_params = SweepParams(
+                     2,
+                     1, 10, 1.0E-5,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.AsyncFileIO = false;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
+
+  // File I/O case with some blocks kept in memory.
+  sweep_params = SweepParams(
+                     2,
+                     1, 10, 1.0E-5,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.MemBudget = 1.0E-6;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
+
+  // File I/O case with compressed blocks.
+  sweep_params = SweepParams(
+                     2,
+                     1, 10, 1.0E-5,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.BlockCodec = kBlockCodecShuffleRle;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
+
+  // Restart case which reuses the blocks of the last run.
+  sweep_params.Workflow = kTwoSiteAlgoWorkflowRestart;
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
+  {
+    // The right blocks of the converged MPS are reused besides the two
+    // blocks with length 0.
+    BlockManager<DGQTensor> blk_mgr(dmpo, sweep_params);
+    EXPECT_GT(InitBlocks(dmps, dmpo, blk_mgr, 0, 'r'), 2);
+  }
+  {
+    // A changed MPS tensor invalidates the blocks grown from it.
+    auto dmps2 = dmps;
+    dmps2[N-1] = new DGQTensor(dmps[N-1]->indexes);
+    LinearCombine({2.0}, {dmps[N-1]}, dmps2[N-1]);
+    BlockManager<DGQTensor> blk_mgr(dmpo, sweep_params);
+    EXPECT_LE(InitBlocks(dmps2, dmpo, blk_mgr, 0, 'r'), 2);
+    delete dmps2[N-1];
+  }
+  {
+    // So does a changed MPO tensor.
+    auto dmpo2 = dmpo;
+    dmpo2[N-1] = new DGQTensor(dmpo[N-1]->indexes);
+    LinearCombine({2.0}, {dmpo[N-1]}, dmpo2[N-1]);
+    BlockManager<DGQTensor> blk_mgr(dmpo2, sweep_params);
+    EXPECT_LE(InitBlocks(dmps, dmpo2, blk_mgr, 0, 'r'), 2);
+    delete dmpo2[N-1];
+  }
+
+  // Memory-lean Lanczos case.
+  sweep_params = SweepParams(
+                     2,
+                     1, 10, 1.0E-5,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.LanczParams.store_bases = false;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
+
+  // Davidson solver case.
+  sweep_params = SweepParams(
+                     2,
+                     1, 10, 1.0E-5,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.LanczParams.solver = kEigenSolverDavidson;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
+
+  // Truncated SVD case.
+  sweep_params = SweepParams(
+                     2,
+                     1, 10, 1.0E-5,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.SvdMethod = kSvdAuto;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
+
+  // Multithreaded matrix-vector multiplication case.
+  sweep_params = SweepParams(
+                     2,
+                     1, 10, 1.0E-5,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.LanczParams.matvec_threads = 4;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
+
+  // Checkpoint case.
+  sweep_params = SweepParams(
+                     4,
+                     1, 10, 1.0E-5,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.CheckpointInterval = 3;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
+
+  // Scheduled sweeps with early stop.
+  sweep_params = SweepParams(
+                     10,
+                     1, 10, 1.0E-5,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.Schedule = {
+      SweepStage(2, 1.0E-3, 1.0E-5, 50),
+      SweepStage(10, 1.0E-5, 1.0E-7, 200)};
+  sweep_params.EnergyConvTol = 1.0E-12;
+  sweep_params.TruncErrConvTol = 1.0E-12;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, -0.25*(N-1), 1.0E-10);
+
   // Complex Hamiltonian.
   auto zmpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
   for (long i = 0; i < N-1; ++i) {
@@ -170,6 +301,98 @@ TEST_F(TestTwoSiteAlgorithmSpinSystem, 1DHeisenberg) {
       dmps, dmpo, sweep_params,
       -2.493577133888, 1.0E-12);
 
+  // Scheduled sweeps with early stop. The Dmax = 2 stages stall above the
+  // ground state energy, the check must wait for the last stage.
+  sweep_params = SweepParams(
+                     3,
+                     2, 2, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  EXPECT_GT(
+      TwoSiteAlgorithm(dmps, dmpo, sweep_params),
+      -2.493577133888 + 1.0E-4);
+  sweep_params = SweepParams(
+                     10,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.Schedule = {
+      SweepStage(2, 1.0E-9, 1.0E-7, 100),
+      SweepStage(2, 1.0E-9, 1.0E-7, 100),
+      SweepStage(2, 1.0E-9, 1.0E-7, 100),
+      SweepStage(8, 1.0E-9, 1.0E-7, 100)};
+  sweep_params.EnergyConvTol = 1.0E-3;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-10);
+
+  // Checkpoint case. A truncated sweep is interrupted after 7 updates, the
+  // last checkpoint is written after the 6th one. The resumed job ends with
+  // the energy of the uninterrupted one.
+  sweep_params = SweepParams(
+                     1,
+                     1, 3, 1.0E-9,
+                     true,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-7));
+  sweep_params.CheckpointInterval = 3;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 2);
+  DTenPtrVec dmps2(N);
+  for (long i = 0; i < N; ++i) { dmps2[i] = new DGQTensor(*dmps[i]); }
+  auto e0 = TwoSiteAlgorithm(dmps2, dmpo, sweep_params);
+  EXPECT_GT(e0, -2.493577133888 + 1.0E-6);
+  sweep_params.MaxUpdates = 7;
+  TwoSiteAlgorithm(dmps, dmpo, sweep_params);
+  {
+    SweepCheckpoint<DGQTensor> ckpt(N, sweep_params);
+    SweepPosition pos;
+    std::vector<double> energies;
+    ASSERT_TRUE(ckpt.Load(dmps, pos, energies));
+    EXPECT_EQ(pos.sweep, 0);
+    EXPECT_EQ(pos.site, N-2);
+    EXPECT_EQ(pos.dir, 'l');
+    EXPECT_EQ(energies.size(), 6);
+  }
+  sweep_params.MaxUpdates = 0;
+  sweep_params.Workflow = kTwoSiteAlgoWorkflowContinue;
+  RunTestTwoSiteAlgorithmCase(dmps, dmpo, sweep_params, e0, 1.0E-12);
+  for (auto &mps_ten : dmps2) { delete mps_ten; }
+
+  // Real-space parallel case.
+  sweep_params = SweepParams(
+                     8,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-8));
+  sweep_params.RealSpaceSegments = 3;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  RunTestTwoSiteAlgorithmCase(
+      dmps, dmpo, sweep_params,
+      -2.493577133888, 1.0E-10);
+
+  // Multi-target case, the two lowest states of the Sz = 0 sector.
+  sweep_params = SweepParams(
+                     6,
+                     8, 8, 1.0E-9,
+                     false,
+                     kTwoSiteAlgoWorkflowInitial,
+                     LanczosParams(1.0E-10));
+  sweep_params.Targets = 2;
+  RandomInitMps(dmps, pb_out, qn0, qn0, 4);
+  std::vector<DGQTensor *> dexcited_cents;
+  auto energies = MultiTargetTwoSiteAlgorithm(
+                      dmps, dmpo, sweep_params, dexcited_cents);
+  ASSERT_EQ(energies.size(), 2);
+  EXPECT_NEAR(energies[0], -2.493577133888, 1.0E-8);
+  EXPECT_NEAR(energies[1], -2.001995356899, 1.0E-8);
+  ASSERT_EQ(dexcited_cents.size(), 1);
+  delete dexcited_cents[0];
+
   // Complex Hamiltonian
   auto zmpo_gen = MPOGenerator<GQTEN_Complex>(N, pb_out, qn0);
   for (long i = 0; i < N-1; ++i) {
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: LGPL-3.0-only
+/*
+* Author: Rongyang Sun <sun-rongyang@outlook.com>
+* Creation Date: 2026-10-17 19:50
+*
+* Description: GraceQ/MPS2 project. Unittests for update arena.
+*/
+#include "gqmps2/detail/update_arena.h"
+
+#include <vector>
+#include <cstdint>
+
+#include "gtest/gtest.h"
+
+
+using namespace gqmps2;
+
+
+TEST(TestUpdateArena, AllocateAndReset) {
+  UpdateArena arena;
+  auto p1 = arena.Allocate<double>(10);
+  auto p2 = arena.Allocate<char>(3);
+  auto p3 = arena.Allocate<double>(1000);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(p1) % kUpdateArenaAlign, 0U);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(p2) % kUpdateArenaAlign, 0U);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(p3) % kUpdateArenaAlign, 0U);
+  for (long i = 0; i < 1000; ++i) { p3[i] = i; }
+  for (long i = 0; i < 10; ++i) { p1[i] = -i; }
+  EXPECT_EQ(p3[999], 999.0);
+  EXPECT_EQ(p1[9], -9.0);
+  EXPECT_EQ(arena.Stats().served_bytes, 10 * 8 + 3 + 1000 * 8U);
+  EXPECT_EQ(arena.Stats().chunk_allocs, 1U);
+
+  // Chunks are merged by the reset.
+  arena.Allocate(3 * kUpdateArenaMinChunkSize);
+  EXPECT_EQ(arena.Stats().chunk_allocs, 2U);
+  auto peak_bytes = arena.Stats().peak_bytes;
+  EXPECT_EQ(peak_bytes, arena.UsedBytes());
+  arena.Reset();
+  EXPECT_EQ(arena.UsedBytes(), 0U);
+  EXPECT_EQ(arena.Stats().chunk_allocs, 3U);
+
+  // The following update makes no system allocation.
+  for (long i = 0; i < 5; ++i) {
+    arena.Allocate<double>(10);
+    arena.Allocate(3 * kUpdateArenaMinChunkSize);
+    arena.Reset();
+  }
+  EXPECT_EQ(arena.Stats().chunk_allocs, 3U);
+  EXPECT_EQ(arena.Stats().peak_bytes, peak_bytes);
+  EXPECT_EQ(arena.Stats().resets, 6U);
+}
+
+
+TEST(TestUpdateArena, Allocator) {
+  UpdateArena arena;
+  UpdateArenaVector<long> vec{UpdateArenaAllocator<long>(&arena)};
+  for (long i = 0; i < 10000; ++i) { vec.push_back(i); }
+  for (long i = 0; i < 10000; ++i) { EXPECT_EQ(vec[i], i); }
+  EXPECT_GE(arena.UsedBytes(), 10000 * sizeof(long));
+}